@@ -0,0 +1,270 @@
+﻿#include "AsyncLogger.h"
+#include <QDateTime>
+#include <QMutex>
+#include <QStringList>
+#include <QThread>
+#include <QWaitCondition>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "logemitter.h"
+
+namespace {
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// 单生产者单消费者环形缓冲区：生产者只写 tail，消费者只写 head
+class LogRing {
+public:
+    LogRecord* beginPush() {
+        const size_t tail_value = tail.load(std::memory_order_relaxed);
+        if (tail_value - head.load(std::memory_order_acquire) >= AsyncLogger::kRingCapacity) {
+            return nullptr;
+        }
+        return &records[tail_value & (AsyncLogger::kRingCapacity - 1)];
+    }
+    void commitPush() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+    bool pop(LogRecord* out) {
+        const size_t head_value = head.load(std::memory_order_relaxed);
+        if (head_value == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        *out = records[head_value & (AsyncLogger::kRingCapacity - 1)];
+        head.store(head_value + 1, std::memory_order_release);
+        return true;
+    }
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+    std::atomic<bool> orphaned{ false }; // 生产线程已退出，排空后可以回收
+
+private:
+    LogRecord records[AsyncLogger::kRingCapacity];
+    alignas(64) std::atomic<size_t> head{ 0 };
+    alignas(64) std::atomic<size_t> tail{ 0 };
+};
+
+// 线程退出时把缓冲区标记为孤儿，由后台线程排空后释放
+struct RingHandle {
+    LogRing* ring = nullptr;
+    ~RingHandle() {
+        if (ring) ring->orphaned.store(true, std::memory_order_release);
+    }
+};
+thread_local RingHandle tls_ring;
+
+struct TextRecord {
+    int64_t timestamp_ns;
+    QtMsgType type;
+    QString message;
+};
+
+// 待输出的一行
+struct Line {
+    int64_t timestamp_ns;
+    QtMsgType type;
+    QString message;
+};
+
+QtMsgType toQtType(LogLevel level) {
+    switch (level) {
+    case LogLevel::Trace:
+    case LogLevel::Debug: return QtDebugMsg;
+    case LogLevel::Info: return QtInfoMsg;
+    case LogLevel::Warning: return QtWarningMsg;
+    case LogLevel::Error: return QtCriticalMsg;
+    }
+    return QtDebugMsg;
+}
+
+// 与 customMessageHandler 相同的前缀
+QString prefixOf(QtMsgType type) {
+    switch (type) {
+    case QtInfoMsg: return QStringLiteral("INFO: ");
+    case QtWarningMsg: return QStringLiteral("警告: ");
+    case QtCriticalMsg: return QStringLiteral("严重错误: ");
+    case QtFatalMsg: return QStringLiteral("致命错误: ");
+    default: return QString();
+    }
+}
+
+} // namespace
+
+struct AsyncLogger::Impl {
+    QMutex registry_mutex;
+    std::vector<std::unique_ptr<LogRing>> rings;
+
+    QMutex text_mutex;
+    std::vector<TextRecord> text_queue;
+
+    QMutex wait_mutex;
+    QWaitCondition wake;
+    bool stop_requested = false;
+    QThread* thread = nullptr;
+    QtMessageHandler console_handler = nullptr;
+
+    // 以下只由后台线程访问
+    std::vector<Line> batch;
+    QStringList ui_lines;
+    uint64_t ui_suppressed = 0;
+    uint64_t reported_dropped = 0;
+    std::chrono::steady_clock::time_point last_ui_emit;
+};
+
+AsyncLogger& AsyncLogger::instance() {
+    static AsyncLogger logger;
+    return logger;
+}
+
+AsyncLogger::AsyncLogger() : impl(new Impl()) {
+}
+
+AsyncLogger::~AsyncLogger() {
+    stop();
+    delete impl;
+}
+
+LogRecord* AsyncLogger::beginRecord() {
+    AsyncLogger& logger = instance();
+    if (!tls_ring.ring) {
+        auto ring = std::make_unique<LogRing>();
+        tls_ring.ring = ring.get();
+        QMutexLocker lock(&logger.impl->registry_mutex);
+        logger.impl->rings.push_back(std::move(ring));
+    }
+    LogRecord* record = tls_ring.ring->beginPush();
+    if (!record) {
+        logger.dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    record->timestamp_ns = nowNs();
+    return record;
+}
+
+void AsyncLogger::commitRecord() {
+    tls_ring.ring->commitPush();
+}
+
+void AsyncLogger::start(QtMessageHandler console_handler) {
+    if (running.load()) return;
+    impl->console_handler = console_handler;
+    {
+        QMutexLocker lock(&impl->wait_mutex);
+        impl->stop_requested = false;
+    }
+    impl->last_ui_emit = std::chrono::steady_clock::now();
+    running.store(true, std::memory_order_release);
+    impl->thread = QThread::create([this]() { run(); });
+    impl->thread->start(QThread::LowPriority);
+}
+
+void AsyncLogger::stop() {
+    if (!impl->thread) return;
+    {
+        QMutexLocker lock(&impl->wait_mutex);
+        impl->stop_requested = true;
+        impl->wake.wakeAll();
+    }
+    impl->thread->wait();
+    delete impl->thread;
+    impl->thread = nullptr;
+    running.store(false, std::memory_order_release);
+}
+
+void AsyncLogger::logText(QtMsgType type, const QString& message) {
+    QMutexLocker lock(&impl->text_mutex);
+    impl->text_queue.push_back({ nowNs(), type, message });
+}
+
+void AsyncLogger::run() {
+    for (;;) {
+        bool stopping;
+        {
+            QMutexLocker lock(&impl->wait_mutex);
+            if (!impl->stop_requested) {
+                impl->wake.wait(&impl->wait_mutex, kFlushIntervalMs);
+            }
+            stopping = impl->stop_requested;
+        }
+        drain(stopping);
+        if (stopping) break;
+    }
+}
+
+// 收集所有线程的记录和 Qt 消息，按时间排序后格式化；界面按 kUiIntervalMs 聚合发送
+void AsyncLogger::drain(bool final_pass) {
+    std::vector<Line>& batch = impl->batch;
+    batch.clear();
+
+    {
+        QMutexLocker lock(&impl->registry_mutex);
+        LogRecord record;
+        char text[512];
+        for (auto it = impl->rings.begin(); it != impl->rings.end();) {
+            LogRing& ring = **it;
+            while (ring.pop(&record)) {
+                record.formatter(record, text, sizeof(text));
+                batch.push_back({ record.timestamp_ns, toQtType(record.level), QString::fromUtf8(text) });
+            }
+            // 线程已退出且排空的缓冲区回收，避免反复启动发送任务后不断增长
+            if (ring.orphaned.load(std::memory_order_acquire) && ring.empty()) {
+                it = impl->rings.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+    {
+        std::vector<TextRecord> texts;
+        {
+            QMutexLocker lock(&impl->text_mutex);
+            texts.swap(impl->text_queue);
+        }
+        for (TextRecord& text : texts) {
+            batch.push_back({ text.timestamp_ns, text.type, std::move(text.message) });
+        }
+    }
+    std::stable_sort(batch.begin(), batch.end(),
+        [](const Line& a, const Line& b) { return a.timestamp_ns < b.timestamp_ns; });
+
+    for (const Line& line : batch) {
+        if (impl->console_handler) {
+            impl->console_handler(line.type, QMessageLogContext(), line.message);
+        }
+        if (impl->ui_lines.size() >= kMaxUiLines) {
+            impl->ui_suppressed++;
+            continue;
+        }
+        const QString time = QDateTime::fromMSecsSinceEpoch(line.timestamp_ns / 1000000)
+            .toString("yyyy-MM-dd hh:mm:ss.zzz ");
+        impl->ui_lines.append(time + prefixOf(line.type) + line.message);
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if (!final_pass && now - impl->last_ui_emit < std::chrono::milliseconds(kUiIntervalMs)) {
+        return;
+    }
+    const uint64_t dropped_now = dropped.load(std::memory_order_relaxed);
+    if (impl->ui_suppressed > 0) {
+        impl->ui_lines.append(QStringLiteral("…… 本周期另有 %1 条日志未显示").arg(impl->ui_suppressed));
+    }
+    if (dropped_now != impl->reported_dropped) {
+        impl->ui_lines.append(QStringLiteral("日志缓冲区已满，累计丢弃 %1 条记录").arg(dropped_now));
+        impl->reported_dropped = dropped_now;
+    }
+    if (!impl->ui_lines.isEmpty() && LogEmitter::instance()) {
+        emit LogEmitter::instance()->newLogMessage(impl->ui_lines.join('\n'));
+    }
+    impl->ui_lines.clear();
+    impl->ui_suppressed = 0;
+    impl->last_ui_emit = now;
+}
@@ -0,0 +1,129 @@
+﻿#pragma once
+#include <QString>
+#include <QtGlobal>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+// 日志级别
+enum class LogLevel : uint8_t {
+    Trace = 0,   // 每个包一条的热路径日志
+    Debug = 1,
+    Info = 2,
+    Warning = 3,
+    Error = 4,
+};
+
+// 编译期级别过滤：低于该级别的 LOG_* 调用连同参数求值一起被编译器删除。
+// 默认去掉 Trace，需要逐包日志时在工程里定义 CHSIM_LOG_MIN_LEVEL=0。
+#ifndef CHSIM_LOG_MIN_LEVEL
+#define CHSIM_LOG_MIN_LEVEL 1
+#endif
+
+#define CHSIM_LOG(level, format, ...)                                                  \
+    do {                                                                              \
+        if constexpr (static_cast<int>(level) >= CHSIM_LOG_MIN_LEVEL) {               \
+            AsyncLogger::log(level, format, ##__VA_ARGS__);                           \
+        }                                                                             \
+    } while (0)
+
+// printf 风格，format 和字符串参数必须是字面量或静态存储（格式化在后台线程延后进行）。
+// 动态字符串请继续用 qDebug/qWarning，它们走慢路径。
+#define LOG_TRACE(format, ...) CHSIM_LOG(LogLevel::Trace, format, ##__VA_ARGS__)
+#define LOG_DEBUG(format, ...) CHSIM_LOG(LogLevel::Debug, format, ##__VA_ARGS__)
+#define LOG_INFO(format, ...) CHSIM_LOG(LogLevel::Info, format, ##__VA_ARGS__)
+#define LOG_WARN(format, ...) CHSIM_LOG(LogLevel::Warning, format, ##__VA_ARGS__)
+#define LOG_ERROR(format, ...) CHSIM_LOG(LogLevel::Error, format, ##__VA_ARGS__)
+
+// 二进制日志记录：只保存格式串指针和原始参数，文本在后台线程生成
+struct LogRecord {
+    static constexpr size_t kArgSlotSize = 8;
+    static constexpr size_t kMaxArgs = 6;
+    using Formatter = int (*)(const LogRecord& record, char* out, size_t capacity);
+
+    int64_t timestamp_ns = 0; // system_clock
+    const char* format = nullptr;
+    Formatter formatter = nullptr;
+    LogLevel level = LogLevel::Debug;
+    alignas(8) unsigned char args[kArgSlotSize * kMaxArgs];
+};
+
+// 异步日志：每个生产线程一个无锁单生产者环形缓冲区，后台线程合并、格式化，
+// 并以固定间隔把聚合后的文本一次性交给 LogEmitter，界面线程不会收到逐条信号。
+// 缓冲区满时直接丢弃并计数，热路径永远不会阻塞。
+class AsyncLogger {
+public:
+    static constexpr int kRingCapacity = 4096;   // 每线程记录数，必须是2的幂
+    static constexpr int kFlushIntervalMs = 20;  // 后台线程轮询间隔
+    static constexpr int kUiIntervalMs = 100;    // 界面最多每 100ms 更新一次
+    static constexpr int kMaxUiLines = 200;      // 每次最多向界面发送的行数，其余只计数
+
+    static AsyncLogger& instance();
+
+    void start(QtMessageHandler console_handler = nullptr); // 启动后台线程，console_handler 用于控制台输出
+    void stop();                                            // 输出剩余日志后停止
+    bool isRunning() const { return running.load(std::memory_order_acquire); }
+
+    template <typename... Args>
+    static void log(LogLevel level, const char* format, Args... args);
+
+    // qDebug 等 Qt 消息的慢路径：已经是文本，加锁入队后同样由后台线程批量输出
+    void logText(QtMsgType type, const QString& message);
+
+    uint64_t droppedRecords() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    AsyncLogger();
+    ~AsyncLogger();
+
+    // 取得当前线程环形缓冲区的下一个空槽（已写好时间戳），满时返回 nullptr
+    static LogRecord* beginRecord();
+    static void commitRecord();
+
+    template <typename T>
+    static T loadArg(const unsigned char* slot) {
+        T value;
+        memcpy(&value, slot, sizeof(T));
+        return value;
+    }
+
+    template <typename... Args, size_t... I>
+    static int formatImpl(const LogRecord& record, char* out, size_t capacity, std::index_sequence<I...>) {
+        return snprintf(out, capacity, record.format, loadArg<Args>(record.args + I * LogRecord::kArgSlotSize)...);
+    }
+
+    template <typename... Args>
+    static int formatRecord(const LogRecord& record, char* out, size_t capacity) {
+        return formatImpl<Args...>(record, out, capacity, std::index_sequence_for<Args...>());
+    }
+
+    void run();
+    void drain(bool final_pass);
+
+    struct Impl;
+    Impl* impl = nullptr;
+    std::atomic<bool> running{ false };
+    std::atomic<uint64_t> dropped{ 0 };
+};
+
+template <typename... Args>
+void AsyncLogger::log(LogLevel level, const char* format, Args... args) {
+    static_assert(sizeof...(Args) <= LogRecord::kMaxArgs, "too many log arguments");
+    static_assert(((std::is_arithmetic<Args>::value || std::is_pointer<Args>::value) && ...),
+        "log arguments must be numbers or pointers to static strings");
+    static_assert(((sizeof(Args) <= LogRecord::kArgSlotSize) && ...), "log argument too large");
+
+    LogRecord* record = beginRecord();
+    if (!record) return; // 缓冲区满，已计入 dropped
+    record->format = format;
+    record->formatter = &formatRecord<Args...>;
+    record->level = level;
+    size_t slot = 0;
+    ((memcpy(record->args + (slot++) * LogRecord::kArgSlotSize, &args, sizeof(Args))), ...);
+    (void)slot;
+    commitRecord();
+}
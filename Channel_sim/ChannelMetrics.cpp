@@ -0,0 +1,545 @@
+﻿#include "ChannelMetrics.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <algorithm>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+// 最高有效位的位置，value 必须非零
+int highestBit(uint64_t value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<int>(index);
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+} // namespace
+
+int LatencyHistogram::bucketIndex(uint64_t value) {
+    if (value < 2 * kSubBuckets) {
+        return static_cast<int>(value);
+    }
+    const int magnitude = highestBit(value);
+    if (magnitude > kMaxMagnitude) {
+        return kBucketCount - 1;
+    }
+    const int shift = magnitude - kSubBucketBits;
+    const int sub_bucket = static_cast<int>((value >> shift) & (kSubBuckets - 1));
+    return 2 * kSubBuckets + (magnitude - kSubBucketBits - 1) * kSubBuckets + sub_bucket;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(int index) {
+    if (index < 2 * kSubBuckets) {
+        return static_cast<uint64_t>(index);
+    }
+    const int magnitude = (index - 2 * kSubBuckets) / kSubBuckets + kSubBucketBits + 1;
+    const int sub_bucket = (index - 2 * kSubBuckets) % kSubBuckets;
+    const int shift = magnitude - kSubBucketBits;
+    return ((static_cast<uint64_t>(kSubBuckets + sub_bucket + 1)) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value) {
+    std::atomic<uint64_t>& bucket = buckets[bucketIndex(value)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    sum.store(sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    if (value > max.load(std::memory_order_relaxed)) {
+        max.store(value, std::memory_order_relaxed);
+    }
+    // count 最后更新，读线程看到的桶计数不会少于 count
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void LatencyHistogram::snapshot(Snapshot* out) const {
+    out->count = count.load(std::memory_order_acquire);
+    out->sum = sum.load(std::memory_order_relaxed);
+    out->max = max.load(std::memory_order_relaxed);
+    for (int i = 0; i < kBucketCount; ++i) {
+        out->buckets[i] = buckets[i].load(std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::reset() {
+    for (std::atomic<uint64_t>& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    sum.store(0, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+    count.store(0, std::memory_order_release);
+}
+
+uint64_t LatencyHistogram::Snapshot::percentile(double p) const {
+    if (count == 0) return 0;
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(p * count + 0.5));
+    uint64_t seen = 0;
+    for (int i = 0; i < kBucketCount; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return std::min(bucketUpperBound(i), max);
+        }
+    }
+    return max;
+}
+
+void ChannelMetrics::recordPacingLag(int64_t lag_ns) {
+    pacing_lag_ns.store(lag_ns, std::memory_order_relaxed);
+    // 多个读取线程可能同时更新最大值，比较交换失败时按新读到的值重试
+    int64_t current = pacing_lag_max_ns.load(std::memory_order_relaxed);
+    while (lag_ns > current && !pacing_lag_max_ns.compare_exchange_weak(current, lag_ns, std::memory_order_relaxed)) {
+    }
+}
+
+void ChannelMetrics::reset() {
+    packets_enqueued.store(0);
+    media_packets.store(0);
+    parity_packets.store(0);
+    fec_groups.store(0);
+    pacing_lag_ns.store(0);
+    pacing_lag_max_ns.store(0);
+    packets_sent.store(0);
+    bytes_sent.store(0);
+    media_bytes_sent.store(0);
+    packets_dropped.store(0);
+    retransmissions_sent.store(0);
+    retransmitted_bytes.store(0);
+    packets_expired.store(0);
+    bytes_expired.store(0);
+    sendto_errors.store(0);
+    queue_wait_ns.reset();
+    for (LatencyHistogram& histogram : class_wait_ns) histogram.reset();
+    send_latency_ns.reset();
+    ingest_to_wire_ns.reset();
+    release_lateness_ns.reset();
+    pacer_delay_ns.reset();
+    queue_depth.store(0);
+    failovers.store(0);
+    packets_rescued.store(0);
+    failover_ns.reset();
+    fec_lost_packets.store(0);
+    fec_recovered_packets.store(0);
+}
+
+void MetricsRateWindow::apply(MetricsSnapshot* snapshot, int64_t now_ms) {
+    const size_t num_channels = snapshot->channels.size();
+    Sample sample;
+    sample.time_ms = now_ms;
+    for (const ChannelMetricsSnapshot& channel : snapshot->channels) {
+        sample.channels.push_back({ channel.bytes_sent, channel.media_bytes_sent, channel.packets_sent,
+            channel.packets_dropped, channel.fec_lost_packets, channel.fec_recovered_packets });
+    }
+
+    QMutexLocker lock(&mutex);
+    // 计数器被重置（重新开始发送）后旧样本失效
+    if (!samples.empty()) {
+        const std::vector<Counters>& last = samples.back().channels;
+        bool counters_reset = last.size() != num_channels;
+        for (size_t i = 0; i < num_channels && !counters_reset; ++i) {
+            counters_reset = sample.channels[i].packets_sent < last[i].packets_sent ||
+                sample.channels[i].packets_dropped < last[i].packets_dropped;
+        }
+        if (counters_reset) samples.clear();
+    }
+    while (samples.size() > 1 && now_ms - samples[1].time_ms >= window_ms) {
+        samples.pop_front();
+    }
+    if (!samples.empty() && now_ms > samples.front().time_ms) {
+        const Sample& oldest = samples.front();
+        const double seconds = (now_ms - oldest.time_ms) / 1000.0;
+        for (size_t i = 0; i < num_channels; ++i) {
+            ChannelMetricsSnapshot& channel = snapshot->channels[i];
+            const Counters& now = sample.channels[i];
+            const Counters& then = oldest.channels[i];
+            const uint64_t sent = now.packets_sent - then.packets_sent;
+            const uint64_t dropped = now.packets_dropped - then.packets_dropped;
+            const uint64_t lost = now.fec_lost_packets - then.fec_lost_packets;
+            channel.send_bitrate_bps = (now.bytes_sent - then.bytes_sent) * 8 / seconds;
+            channel.goodput_bps = (now.media_bytes_sent - then.media_bytes_sent) * 8 / seconds;
+            channel.send_packet_rate = sent / seconds;
+            channel.drop_rate = (sent + dropped) ? static_cast<double>(dropped) / (sent + dropped) : 0.0;
+            channel.fec_recovery_rate = lost
+                ? static_cast<double>(now.fec_recovered_packets - then.fec_recovered_packets) / lost : 1.0;
+        }
+    }
+    samples.push_back(std::move(sample));
+}
+
+void MetricsRateWindow::reset() {
+    QMutexLocker lock(&mutex);
+    samples.clear();
+}
+
+namespace metrics {
+
+LatencySummary summarize(const LatencyHistogram& histogram) {
+    LatencyHistogram::Snapshot snapshot;
+    histogram.snapshot(&snapshot);
+    LatencySummary summary;
+    summary.count = snapshot.count;
+    summary.sum_ns = snapshot.sum;
+    summary.mean_us = snapshot.mean() / 1000.0;
+    summary.p50_us = snapshot.percentile(0.50) / 1000.0;
+    summary.p90_us = snapshot.percentile(0.90) / 1000.0;
+    summary.p99_us = snapshot.percentile(0.99) / 1000.0;
+    summary.max_us = snapshot.max / 1000.0;
+    return summary;
+}
+
+QJsonObject latencyToJson(const LatencySummary& summary) {
+    QJsonObject object;
+    object["count"] = static_cast<qint64>(summary.count);
+    object["mean_us"] = summary.mean_us;
+    object["p50_us"] = summary.p50_us;
+    object["p90_us"] = summary.p90_us;
+    object["p99_us"] = summary.p99_us;
+    object["max_us"] = summary.max_us;
+    return object;
+}
+
+QJsonObject delayToJson(const OneWayDelaySnapshot& delay) {
+    QJsonObject object;
+    object["channel"] = delay.channel;
+    object["samples"] = static_cast<qint64>(delay.samples);
+    object["discarded"] = static_cast<qint64>(delay.discarded);
+    object["clock_offset_ms"] = delay.clock_offset_ms;
+    object["delay_ms"] = delay.delay_ms;
+    object["jitter_ms"] = delay.jitter_ms;
+    object["drift_ppm"] = delay.drift_ppm;
+    object["variation"] = latencyToJson(delay.variation);
+    return object;
+}
+
+QJsonObject retransmissionToJson(const RetransmissionSnapshot& retransmission) {
+    QJsonObject object;
+    object["repair_budget"] = retransmission.repair_budget;
+    object["nack_reports"] = static_cast<qint64>(retransmission.nack_reports);
+    object["requested"] = static_cast<qint64>(retransmission.requested);
+    object["queued"] = static_cast<qint64>(retransmission.queued);
+    object["not_in_history"] = static_cast<qint64>(retransmission.not_in_history);
+    object["too_soon"] = static_cast<qint64>(retransmission.too_soon);
+    object["exhausted"] = static_cast<qint64>(retransmission.exhausted);
+    object["parity_skipped"] = static_cast<qint64>(retransmission.parity_skipped);
+    object["budget_denied"] = static_cast<qint64>(retransmission.budget_denied);
+    return object;
+}
+
+QJsonObject bweToJson(const BandwidthEstimateSnapshot& bwe) {
+    static const char* const kUsageNames[] = { "normal", "underusing", "overusing" };
+    QJsonObject object;
+    object["target_bps"] = bwe.target_bps;
+    object["delay_based_bps"] = bwe.delay_based_bps;
+    object["loss_based_bps"] = bwe.loss_based_bps;
+    object["acked_bps"] = bwe.acked_bps;
+    object["rtt_ms"] = bwe.rtt_ms;
+    object["loss_fraction"] = bwe.loss_fraction;
+    object["usage"] = kUsageNames[std::max(0, std::min(bwe.usage, 2))];
+    object["threshold_ms"] = bwe.threshold_ms;
+    object["feedback_reports"] = static_cast<qint64>(bwe.feedback_reports);
+    object["feedback_lost"] = static_cast<qint64>(bwe.feedback_lost);
+    object["overuse_events"] = static_cast<qint64>(bwe.overuse_events);
+    return object;
+}
+
+ChannelMetricsSnapshot snapshotChannel(int channel, const ChannelMetrics& metrics) {
+    ChannelMetricsSnapshot snapshot;
+    snapshot.channel = channel;
+    snapshot.packets_enqueued = metrics.packets_enqueued.load(std::memory_order_relaxed);
+    snapshot.media_packets = metrics.media_packets.load(std::memory_order_relaxed);
+    snapshot.parity_packets = metrics.parity_packets.load(std::memory_order_relaxed);
+    snapshot.fec_groups = metrics.fec_groups.load(std::memory_order_relaxed);
+    snapshot.pacing_lag_us = metrics.pacing_lag_ns.load(std::memory_order_relaxed) / 1000.0;
+    snapshot.pacing_lag_max_us = metrics.pacing_lag_max_ns.load(std::memory_order_relaxed) / 1000.0;
+    snapshot.packets_sent = metrics.packets_sent.load(std::memory_order_relaxed);
+    snapshot.bytes_sent = metrics.bytes_sent.load(std::memory_order_relaxed);
+    snapshot.media_bytes_sent = metrics.media_bytes_sent.load(std::memory_order_relaxed);
+    snapshot.packets_dropped = metrics.packets_dropped.load(std::memory_order_relaxed);
+    snapshot.sendto_errors = metrics.sendto_errors.load(std::memory_order_relaxed);
+    snapshot.retransmissions_sent = metrics.retransmissions_sent.load(std::memory_order_relaxed);
+    snapshot.retransmitted_bytes = metrics.retransmitted_bytes.load(std::memory_order_relaxed);
+    snapshot.packets_expired = metrics.packets_expired.load(std::memory_order_relaxed);
+    snapshot.bytes_expired = metrics.bytes_expired.load(std::memory_order_relaxed);
+    snapshot.failovers = metrics.failovers.load(std::memory_order_relaxed);
+    snapshot.packets_rescued = metrics.packets_rescued.load(std::memory_order_relaxed);
+    snapshot.queue_depth = metrics.queue_depth.load(std::memory_order_relaxed);
+    snapshot.fec_lost_packets = metrics.fec_lost_packets.load(std::memory_order_relaxed);
+    snapshot.fec_recovered_packets = metrics.fec_recovered_packets.load(std::memory_order_relaxed);
+    snapshot.queue_wait = summarize(metrics.queue_wait_ns);
+    for (int i = 0; i < kQueueClassCount; ++i) {
+        snapshot.class_wait[i] = summarize(metrics.class_wait_ns[i]);
+    }
+    snapshot.send_latency = summarize(metrics.send_latency_ns);
+    snapshot.ingest_to_wire = summarize(metrics.ingest_to_wire_ns);
+    snapshot.release_lateness = summarize(metrics.release_lateness_ns);
+    snapshot.pacer_delay = summarize(metrics.pacer_delay_ns);
+    snapshot.failover_time = summarize(metrics.failover_ns);
+    return snapshot;
+}
+
+QByteArray toJson(const MetricsSnapshot& snapshot) {
+    QJsonArray channels;
+    for (const ChannelMetricsSnapshot& channel : snapshot.channels) {
+        QJsonObject object;
+        object["channel"] = channel.channel;
+        object["enabled"] = channel.enabled;
+        object["packets_enqueued"] = static_cast<qint64>(channel.packets_enqueued);
+        object["packets_sent"] = static_cast<qint64>(channel.packets_sent);
+        object["bytes_sent"] = static_cast<qint64>(channel.bytes_sent);
+        object["media_bytes_sent"] = static_cast<qint64>(channel.media_bytes_sent);
+        object["packets_dropped"] = static_cast<qint64>(channel.packets_dropped);
+        object["sendto_errors"] = static_cast<qint64>(channel.sendto_errors);
+        object["retransmissions_sent"] = static_cast<qint64>(channel.retransmissions_sent);
+        object["retransmitted_bytes"] = static_cast<qint64>(channel.retransmitted_bytes);
+        object["packets_expired"] = static_cast<qint64>(channel.packets_expired);
+        object["bytes_expired"] = static_cast<qint64>(channel.bytes_expired);
+        object["failovers"] = static_cast<qint64>(channel.failovers);
+        object["packets_rescued"] = static_cast<qint64>(channel.packets_rescued);
+        object["media_packets"] = static_cast<qint64>(channel.media_packets);
+        object["parity_packets"] = static_cast<qint64>(channel.parity_packets);
+        object["fec_groups"] = static_cast<qint64>(channel.fec_groups);
+        object["fec_lost_packets"] = static_cast<qint64>(channel.fec_lost_packets);
+        object["fec_recovered_packets"] = static_cast<qint64>(channel.fec_recovered_packets);
+        object["queue_depth"] = channel.queue_depth;
+        object["pacing_lag_us"] = channel.pacing_lag_us;
+        object["pacing_lag_max_us"] = channel.pacing_lag_max_us;
+        object["send_bitrate_bps"] = channel.send_bitrate_bps;
+        object["goodput_bps"] = channel.goodput_bps;
+        object["send_packet_rate"] = channel.send_packet_rate;
+        object["drop_rate"] = channel.drop_rate;
+        object["fec_recovery_rate"] = channel.fec_recovery_rate;
+        object["queue_wait"] = latencyToJson(channel.queue_wait);
+        QJsonObject class_wait;
+        for (int i = 0; i < kQueueClassCount; ++i) {
+            class_wait[queueClassName(static_cast<QueueClass>(i))] = latencyToJson(channel.class_wait[i]);
+        }
+        object["queue_wait_by_class"] = class_wait;
+        object["send_latency"] = latencyToJson(channel.send_latency);
+        object["ingest_to_wire"] = latencyToJson(channel.ingest_to_wire);
+        object["release_lateness"] = latencyToJson(channel.release_lateness);
+        if (channel.failovers > 0) {
+            object["failover_time"] = latencyToJson(channel.failover_time);
+        }
+        if (channel.bwe.active) {
+            object["pacer_delay"] = latencyToJson(channel.pacer_delay);
+            object["bwe"] = bweToJson(channel.bwe);
+        }
+        channels.append(object);
+    }
+    QJsonArray inputs;
+    for (const IngestSnapshot& input : snapshot.inputs) {
+        QJsonObject object;
+        object["stream_type"] = input.stream_type;
+        object["source"] = input.source;
+        object["live"] = input.live;
+        object["bytes_in"] = static_cast<qint64>(input.bytes_in);
+        object["blocks_in"] = static_cast<qint64>(input.blocks_in);
+        object["bytes_dropped"] = static_cast<qint64>(input.bytes_dropped);
+        object["blocks_dropped"] = static_cast<qint64>(input.blocks_dropped);
+        object["buffered_bytes"] = static_cast<qint64>(input.buffered_bytes);
+        object["peak_buffered_bytes"] = static_cast<qint64>(input.peak_buffered_bytes);
+        object["capacity_bytes"] = static_cast<qint64>(input.capacity_bytes);
+        inputs.append(object);
+    }
+    QJsonObject root;
+    root["timestamp_ms"] = static_cast<qint64>(snapshot.timestamp_ms);
+    root["channels"] = channels;
+    root["inputs"] = inputs;
+    if (!snapshot.delays.empty()) {
+        QJsonArray delays;
+        for (const OneWayDelaySnapshot& delay : snapshot.delays) {
+            delays.append(delayToJson(delay));
+        }
+        root["one_way_delay"] = delays;
+    }
+    if (snapshot.retransmission.active) {
+        root["retransmission"] = retransmissionToJson(snapshot.retransmission);
+    }
+    return QJsonDocument(root).toJson(QJsonDocument::Indented);
+}
+
+QByteArray toPrometheus(const MetricsSnapshot& snapshot) {
+    QByteArray out;
+    auto metric = [&](const char* name, const char* type, const char* help, auto value_of) {
+        out += QByteArray("# HELP ") + name + ' ' + help + '\n';
+        out += QByteArray("# TYPE ") + name + ' ' + type + '\n';
+        for (const ChannelMetricsSnapshot& channel : snapshot.channels) {
+            out += QByteArray(name) + "{channel=\"" + QByteArray::number(channel.channel) + "\"} " +
+                QByteArray::number(static_cast<double>(value_of(channel)), 'g', 17) + '\n';
+        }
+    };
+    // 延迟以 summary 导出：分位数 + _sum + _count，单位秒
+    auto summaryLines = [&](const char* name, const QByteArray& label, const LatencySummary& summary) {
+        const std::pair<const char*, double> quantiles[] = {
+            { "0.5", summary.p50_us }, { "0.9", summary.p90_us }, { "0.99", summary.p99_us } };
+        for (const auto& quantile : quantiles) {
+            out += QByteArray(name) + '{' + label + ",quantile=\"" + quantile.first + "\"} " +
+                QByteArray::number(quantile.second / 1e6, 'g', 9) + '\n';
+        }
+        out += QByteArray(name) + "_sum{" + label + "} " + QByteArray::number(summary.sum_ns / 1e9, 'g', 12) + '\n';
+        out += QByteArray(name) + "_count{" + label + "} " + QByteArray::number(static_cast<qulonglong>(summary.count)) + '\n';
+    };
+    auto latency = [&](const char* name, const char* help, LatencySummary ChannelMetricsSnapshot::* field) {
+        out += QByteArray("# HELP ") + name + ' ' + help + '\n';
+        out += QByteArray("# TYPE ") + name + " summary\n";
+        for (const ChannelMetricsSnapshot& channel : snapshot.channels) {
+            summaryLines(name, "channel=\"" + QByteArray::number(channel.channel) + "\"", channel.*field);
+        }
+    };
+
+    using Channel = ChannelMetricsSnapshot;
+    metric("chsim_channel_enabled", "gauge", "Whether the channel is enabled.",
+        [](const Channel& c) { return c.enabled ? 1 : 0; });
+    metric("chsim_packets_enqueued_total", "counter", "Packets queued for the channel, including copies.",
+        [](const Channel& c) { return c.packets_enqueued; });
+    metric("chsim_packets_sent_total", "counter", "Datagrams handed to sendto.",
+        [](const Channel& c) { return c.packets_sent; });
+    metric("chsim_bytes_sent_total", "counter", "Datagram bytes handed to sendto.",
+        [](const Channel& c) { return c.bytes_sent; });
+    metric("chsim_packets_dropped_total", "counter", "Datagrams dropped by loss simulation.",
+        [](const Channel& c) { return c.packets_dropped; });
+    metric("chsim_sendto_errors_total", "counter", "Failed or short sendto calls.",
+        [](const Channel& c) { return c.sendto_errors; });
+    metric("chsim_retransmissions_total", "counter", "Datagrams resent in response to NACKs.",
+        [](const Channel& c) { return c.retransmissions_sent; });
+    metric("chsim_retransmitted_bytes_total", "counter", "Datagram bytes resent in response to NACKs.",
+        [](const Channel& c) { return c.retransmitted_bytes; });
+    metric("chsim_packets_expired_total", "counter", "Datagrams dropped at dequeue because their stream deadline had passed.",
+        [](const Channel& c) { return c.packets_expired; });
+    metric("chsim_bytes_expired_total", "counter", "Datagram bytes dropped at dequeue because their stream deadline had passed.",
+        [](const Channel& c) { return c.bytes_expired; });
+    metric("chsim_failovers_total", "counter", "Times the channel was disabled or failed with packets migrated away.",
+        [](const Channel& c) { return c.failovers; });
+    metric("chsim_packets_rescued_total", "counter", "Queued packets moved to other channels on failover.",
+        [](const Channel& c) { return c.packets_rescued; });
+    metric("chsim_media_packets_total", "counter", "FEC media packets queued.",
+        [](const Channel& c) { return c.media_packets; });
+    metric("chsim_parity_packets_total", "counter", "FEC parity packets queued.",
+        [](const Channel& c) { return c.parity_packets; });
+    metric("chsim_fec_groups_total", "counter", "FEC groups started with this channel as primary.",
+        [](const Channel& c) { return c.fec_groups; });
+    metric("chsim_fec_lost_packets_total", "counter", "Packets lost in FEC groups with this channel as primary.",
+        [](const Channel& c) { return c.fec_lost_packets; });
+    metric("chsim_fec_recovered_packets_total", "counter", "Lost packets recoverable from parity.",
+        [](const Channel& c) { return c.fec_recovered_packets; });
+    metric("chsim_queue_depth", "gauge", "Packets waiting in the channel queue.",
+        [](const Channel& c) { return c.queue_depth; });
+    metric("chsim_pacing_lag_seconds", "gauge", "Oversleep of the most recent pacing delay.",
+        [](const Channel& c) { return c.pacing_lag_us / 1e6; });
+    metric("chsim_send_bitrate_bps", "gauge", "Send bitrate over the last second.",
+        [](const Channel& c) { return c.send_bitrate_bps; });
+    metric("chsim_goodput_bps", "gauge", "Media payload bitrate over the last second.",
+        [](const Channel& c) { return c.goodput_bps; });
+    metric("chsim_drop_ratio", "gauge", "Simulated drop ratio over the last second.",
+        [](const Channel& c) { return c.drop_rate; });
+    latency("chsim_queue_wait_seconds", "Time from enqueue to dequeue.", &Channel::queue_wait);
+    out += "# HELP chsim_class_queue_wait_seconds Time from enqueue to dequeue per queue priority class.\n";
+    out += "# TYPE chsim_class_queue_wait_seconds summary\n";
+    for (const ChannelMetricsSnapshot& channel : snapshot.channels) {
+        for (int i = 0; i < kQueueClassCount; ++i) {
+            summaryLines("chsim_class_queue_wait_seconds", "channel=\"" + QByteArray::number(channel.channel) +
+                "\",class=\"" + queueClassName(static_cast<QueueClass>(i)) + "\"", channel.class_wait[i]);
+        }
+    }
+    latency("chsim_send_latency_seconds", "Duration of one sendto call.", &Channel::send_latency);
+    latency("chsim_ingest_to_wire_seconds", "Time from payload ingest to sendto completion.", &Channel::ingest_to_wire);
+    latency("chsim_release_lateness_seconds", "Delay past the scheduled PCR release time.", &Channel::release_lateness);
+    latency("chsim_failover_seconds", "Time from failover trigger to queue migration.", &Channel::failover_time);
+
+    // 拥塞控制开启时才导出带宽估计
+    const bool bwe_active = std::any_of(snapshot.channels.begin(), snapshot.channels.end(),
+        [](const Channel& c) { return c.bwe.active; });
+    if (bwe_active) {
+        metric("chsim_bwe_target_bps", "gauge", "Bandwidth estimate used for channel pacing and weights.",
+            [](const Channel& c) { return c.bwe.target_bps; });
+        metric("chsim_bwe_delay_based_bps", "gauge", "Delay-based bandwidth estimate.",
+            [](const Channel& c) { return c.bwe.delay_based_bps; });
+        metric("chsim_bwe_acked_bps", "gauge", "Throughput acknowledged by receiver feedback.",
+            [](const Channel& c) { return c.bwe.acked_bps; });
+        metric("chsim_bwe_rtt_seconds", "gauge", "Round-trip time measured from feedback.",
+            [](const Channel& c) { return c.bwe.rtt_ms / 1e3; });
+        metric("chsim_bwe_loss_ratio", "gauge", "Loss fraction reported by feedback.",
+            [](const Channel& c) { return c.bwe.loss_fraction; });
+        metric("chsim_bwe_overuse", "gauge", "Delay gradient state: 0 normal, 1 underusing, 2 overusing.",
+            [](const Channel& c) { return c.bwe.usage; });
+        metric("chsim_bwe_overuse_events_total", "counter", "Overuse detections.",
+            [](const Channel& c) { return c.bwe.overuse_events; });
+        latency("chsim_pacer_delay_seconds", "Wait imposed by the channel pacer.", &Channel::pacer_delay);
+    }
+
+    // 重传请求的处理结果按 outcome 标签导出
+    const RetransmissionSnapshot& retransmission = snapshot.retransmission;
+    if (retransmission.active) {
+        out += "# HELP chsim_nack_reports_total NACK datagrams received from the receiver.\n";
+        out += "# TYPE chsim_nack_reports_total counter\n";
+        out += "chsim_nack_reports_total " + QByteArray::number(static_cast<qulonglong>(retransmission.nack_reports)) + '\n';
+        out += "# HELP chsim_nack_requests_total Sequence numbers requested by NACKs, by outcome.\n";
+        out += "# TYPE chsim_nack_requests_total counter\n";
+        const std::pair<const char*, uint64_t> outcomes[] = {
+            { "queued", retransmission.queued }, { "not_in_history", retransmission.not_in_history },
+            { "too_soon", retransmission.too_soon }, { "exhausted", retransmission.exhausted },
+            { "parity_skipped", retransmission.parity_skipped }, { "budget_denied", retransmission.budget_denied } };
+        for (const auto& outcome : outcomes) {
+            out += QByteArray("chsim_nack_requests_total{outcome=\"") + outcome.first + "\"} " +
+                QByteArray::number(static_cast<qulonglong>(outcome.second)) + '\n';
+        }
+    }
+
+    // 输入源按 stream 标签导出
+    auto input = [&](const char* name, const char* type, const char* help, auto value_of) {
+        if (snapshot.inputs.empty()) return;
+        out += QByteArray("# HELP ") + name + ' ' + help + '\n';
+        out += QByteArray("# TYPE ") + name + ' ' + type + '\n';
+        for (const IngestSnapshot& source : snapshot.inputs) {
+            out += QByteArray(name) + "{stream=\"" + QByteArray::number(source.stream_type) + "\"} " +
+                QByteArray::number(static_cast<double>(value_of(source)), 'g', 17) + '\n';
+        }
+    };
+    input("chsim_ingest_bytes_total", "counter", "Bytes received from the input source.",
+        [](const IngestSnapshot& s) { return s.bytes_in; });
+    input("chsim_ingest_dropped_bytes_total", "counter", "Bytes dropped because the ingest buffer was full.",
+        [](const IngestSnapshot& s) { return s.bytes_dropped; });
+    input("chsim_ingest_dropped_blocks_total", "counter", "Input blocks dropped because the ingest buffer was full.",
+        [](const IngestSnapshot& s) { return s.blocks_dropped; });
+    input("chsim_ingest_buffered_bytes", "gauge", "Bytes waiting in the ingest buffer.",
+        [](const IngestSnapshot& s) { return s.buffered_bytes; });
+
+    // 接收端的单向时延估计按 channel 标签导出
+    auto delay = [&](const char* name, const char* help, auto value_of) {
+        if (snapshot.delays.empty()) return;
+        out += QByteArray("# HELP ") + name + ' ' + help + '\n';
+        out += QByteArray("# TYPE ") + name + " gauge\n";
+        for (const OneWayDelaySnapshot& estimate : snapshot.delays) {
+            out += QByteArray(name) + "{channel=\"" + QByteArray::number(estimate.channel) + "\"} " +
+                QByteArray::number(static_cast<double>(value_of(estimate)), 'g', 17) + '\n';
+        }
+    };
+    delay("chsim_owd_clock_offset_seconds", "Receiver minus sender clock plus minimum propagation delay.",
+        [](const OneWayDelaySnapshot& d) { return d.clock_offset_ms / 1e3; });
+    delay("chsim_owd_delay_seconds", "Smoothed one-way delay above the baseline.",
+        [](const OneWayDelaySnapshot& d) { return d.delay_ms / 1e3; });
+    delay("chsim_owd_delay_p99_seconds", "99th percentile of one-way delay above the baseline.",
+        [](const OneWayDelaySnapshot& d) { return d.variation.p99_us / 1e6; });
+    delay("chsim_owd_jitter_seconds", "RFC 3550 interarrival jitter.",
+        [](const OneWayDelaySnapshot& d) { return d.jitter_ms / 1e3; });
+    delay("chsim_owd_clock_drift_ppm", "Relative drift between sender and receiver clocks.",
+        [](const OneWayDelaySnapshot& d) { return d.drift_ppm; });
+    return out;
+}
+
+bool writeFile(const QString& path, const MetricsSnapshot& snapshot, bool prometheus) {
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(prometheus ? toPrometheus(snapshot) : toJson(snapshot));
+    return file.commit();
+}
+
+} // namespace metrics
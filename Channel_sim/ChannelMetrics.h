@@ -0,0 +1,269 @@
+﻿#pragma once
+#include <QByteArray>
+#include <QJsonObject>
+#include <QString>
+#include <QMutex>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <deque>
+#include <vector>
+
+#include "SendQueue.h"
+
+// HDR 风格的延迟直方图：小于 16 的值各占一个桶，之后每个2的幂区间再线性分成 8 个子桶，
+// 相对误差不超过 12.5%，记录一次只是一次下标计算加一次原子写。
+// 只允许一个线程写（每个通道的发送线程写自己的直方图），读可以在任意线程进行。
+class LatencyHistogram {
+public:
+    static constexpr int kSubBucketBits = 3;
+    static constexpr int kSubBuckets = 1 << kSubBucketBits;
+    static constexpr int kMaxMagnitude = 40; // 2^40 ns 约 18 分钟，更大的值计入最后一个桶
+    static constexpr int kBucketCount = 2 * kSubBuckets + (kMaxMagnitude - kSubBucketBits) * kSubBuckets;
+
+    // 直方图的一份拷贝，在读线程上计算分位数
+    struct Snapshot {
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+        uint64_t buckets[kBucketCount] = {};
+
+        // p 取 0~1，返回所在桶的上界（不超过 max），没有数据时返回 0
+        uint64_t percentile(double p) const;
+        double mean() const { return count ? static_cast<double>(sum) / count : 0.0; }
+    };
+
+    void record(uint64_t value);
+    void snapshot(Snapshot* out) const;
+    void reset(); // 只能在写线程停止时调用
+
+    static int bucketIndex(uint64_t value);
+    static uint64_t bucketUpperBound(int index);
+
+private:
+    std::atomic<uint64_t> buckets[kBucketCount] = {};
+    std::atomic<uint64_t> count{ 0 };
+    std::atomic<uint64_t> sum{ 0 };
+    std::atomic<uint64_t> max{ 0 };
+};
+
+// 单个通道的计数器。字段按写线程分组放在不同的缓存行上：入队一侧和发送线程互不争用。
+// 只有一个写线程的字段用 add（relaxed 的读-加-写，没有带锁前缀的指令）；
+// 有多个写线程的字段必须用 addShared（fetch_add），否则并发的读-加-写会丢失计数。
+struct ChannelMetrics {
+    // 入队一侧：各输入的读取线程、播出线程、重传请求（反馈线程）和故障切换都会写，用 addShared
+    alignas(64) std::atomic<uint64_t> packets_enqueued{ 0 };
+    std::atomic<uint64_t> media_packets{ 0 };   // 入队的源包（含多路冗余的副本）
+    std::atomic<uint64_t> parity_packets{ 0 };  // 入队的冗余包
+    std::atomic<uint64_t> fec_groups{ 0 };      // 以该通道为主通道的组数
+    std::atomic<int64_t> pacing_lag_ns{ 0 };    // 最近一次限速睡眠超出预期的时长（多个线程写时取最后写入的）
+    std::atomic<int64_t> pacing_lag_max_ns{ 0 };
+
+    // 发送线程（每个通道一个），用 add
+    alignas(64) std::atomic<uint64_t> packets_sent{ 0 };
+    std::atomic<uint64_t> bytes_sent{ 0 };
+    std::atomic<uint64_t> media_bytes_sent{ 0 }; // 成功发出的源包负载字节（有效吞吐）
+    std::atomic<uint64_t> packets_dropped{ 0 }; // 模拟丢包
+    std::atomic<uint64_t> sendto_errors{ 0 };
+    std::atomic<uint64_t> retransmissions_sent{ 0 }; // 应重传请求发出的数据报（同时计入 packets_sent / bytes_sent）
+    std::atomic<uint64_t> retransmitted_bytes{ 0 };
+    std::atomic<uint64_t> packets_expired{ 0 };  // 在队列里超过截止时刻、出队时丢弃的数据报
+    std::atomic<uint64_t> bytes_expired{ 0 };
+    LatencyHistogram queue_wait_ns;             // 入队到出队
+    LatencyHistogram class_wait_ns[kQueueClassCount]; // 入队到出队，按队列的优先级类别（QueueClass）分别统计
+    LatencyHistogram send_latency_ns;           // 单次 sendto 调用耗时
+    LatencyHistogram ingest_to_wire_ns;         // 负载进入发送端（直播源收到或从文件读出）到 sendto 完成
+    LatencyHistogram pacer_delay_ns;            // 拥塞控制的通道限速等待（未开启时为空）
+
+    // 播出线程（PCR 播出模式）
+    alignas(64) LatencyHistogram release_lateness_ns; // 预定发送时刻到实际放入通道队列
+
+    // 队列锁内更新，任意线程可读
+    alignas(64) std::atomic<int> queue_depth{ 0 };
+
+    // 故障切换：通道被禁用或判定失效时把队列里的包迁到其他通道，在持有全部队列锁时更新
+    std::atomic<uint64_t> failovers{ 0 };
+    std::atomic<uint64_t> packets_rescued{ 0 }; // 迁到其他通道的包
+    LatencyHistogram failover_ns;               // 触发（禁用调用、第一次发送失败或最后一次反馈）到迁移完成
+
+    // 组结束时由最后一个结束的发送线程汇总，写线程不固定，用 fetch_add
+    std::atomic<uint64_t> fec_lost_packets{ 0 };      // 以该通道为主通道的组中丢失的包（源包和冗余包）
+    std::atomic<uint64_t> fec_recovered_packets{ 0 }; // 其中可由冗余包恢复的部分（组内丢包数不超过 r）
+
+    // 只有一个写线程的计数
+    static void add(std::atomic<uint64_t>& counter, uint64_t value = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+    // 多个线程都会写的计数
+    static void addShared(std::atomic<uint64_t>& counter, uint64_t value = 1) {
+        counter.fetch_add(value, std::memory_order_relaxed);
+    }
+    void recordPacingLag(int64_t lag_ns);
+    void reset();
+};
+
+// 延迟分布的摘要，单位微秒
+struct LatencySummary {
+    uint64_t count = 0;
+    double mean_us = 0;
+    double p50_us = 0;
+    double p90_us = 0;
+    double p99_us = 0;
+    double max_us = 0;
+    uint64_t sum_ns = 0;
+};
+
+// 发送端对一个通道的带宽估计（见 ChannelBandwidthEstimator），开启拥塞控制时填写
+struct BandwidthEstimateSnapshot {
+    bool active = false;
+    double target_bps = 0;      // 通道限速和多路权重使用的速率：min(基于时延, 基于丢包)
+    double delay_based_bps = 0;
+    double loss_based_bps = 0;
+    double acked_bps = 0;       // 接收端确认的吞吐
+    double rtt_ms = 0;
+    double loss_fraction = 0;   // 最近一个统计区间的丢包率
+    int usage = 0;              // 0 正常，1 欠载，2 过载（时延梯度检测结果）
+    double threshold_ms = 0;    // 过载检测的自适应门限
+    uint64_t feedback_reports = 0;
+    uint64_t feedback_lost = 0; // 按反馈序号推算
+    uint64_t overuse_events = 0;
+};
+
+struct ChannelMetricsSnapshot {
+    int channel = 0;
+    bool enabled = false;
+    uint64_t packets_enqueued = 0;
+    uint64_t packets_sent = 0;
+    uint64_t bytes_sent = 0;
+    uint64_t media_bytes_sent = 0;
+    uint64_t packets_dropped = 0;
+    uint64_t sendto_errors = 0;
+    uint64_t retransmissions_sent = 0;
+    uint64_t retransmitted_bytes = 0;
+    uint64_t packets_expired = 0;
+    uint64_t bytes_expired = 0;
+    uint64_t failovers = 0;
+    uint64_t packets_rescued = 0;
+    uint64_t media_packets = 0;
+    uint64_t parity_packets = 0;
+    uint64_t fec_groups = 0;
+    uint64_t fec_lost_packets = 0;
+    uint64_t fec_recovered_packets = 0;
+    int queue_depth = 0;
+    double pacing_lag_us = 0;
+    double pacing_lag_max_us = 0;
+    LatencySummary queue_wait;
+    std::array<LatencySummary, kQueueClassCount> class_wait; // 按 QueueClass 下标
+    LatencySummary send_latency;
+    LatencySummary ingest_to_wire;
+    LatencySummary release_lateness;
+    LatencySummary pacer_delay;
+    LatencySummary failover_time;
+    BandwidthEstimateSnapshot bwe;
+
+    // 以下为滑动窗口内的速率，由 MetricsRateWindow 填写
+    double send_bitrate_bps = 0;
+    double goodput_bps = 0; // 源包负载
+    double send_packet_rate = 0;
+    double drop_rate = 0; // 模拟丢弃数 / (发送数 + 模拟丢弃数)
+    double fec_recovery_rate = 1.0; // 可恢复的丢包 / 丢包，窗口内没有丢包时为 1
+};
+
+// 一个输入源（每个流一个）的统计快照
+struct IngestSnapshot {
+    int stream_type = 0;
+    QString source;
+    bool live = false;
+    uint64_t bytes_in = 0;
+    uint64_t blocks_in = 0;
+    uint64_t bytes_dropped = 0;
+    uint64_t blocks_dropped = 0;
+    uint64_t buffered_bytes = 0;
+    uint64_t peak_buffered_bytes = 0;
+    uint64_t capacity_bytes = 0;
+};
+
+// 接收端对一个通道的单向时延估计（见 OneWayDelayEstimator）
+struct OneWayDelaySnapshot {
+    int channel = 0;
+    uint64_t samples = 0;
+    uint64_t discarded = 0;     // 时间戳明显损坏而丢弃的样本
+    double clock_offset_ms = 0; // 基线：接收端时钟 - 发送端时钟 + 最小传播时延（同一台机器上即最小单向时延）
+    double delay_ms = 0;        // 高于基线的单向时延，指数平滑
+    double jitter_ms = 0;       // RFC 3550 到达间隔抖动
+    double drift_ppm = 0;       // 两端时钟的相对漂移
+    LatencySummary variation;   // 高于基线部分的分布
+};
+
+// 发送端对重传请求的处理（见 PacketHistory、RepairBudget），开启重传时填写
+struct RetransmissionSnapshot {
+    bool active = false;
+    double repair_budget = 0;    // 冗余包和重传共用的预算（相对源包字节数的比例）
+    uint64_t nack_reports = 0;   // 收到的重传请求报文
+    uint64_t requested = 0;      // 请求中的序列号
+    uint64_t queued = 0;         // 放入通道队列的重传
+    uint64_t not_in_history = 0; // 已超出历史缓存（太老或已被覆盖）
+    uint64_t too_soon = 0;       // 距上次重传不到一个 RTT，视为重复请求
+    uint64_t exhausted = 0;      // 达到最大重传次数
+    uint64_t parity_skipped = 0; // 冗余包不重传，接收端拿到缺失的源包即可
+    uint64_t budget_denied = 0;  // 预算不足
+};
+
+struct MetricsSnapshot {
+    int64_t timestamp_ms = 0; // 墙上时间
+    std::vector<ChannelMetricsSnapshot> channels;
+    std::vector<IngestSnapshot> inputs;
+    std::vector<OneWayDelaySnapshot> delays; // 接收端填写（压测、回放），发送端为空
+    RetransmissionSnapshot retransmission;
+};
+
+// 由累计计数计算窗口速率：保留最近 window_ms 内的快照，用窗口首尾的差值求速率。
+// 只在取快照时运行，热路径上没有任何额外开销。线程安全。
+class MetricsRateWindow {
+public:
+    explicit MetricsRateWindow(int64_t window_ms = 1000) : window_ms(window_ms) {}
+
+    // 用单调时钟 now_ms 填写 snapshot 中各通道的速率字段
+    void apply(MetricsSnapshot* snapshot, int64_t now_ms);
+    void reset();
+
+private:
+    struct Counters {
+        uint64_t bytes_sent;
+        uint64_t media_bytes_sent;
+        uint64_t packets_sent;
+        uint64_t packets_dropped;
+        uint64_t fec_lost_packets;
+        uint64_t fec_recovered_packets;
+    };
+    struct Sample {
+        int64_t time_ms;
+        std::vector<Counters> channels;
+    };
+
+    const int64_t window_ms;
+    QMutex mutex;
+    std::deque<Sample> samples;
+};
+
+namespace metrics {
+
+// 直方图的计数、均值和分位数（微秒）
+LatencySummary summarize(const LatencyHistogram& histogram);
+QJsonObject latencyToJson(const LatencySummary& summary);
+QJsonObject delayToJson(const OneWayDelaySnapshot& delay);
+QJsonObject bweToJson(const BandwidthEstimateSnapshot& bwe);
+QJsonObject retransmissionToJson(const RetransmissionSnapshot& retransmission);
+
+// 读取一个通道的计数器和直方图
+ChannelMetricsSnapshot snapshotChannel(int channel, const ChannelMetrics& metrics);
+
+// 导出格式：JSON（便于脚本处理）和 Prometheus 文本格式（便于 textfile collector 采集）
+QByteArray toJson(const MetricsSnapshot& snapshot);
+QByteArray toPrometheus(const MetricsSnapshot& snapshot);
+
+// 整体替换写入文件（先写临时文件再改名），读取方不会看到写了一半的内容
+bool writeFile(const QString& path, const MetricsSnapshot& snapshot, bool prometheus);
+
+} // namespace metrics
@@ -7,6 +7,8 @@ Channel_sim::Channel_sim(QWidget *parent)
 
 	stbar = this->statusBar();
 	this->setStatusBar(stbar);
+	// ־ֻУⳤʱкıԽԽ
+	ui.logTextEdit->document()->setMaximumBlockCount(5000);
 
 	connect(ui.file_action,&QAction::triggered, this, &Channel_sim::Readfile);
 	connect(ui.Channel1_checkbox, &QCheckBox::stateChanged, this, &Channel_sim::getChannelState_1);
@@ -22,6 +24,7 @@ Channel_sim::Channel_sim(QWidget *parent)
 	connect(ui.Play_btn, &QPushButton::clicked, this, &Channel_sim::start_message);
 	connect(this, &Channel_sim::ChannelLostRateChanging, udp, &Udpserver::setLossRate);
 	connect(this, &Channel_sim::ChannelStateChanging, udp, &Udpserver::channelStateChange);
+	connect(udp, &Udpserver::channelFailed, this, &Channel_sim::onChannelFailed);
 	if (LogEmitter::instance()) {
 		connect(LogEmitter::instance(), &LogEmitter::newLogMessage,
 			this, &Channel_sim::appendLogToUi);
@@ -31,6 +34,16 @@ Channel_sim::Channel_sim(QWidget *parent)
 		qWarning("LogEmitter ʵȡʧܣ޷־źš");
 	}
 
+	// ͳߣ̶֡ȡһοգٸ߽Ҳֻ 10 /ػ
+	metricsPlot = new MetricsPlotWidget(this);
+	QDockWidget* metricsDock = new QDockWidget(QStringLiteral("ͨͳ"), this);
+	metricsDock->setObjectName("metricsDock");
+	metricsDock->setWidget(metricsPlot);
+	addDockWidget(Qt::RightDockWidgetArea, metricsDock);
+	metricsTimer = new QTimer(this);
+	connect(metricsTimer, &QTimer::timeout, this, &Channel_sim::refreshMetrics);
+	metricsTimer->start(kMetricsFrameIntervalMs);
+
 	qDebug("Channel_sim 캯ִϡ"); // ־ҲӦʾUI
 }
 
@@ -117,6 +130,15 @@ void Channel_sim::getChannelState_3(int state)
 
 	}
 }
+// ͶжͨʧЧԶãͬѡٴηĽ󲻻ظǨƣ
+void Channel_sim::onChannelFailed(int channel)
+{
+	QCheckBox* boxes[] = { ui.Channel1_checkbox, ui.channel2_checkbox, ui.channel3_checkbox };
+	if (channel < 0 || channel >= 3) return;
+	boxes[channel]->setChecked(false);
+	stbar->showMessage(QString("Channel %1 failed, queued packets moved to other channels").arg(channel + 1), 5000);
+}
+
 void Channel_sim::getLostrate_1(int vaule)
 {
 	ui.lostrate_label1->setText(QString("Drop:%%1").arg((double)vaule/10));
@@ -136,6 +158,11 @@ void Channel_sim::start_message()
 {
 	stbar->showMessage("Start sending", 3000);
 }
+void Channel_sim::refreshMetrics()
+{
+	metricsPlot->appendSnapshot(udp->getMetricsSnapshot());
+}
+
 void Channel_sim::appendLogToUi(const QString& message)
 {
 
@@ -7,6 +7,8 @@
 #include <QStatusBar>
 #include "logemitter.h"
 #include <QTextEdit>
+#include <QTimer>
+#include "MetricsPlotWidget.h"
 class Channel_sim : public QMainWindow
 {
     Q_OBJECT
@@ -15,6 +17,8 @@ public:
     Channel_sim(QWidget *parent = nullptr);
     ~Channel_sim();
 
+    Udpserver* server() const { return udp; }
+
 signals:
     void ChannelStateChanging(int channel, bool state);
 	void ChannelLostRateChanging(int channel, double rate);
@@ -24,14 +28,19 @@ private:
 	Udpserver* udp;
     QString file_name;
 	QStatusBar* stbar;
+	MetricsPlotWidget* metricsPlot;
+	QTimer* metricsTimer;
+	static constexpr int kMetricsFrameIntervalMs = 100; // metrics plot refresh interval (10 Hz)
 private slots:
     void Readfile();
     void getChannelState_1(int state);
     void getChannelState_2(int state);
     void getChannelState_3(int state);
+    void onChannelFailed(int channel);
     void getLostrate_1(int vaule);
     void getLostrate_2(int vaule);
     void getLostrate_3(int vaule);
 	void start_message();
     void appendLogToUi(const QString& message);
+    void refreshMetrics();
 };
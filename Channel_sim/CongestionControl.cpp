@@ -0,0 +1,436 @@
+﻿#include "CongestionControl.h"
+#include <QMutexLocker>
+#include <algorithm>
+#include <cmath>
+
+// ---- 接收端 ----
+
+void FeedbackGenerator::onDatagram(size_t len, bool stamped, uint32_t send_us, int64_t arrival_ns) {
+    received_packets++;
+    received_bytes += static_cast<uint32_t>(len);
+    if (!stamped) return;
+    // 乱序到达的包只计数；倒退超过 1 秒视为发送端重启，重新开始分组
+    const int32_t send_delta = static_cast<int32_t>(send_us - last_send_us);
+    if (has_send_time && send_delta < 0 && send_delta > -1000000) return;
+    has_send_time = true;
+    last_send_us = send_us;
+    last_arrival_ns = arrival_ns;
+
+    const uint32_t arrival_us = static_cast<uint32_t>(arrival_ns / 1000);
+    if (group_open && static_cast<int32_t>(send_us - group_first_send_us) >= 0 &&
+        static_cast<int32_t>(send_us - group_first_send_us) <= kGroupLengthUs) {
+        current_group = { send_us, arrival_us };
+        return;
+    }
+    if (group_open) {
+        completed_groups.push_back(current_group);
+        if (completed_groups.size() > datagram::kMaxFeedbackGroups) completed_groups.pop_front();
+    }
+    group_open = true;
+    group_first_send_us = send_us;
+    current_group = { send_us, arrival_us };
+}
+
+bool FeedbackGenerator::build(int64_t now_ns, datagram::Feedback* feedback) {
+    if (now_ns < next_report_ns || received_packets == reported_packets) return false;
+    next_report_ns = now_ns + interval_ns;
+    reported_packets = received_packets;
+
+    feedback->channel = static_cast<uint8_t>(channel);
+    feedback->report_seq = ++report_seq;
+    feedback->report_us = static_cast<uint32_t>(now_ns / 1000);
+    feedback->received_packets = received_packets;
+    feedback->received_bytes = received_bytes;
+    feedback->last_send_us = last_send_us;
+    feedback->hold_us = has_send_time
+        ? static_cast<uint32_t>(std::max<int64_t>(0, now_ns - last_arrival_ns) / 1000) : datagram::kNoHoldTime;
+    feedback->group_count = static_cast<uint8_t>(completed_groups.size());
+    std::copy(completed_groups.begin(), completed_groups.end(), feedback->groups);
+    completed_groups.clear();
+    return true;
+}
+
+// ---- 时延梯度 ----
+
+void TrendlineEstimator::update(double recv_delta_ms, double send_delta_ms, int64_t arrival_ms) {
+    const double delta_ms = recv_delta_ms - send_delta_ms;
+    num_of_deltas = std::min(num_of_deltas + 1, kDeltaCounterMax);
+    if (first_arrival_ms == -1) first_arrival_ms = arrival_ms;
+
+    accumulated_delay += delta_ms;
+    smoothed_delay = kSmoothingCoef * smoothed_delay + (1 - kSmoothingCoef) * accumulated_delay;
+    delay_hist.emplace_back(static_cast<double>(arrival_ms - first_arrival_ms), smoothed_delay);
+    if (delay_hist.size() > kWindowSize) delay_hist.pop_front();
+
+    double trend = prev_trend;
+    if (delay_hist.size() == kWindowSize) {
+        // 最小二乘斜率
+        double sum_x = 0, sum_y = 0;
+        for (const auto& point : delay_hist) {
+            sum_x += point.first;
+            sum_y += point.second;
+        }
+        const double mean_x = sum_x / kWindowSize;
+        const double mean_y = sum_y / kWindowSize;
+        double numerator = 0, denominator = 0;
+        for (const auto& point : delay_hist) {
+            numerator += (point.first - mean_x) * (point.second - mean_y);
+            denominator += (point.first - mean_x) * (point.first - mean_x);
+        }
+        if (denominator != 0) trend = numerator / denominator;
+    }
+    detect(trend, send_delta_ms, arrival_ms);
+}
+
+void TrendlineEstimator::detect(double trend, double ts_delta_ms, int64_t now_ms) {
+    if (num_of_deltas < 2) {
+        hypothesis = BandwidthUsage::Normal;
+        return;
+    }
+    const double modified_trend = std::min(num_of_deltas, kMinNumDeltas) * trend * kThresholdGain;
+    if (modified_trend > threshold_ms) {
+        time_over_using = time_over_using < 0 ? ts_delta_ms / 2 : time_over_using + ts_delta_ms;
+        overuse_counter++;
+        if (time_over_using > kOverusingTimeMs && overuse_counter > 1 && trend >= prev_trend) {
+            time_over_using = 0;
+            overuse_counter = 0;
+            hypothesis = BandwidthUsage::Overusing;
+        }
+    }
+    else if (modified_trend < -threshold_ms) {
+        time_over_using = -1;
+        overuse_counter = 0;
+        hypothesis = BandwidthUsage::Underusing;
+    }
+    else {
+        time_over_using = -1;
+        overuse_counter = 0;
+        hypothesis = BandwidthUsage::Normal;
+    }
+    prev_trend = trend;
+    updateThreshold(modified_trend, now_ms);
+}
+
+// 门限跟随 |modified_trend| 自适应：并发的 TCP 流会抬高排队时延，固定门限会让本流饿死
+void TrendlineEstimator::updateThreshold(double modified_trend, int64_t now_ms) {
+    if (last_threshold_update_ms == -1) last_threshold_update_ms = now_ms;
+    if (std::fabs(modified_trend) > threshold_ms + kMaxAdaptOffsetMs) {
+        last_threshold_update_ms = now_ms; // 突变不参与门限调整
+        return;
+    }
+    const double k = std::fabs(modified_trend) < threshold_ms ? kDownGain : kUpGain;
+    const int64_t time_delta_ms = std::min<int64_t>(now_ms - last_threshold_update_ms, 100);
+    threshold_ms += k * (std::fabs(modified_trend) - threshold_ms) * static_cast<double>(time_delta_ms);
+    threshold_ms = std::max(6.0, std::min(threshold_ms, 600.0));
+    last_threshold_update_ms = now_ms;
+}
+
+// ---- 速率控制 ----
+
+double LinkCapacityEstimator::upperBoundKbps() const {
+    return estimate_kbps + 3 * std::sqrt(estimate_kbps * deviation_kbps);
+}
+
+double LinkCapacityEstimator::lowerBoundKbps() const {
+    return std::max(0.0, estimate_kbps - 3 * std::sqrt(estimate_kbps * deviation_kbps));
+}
+
+void LinkCapacityEstimator::update(double sample_kbps, double alpha) {
+    estimate_kbps = estimate_kbps < 0 ? sample_kbps : (1 - alpha) * estimate_kbps + alpha * sample_kbps;
+    const double norm = std::max(estimate_kbps, 1.0);
+    const double error = estimate_kbps - sample_kbps;
+    deviation_kbps = (1 - alpha) * deviation_kbps + alpha * error * error / norm;
+    deviation_kbps = std::max(0.4, std::min(deviation_kbps, 2.5));
+}
+
+AimdRateControl::AimdRateControl(const BweConfig& config)
+    : config(config), current_bps(static_cast<double>(config.start_bps)) {
+}
+
+void AimdRateControl::setRate(double bps) {
+    current_bps = std::max(static_cast<double>(config.min_bps), std::min(bps, static_cast<double>(config.max_bps)));
+}
+
+bool AimdRateControl::timeToReduceFurther(int64_t now_ms, double acked_bps, double rtt_ms) const {
+    const int64_t interval_ms = std::max<int64_t>(10, std::min<int64_t>(static_cast<int64_t>(rtt_ms), 200));
+    if (last_change_ms < 0 || now_ms - last_change_ms >= interval_ms) return true;
+    return acked_bps > 0 && current_bps / 2 > acked_bps;
+}
+
+double AimdRateControl::update(BandwidthUsage usage, double acked_bps, int64_t now_ms, double rtt_ms) {
+    if (usage == BandwidthUsage::Overusing && state == State::Hold && !timeToReduceFurther(now_ms, acked_bps, rtt_ms)) {
+        return current_bps;
+    }
+    switch (usage) {
+    case BandwidthUsage::Normal:
+        if (state == State::Hold) {
+            last_change_ms = now_ms;
+            state = State::Increase;
+        }
+        break;
+    case BandwidthUsage::Overusing:
+        state = State::Decrease;
+        break;
+    case BandwidthUsage::Underusing:
+        state = State::Hold;
+        break;
+    }
+
+    double new_bps = current_bps;
+    if (state == State::Increase) {
+        if (acked_bps > 0 && link_capacity.hasEstimate() && acked_bps / 1000 > link_capacity.upperBoundKbps()) {
+            link_capacity.reset(); // 确认吞吐已明显高于原来的容量估计，链路变了
+        }
+        const double elapsed_ms = last_change_ms >= 0 ? static_cast<double>(std::min<int64_t>(now_ms - last_change_ms, 1000)) : 1000.0;
+        if (link_capacity.hasEstimate()) {
+            const double response_ms = rtt_ms + 100;
+            new_bps += std::max(4000.0, kPacketBits * 1000 / response_ms) * elapsed_ms / 1000;
+        }
+        else {
+            new_bps += std::max(current_bps * (std::pow(1.08, elapsed_ms / 1000) - 1), 1000.0);
+        }
+        last_change_ms = now_ms;
+    }
+    else if (state == State::Decrease) {
+        if (acked_bps > 0 && link_capacity.hasEstimate() && acked_bps / 1000 < link_capacity.lowerBoundKbps()) {
+            link_capacity.reset(); // 确认吞吐远低于容量估计，链路变差了，按新的吞吐重新估计
+        }
+        double decreased = (acked_bps > 0 ? acked_bps : current_bps) * kBeta;
+        if (decreased > current_bps && link_capacity.hasEstimate()) {
+            decreased = kBeta * link_capacity.estimateKbps() * 1000;
+        }
+        if (decreased < current_bps) new_bps = decreased; // 过载时不升速
+        if (acked_bps > 0) link_capacity.onOveruseDetected(acked_bps / 1000);
+        state = State::Hold;
+        last_change_ms = now_ms;
+    }
+    // 不超过确认吞吐太多：需求不足时估计值不会无限增长
+    if (acked_bps > 0) {
+        const double limit = 1.5 * acked_bps + 10000;
+        if (new_bps > limit) new_bps = std::max(current_bps, limit);
+    }
+    setRate(new_bps);
+    return current_bps;
+}
+
+LossBasedControl::LossBasedControl(const BweConfig& config)
+    : config(config), current_bps(static_cast<double>(config.start_bps)) {
+}
+
+double LossBasedControl::update(double loss_fraction, double delay_based_bps, int64_t now_ms, double rtt_ms) {
+    if (last_update_ms < 0) last_update_ms = now_ms;
+    const double elapsed_s = static_cast<double>(std::min<int64_t>(now_ms - last_update_ms, 1000)) / 1000;
+    last_update_ms = now_ms;
+    if (loss_fraction <= kLowLoss) {
+        current_bps = current_bps * std::pow(1.08, elapsed_s) + 1000 * elapsed_s;
+    }
+    else if (loss_fraction > kHighLoss &&
+        (last_decrease_ms < 0 || now_ms - last_decrease_ms >= 300 + static_cast<int64_t>(rtt_ms))) {
+        current_bps *= 1 - 0.5 * loss_fraction;
+        last_decrease_ms = now_ms;
+    }
+    current_bps = std::min(current_bps, delay_based_bps);
+    current_bps = std::max(static_cast<double>(config.min_bps), std::min(current_bps, static_cast<double>(config.max_bps)));
+    return current_bps;
+}
+
+// ---- 发送端 ----
+
+void ChannelBandwidthEstimator::reset(const BweConfig& new_config) {
+    QMutexLocker lock(&mutex);
+    config = new_config;
+    config.min_bps = std::max<int64_t>(1, config.min_bps);
+    config.max_bps = std::max(config.min_bps, config.max_bps);
+    config.start_bps = std::max(config.min_bps, std::min(config.start_bps, config.max_bps));
+    history.clear();
+    sent_packets = 0;
+    last_sent_us = 0;
+    have_report = false;
+    last_report_seq = 0;
+    last_received_packets = 0;
+    last_loss_send_us = 0;
+    loss_sent = 0;
+    loss_received = 0;
+    loss_fraction = 0;
+    acked_report_us = 0;
+    acked_bytes_base = 0;
+    acked_bps = 0;
+    rtt_ms = 0;
+    last_feedback_us = 0;
+    last_timeout_us = 0;
+    have_group = false;
+    arrival_base_us = 0;
+    trendline.reset();
+    delay_based = AimdRateControl(config);
+    loss_based = LossBasedControl(config);
+    last_usage = BandwidthUsage::Normal;
+    target_bps.store(config.start_bps);
+    feedback_reports.store(0);
+    feedback_lost.store(0);
+    overuse_events.store(0);
+}
+
+void ChannelBandwidthEstimator::onPacketSent(int64_t now_us, size_t bytes) {
+    (void)bytes; // 吞吐以接收端确认的为准
+    QMutexLocker lock(&mutex);
+    sent_packets++;
+    history.push_back({ now_us, sent_packets });
+    while (!history.empty() && history.front().send_us < now_us - kHistoryUs) history.pop_front();
+    last_sent_us = now_us;
+}
+
+// 32 位微秒时间戳展开到离 reference_us 最近的一圈
+int64_t ChannelBandwidthEstimator::unwrapNear(uint32_t value_us, int64_t reference_us) const {
+    return reference_us - static_cast<int32_t>(static_cast<uint32_t>(reference_us) - value_us);
+}
+
+// 发送时刻不晚于 send_us 的累计发送数
+uint32_t ChannelBandwidthEstimator::sentUpTo(int64_t send_us) const {
+    auto later = std::upper_bound(history.begin(), history.end(), send_us,
+        [](int64_t time, const SentRecord& record) { return time < record.send_us; });
+    if (later == history.begin()) return history.empty() ? sent_packets : history.front().cumulative_packets - 1;
+    return std::prev(later)->cumulative_packets;
+}
+
+void ChannelBandwidthEstimator::processGroups(const datagram::Feedback& feedback) {
+    for (int i = 0; i < feedback.group_count; ++i) {
+        const datagram::FeedbackGroup& group = feedback.groups[i];
+        if (!have_group) {
+            have_group = true;
+            previous_group = group;
+            continue;
+        }
+        const int32_t send_delta_us = static_cast<int32_t>(group.send_us - previous_group.send_us);
+        const int32_t arrival_delta_us = static_cast<int32_t>(group.arrival_us - previous_group.arrival_us);
+        if (send_delta_us <= 0) {
+            if (send_delta_us < -1000000) previous_group = group; // 发送端重启
+            continue; // 乱序
+        }
+        previous_group = group;
+        arrival_base_us += arrival_delta_us;
+        if (std::abs(static_cast<int64_t>(arrival_delta_us) - send_delta_us) > 3000000) {
+            trendline.reset(); // 到达时刻跳变（接收端重启、时钟调整）
+            continue;
+        }
+        trendline.update(arrival_delta_us / 1000.0, send_delta_us / 1000.0, arrival_base_us / 1000);
+    }
+}
+
+void ChannelBandwidthEstimator::onFeedback(const datagram::Feedback& feedback, int64_t now_us) {
+    QMutexLocker lock(&mutex);
+    if (have_report) {
+        const int16_t gap = static_cast<int16_t>(feedback.report_seq - last_report_seq);
+        if (gap <= 0) return; // 重复或乱序的旧反馈
+        feedback_lost.fetch_add(static_cast<uint64_t>(gap - 1), std::memory_order_relaxed);
+    }
+    feedback_reports.fetch_add(1, std::memory_order_relaxed);
+    last_feedback_us = now_us;
+    const int64_t now_ms = now_us / 1000;
+
+    // 往返时间：现在 - 该包发送时刻 - 接收端持有时间
+    const bool has_send_time = feedback.hold_us != datagram::kNoHoldTime;
+    const int64_t covered_send_us = has_send_time ? unwrapNear(feedback.last_send_us, now_us) : last_loss_send_us;
+    if (has_send_time) {
+        const int64_t rtt_us = now_us - covered_send_us - static_cast<int64_t>(feedback.hold_us);
+        if (rtt_us >= 0 && rtt_us < 10000000) {
+            rtt_ms = rtt_ms > 0 ? rtt_ms + (rtt_us / 1000.0 - rtt_ms) / 8 : rtt_us / 1000.0;
+        }
+    }
+
+    bool loss_updated = false;
+    if (have_report) {
+        // 确认吞吐：至少 kAckedWindowUs 的区间，按接收端时钟计算；下降时直接取新值，过载时按它降速才不滞后
+        const uint32_t window_us = feedback.report_us - acked_report_us;
+        if (window_us >= kAckedWindowUs) {
+            const double sample = static_cast<double>(feedback.received_bytes - acked_bytes_base) * 8e6 / window_us;
+            acked_bps = acked_bps > 0 && sample > acked_bps ? acked_bps + (sample - acked_bps) / 2 : sample;
+            acked_report_us = feedback.report_us;
+            acked_bytes_base = feedback.received_bytes;
+        }
+        // 丢包率：两份反馈之间收到的包数 / 同一区间（按最新源包的发送时刻对齐）发出的包数
+        if (has_send_time && covered_send_us > last_loss_send_us) {
+            loss_sent += sentUpTo(covered_send_us) - sentUpTo(last_loss_send_us);
+            loss_received += feedback.received_packets - last_received_packets;
+            last_loss_send_us = covered_send_us;
+            last_received_packets = feedback.received_packets;
+            if (loss_sent >= kMinLossPackets) {
+                loss_fraction = std::max(0.0, std::min(1.0, 1.0 - static_cast<double>(loss_received) / loss_sent));
+                loss_sent = 0;
+                loss_received = 0;
+                loss_updated = true;
+            }
+        }
+    }
+    else {
+        acked_report_us = feedback.report_us;
+        acked_bytes_base = feedback.received_bytes;
+        last_received_packets = feedback.received_packets;
+        last_loss_send_us = covered_send_us;
+    }
+    have_report = true;
+    last_report_seq = feedback.report_seq;
+
+    processGroups(feedback);
+    const BandwidthUsage usage = trendline.state();
+    if (usage == BandwidthUsage::Overusing && last_usage != BandwidthUsage::Overusing) {
+        overuse_events.fetch_add(1, std::memory_order_relaxed);
+    }
+    last_usage = usage;
+    delay_based.update(usage, acked_bps, now_ms, rtt_ms);
+    if (loss_updated) {
+        loss_based.update(loss_fraction, delay_based.rate(), now_ms, rtt_ms);
+    }
+    else {
+        loss_based.setRate(std::min(loss_based.rate(), delay_based.rate()));
+    }
+    publish();
+}
+
+void ChannelBandwidthEstimator::onTimer(int64_t now_us) {
+    QMutexLocker lock(&mutex);
+    if (!have_report || last_sent_us <= last_feedback_us) return;
+    if (now_us - last_feedback_us < kFeedbackTimeoutMs * 1000 || now_us - last_timeout_us < kFeedbackTimeoutMs * 1000) return;
+    // 有数据在途却收不到反馈：链路可能已经断了或严重拥塞，逐步降速
+    last_timeout_us = now_us;
+    delay_based.setRate(delay_based.rate() * 0.8);
+    loss_based.setRate(std::min(loss_based.rate() * 0.8, delay_based.rate()));
+    publish();
+}
+
+int64_t ChannelBandwidthEstimator::silentSinceUs() const {
+    QMutexLocker lock(&mutex);
+    return have_report && last_sent_us > last_feedback_us ? last_feedback_us : -1;
+}
+
+void ChannelBandwidthEstimator::publish() {
+
+    const double target = std::min(delay_based.rate(), loss_based.rate());
+    target_bps.store(std::max(config.min_bps, std::min(static_cast<int64_t>(target), config.max_bps)), std::memory_order_relaxed);
+}
+
+BandwidthEstimateSnapshot ChannelBandwidthEstimator::snapshot() const {
+    QMutexLocker lock(&mutex);
+    BandwidthEstimateSnapshot snapshot;
+    snapshot.active = true;
+    snapshot.target_bps = static_cast<double>(target_bps.load(std::memory_order_relaxed));
+    snapshot.delay_based_bps = delay_based.rate();
+    snapshot.loss_based_bps = loss_based.rate();
+    snapshot.acked_bps = acked_bps;
+    snapshot.rtt_ms = rtt_ms;
+    snapshot.loss_fraction = loss_fraction;
+    snapshot.usage = static_cast<int>(last_usage);
+    snapshot.threshold_ms = trendline.threshold();
+    snapshot.feedback_reports = feedback_reports.load(std::memory_order_relaxed);
+    snapshot.feedback_lost = feedback_lost.load(std::memory_order_relaxed);
+    snapshot.overuse_events = overuse_events.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+// ---- 通道限速 ----
+
+int64_t ChannelPacer::reserve(int64_t now_ns, size_t bytes, int64_t rate_bps) {
+    if (rate_bps <= 0) return now_ns;
+    const int64_t start = std::max(next_send_ns, now_ns - kMaxBurstNs);
+    next_send_ns = start + static_cast<int64_t>(static_cast<double>(bytes) * 8e9 / static_cast<double>(rate_bps));
+    return start;
+}
@@ -0,0 +1,239 @@
+﻿#pragma once
+#include <QMutex>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "ChannelMetrics.h"
+#include "DatagramFormat.h"
+
+// 逐通道的时延拥塞控制，结构和参数取自 GoogCC（modules/congestion_controller/goog_cc）：
+// 接收端把到达组（InterArrivalDelta）和累计收包数反馈给发送端，发送端用趋势线估计时延梯度
+// （TrendlineEstimator）判断过载，按 AIMD 调整速率（AimdRateControl），再与按丢包调整的速率
+// （SendSideBandwidthEstimation）取小。vendored 的实现依赖 api/units、field trial 和事件日志，
+// 不在本工程的编译范围内，这里只保留算法本身。
+
+struct BweConfig {
+    int64_t min_bps = 500'000;
+    int64_t start_bps = 10'000'000;
+    int64_t max_bps = 1'000'000'000;
+};
+
+enum class BandwidthUsage : int {
+    Normal = 0,
+    Underusing = 1,
+    Overusing = 2,
+};
+
+// 接收端：一个通道的反馈生成。只在接收线程中调用
+class FeedbackGenerator {
+public:
+    static constexpr int64_t kGroupLengthUs = 5000; // 发送时刻相差不超过 5ms 的包归为一个到达组
+
+    explicit FeedbackGenerator(int channel = 0, int interval_ms = 50) : channel(channel), interval_ns(interval_ms * 1000000LL) {}
+
+    // has_send_time 为 false 时（冗余包、旧发送端）只计数
+    void onDatagram(size_t len, bool has_send_time, uint32_t send_us, int64_t arrival_ns);
+    // 到了发送时刻且有新数据时生成一份反馈，返回 false 表示这次不用发
+    bool build(int64_t now_ns, datagram::Feedback* feedback);
+
+private:
+    const int channel;
+    const int64_t interval_ns;
+    int64_t next_report_ns = 0;
+    uint16_t report_seq = 0;
+    uint32_t received_packets = 0;
+    uint32_t received_bytes = 0;
+    uint32_t reported_packets = 0; // 上一份反馈时的收包数，没有新包时不发
+    bool has_send_time = false;
+    uint32_t last_send_us = 0;
+    int64_t last_arrival_ns = 0;
+    bool group_open = false;
+    uint32_t group_first_send_us = 0;
+    datagram::FeedbackGroup current_group;
+    std::deque<datagram::FeedbackGroup> completed_groups; // 最多 kMaxFeedbackGroups 个，多了丢最老的
+};
+
+// 时延梯度：对平滑后的累计排队时延做最小二乘拟合，斜率乘以增益与自适应门限比较
+class TrendlineEstimator {
+public:
+    // recv_delta_ms / send_delta_ms 为相邻两个到达组的到达间隔和发送间隔
+    void update(double recv_delta_ms, double send_delta_ms, int64_t arrival_ms);
+    BandwidthUsage state() const { return hypothesis; }
+    double threshold() const { return threshold_ms; }
+    void reset() { *this = TrendlineEstimator(); }
+
+private:
+    static constexpr size_t kWindowSize = 20;
+    static constexpr double kSmoothingCoef = 0.9;
+    static constexpr double kThresholdGain = 4.0;
+    static constexpr int kMinNumDeltas = 60;
+    static constexpr int kDeltaCounterMax = 1000;
+    static constexpr double kUpGain = 0.0087;      // 门限上调速度
+    static constexpr double kDownGain = 0.039;     // 门限下调速度
+    static constexpr double kOverusingTimeMs = 10; // 持续超过门限这么久才判为过载
+    static constexpr double kMaxAdaptOffsetMs = 15;
+
+    void detect(double trend, double ts_delta_ms, int64_t now_ms);
+    void updateThreshold(double modified_trend, int64_t now_ms);
+
+    int num_of_deltas = 0;
+    int64_t first_arrival_ms = -1;
+    double accumulated_delay = 0;
+    double smoothed_delay = 0;
+    std::deque<std::pair<double, double>> delay_hist; // (到达时刻, 平滑时延)
+    double threshold_ms = 12.5;
+    int64_t last_threshold_update_ms = -1;
+    double prev_trend = 0;
+    double time_over_using = -1;
+    int overuse_counter = 0;
+    BandwidthUsage hypothesis = BandwidthUsage::Normal;
+};
+
+// 链路容量估计：过载时确认吞吐的指数平滑及其方差，速率接近容量时改为加性增长
+class LinkCapacityEstimator {
+public:
+    bool hasEstimate() const { return estimate_kbps > 0; }
+    double upperBoundKbps() const;
+    double lowerBoundKbps() const;
+    double estimateKbps() const { return estimate_kbps; }
+    void onOveruseDetected(double acked_kbps) { update(acked_kbps, 0.05); }
+    void reset() { estimate_kbps = -1; }
+
+private:
+    void update(double sample_kbps, double alpha);
+
+    double estimate_kbps = -1;
+    double deviation_kbps = 0.4;
+};
+
+// 基于时延的速率控制（AIMD）：正常时按每秒 8% 乘性增长（接近链路容量时改为每个响应时间约一个包的加性增长），
+// 过载时降到确认吞吐的 0.85 倍，欠载时保持，让队列排空
+class AimdRateControl {
+public:
+    explicit AimdRateControl(const BweConfig& config = BweConfig());
+
+    // acked_bps 为 0 表示还没有确认吞吐
+    double update(BandwidthUsage usage, double acked_bps, int64_t now_ms, double rtt_ms);
+    double rate() const { return current_bps; }
+    void setRate(double bps);
+
+private:
+    enum class State { Hold, Increase, Decrease };
+    // 持续过载时至少间隔一个 RTT（10~200ms）再降，确认吞吐不到当前速率一半时立即再降
+    bool timeToReduceFurther(int64_t now_ms, double acked_bps, double rtt_ms) const;
+
+    static constexpr double kBeta = 0.85;
+    static constexpr double kPacketBits = 8 * 1100; // 数据报约 1040 字节
+
+    BweConfig config;
+    State state = State::Hold;
+    double current_bps;
+    int64_t last_change_ms = -1;
+    LinkCapacityEstimator link_capacity;
+};
+
+// 基于丢包的速率：丢包率低于 2% 时每秒增长 8%，高于 10% 时按 (1 - 0.5 × 丢包率) 下调，
+// 每个 (300ms + RTT) 最多下调一次；结果不超过基于时延的速率
+class LossBasedControl {
+public:
+    explicit LossBasedControl(const BweConfig& config = BweConfig());
+
+    double update(double loss_fraction, double delay_based_bps, int64_t now_ms, double rtt_ms);
+    double rate() const { return current_bps; }
+    void setRate(double bps) { current_bps = bps; }
+
+private:
+    static constexpr double kLowLoss = 0.02;
+    static constexpr double kHighLoss = 0.10;
+
+    BweConfig config;
+    double current_bps;
+    int64_t last_update_ms = -1;
+    int64_t last_decrease_ms = -1;
+};
+
+// 发送端：一个通道的带宽估计。发送线程调用 onPacketSent，反馈线程调用 onFeedback / onTimer，
+// targetBps 可以在任意线程读取（通道限速器和多路调度）
+class ChannelBandwidthEstimator {
+public:
+    static constexpr int64_t kFeedbackTimeoutMs = 1000; // 有数据在途却这么久没有反馈时按 0.8 倍下调
+    static constexpr int64_t kHistoryUs = 2000000;      // 发送记录保留 2 秒
+    static constexpr uint32_t kMinLossPackets = 20;     // 丢包率至少按这么多包统计
+    static constexpr uint32_t kAckedWindowUs = 150000;  // 确认吞吐的最短统计区间
+
+    explicit ChannelBandwidthEstimator(const BweConfig& config = BweConfig()) { reset(config); }
+
+    // 只能在发送线程和反馈线程都停止时调用
+    void reset(const BweConfig& config);
+    // 包进入链路（含模拟丢弃的包），now_us 与试飞院头中的发送时刻同一时钟
+    void onPacketSent(int64_t now_us, size_t bytes);
+    void onFeedback(const datagram::Feedback& feedback, int64_t now_us);
+    void onTimer(int64_t now_us);
+
+    int64_t targetBps() const { return target_bps.load(std::memory_order_relaxed); }
+    bool hasFeedback() const { return feedback_reports.load(std::memory_order_relaxed) > 0; }
+    // 收到过反馈、之后又发过包时返回最后一次反馈的时刻，否则返回 -1（没有在等的反馈）
+    int64_t silentSinceUs() const;
+
+    BandwidthEstimateSnapshot snapshot() const;
+
+private:
+    struct SentRecord {
+        int64_t send_us;
+        uint32_t cumulative_packets;
+    };
+
+    int64_t unwrapNear(uint32_t value_us, int64_t reference_us) const;
+    uint32_t sentUpTo(int64_t send_us) const;
+    void processGroups(const datagram::Feedback& feedback);
+    void publish();
+
+    mutable QMutex mutex;
+    BweConfig config;
+    std::deque<SentRecord> history;
+    uint32_t sent_packets = 0;
+    int64_t last_sent_us = 0;
+
+    bool have_report = false;
+    uint16_t last_report_seq = 0;
+    uint32_t last_received_packets = 0;
+    int64_t last_loss_send_us = 0;   // 上一份反馈覆盖到的发送时刻
+    uint32_t loss_sent = 0;          // 当前丢包统计区间内的发送数和接收数
+    uint32_t loss_received = 0;
+    double loss_fraction = 0;
+    uint32_t acked_report_us = 0;    // 当前吞吐统计区间的起点
+    uint32_t acked_bytes_base = 0;
+    double acked_bps = 0;
+    double rtt_ms = 0;
+    int64_t last_feedback_us = 0;
+    int64_t last_timeout_us = 0;
+
+    bool have_group = false;
+    datagram::FeedbackGroup previous_group;
+    int64_t arrival_base_us = 0;     // 到达时刻展开用
+    TrendlineEstimator trendline;
+    AimdRateControl delay_based;
+    LossBasedControl loss_based;
+    BandwidthUsage last_usage = BandwidthUsage::Normal;
+
+    std::atomic<int64_t> target_bps{ 0 };
+    std::atomic<uint64_t> feedback_reports{ 0 };
+    std::atomic<uint64_t> feedback_lost{ 0 };
+    std::atomic<uint64_t> overuse_events{ 0 };
+};
+
+// 通道限速：漏桶，空闲时最多攒 kMaxBurstNs 的发送额度。只在该通道的发送线程中调用
+class ChannelPacer {
+public:
+    static constexpr int64_t kMaxBurstNs = 5000000;
+
+    // 返回这个包最早可以发送的时刻（单调时钟纳秒），不晚于 now_ns 时立即发送
+    int64_t reserve(int64_t now_ns, size_t bytes, int64_t rate_bps);
+    void reset() { next_send_ns = 0; }
+
+private:
+    int64_t next_send_ns = 0;
+};
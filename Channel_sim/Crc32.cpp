@@ -0,0 +1,129 @@
+﻿#include "Crc32.h"
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CRC32C_X86 1
+#include <nmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define CRC32C_TARGET_SSE42
+#else
+#define CRC32C_TARGET_SSE42 __attribute__((target("sse4.2")))
+#endif
+#endif
+
+namespace {
+
+constexpr uint32_t kPolynomial = 0x82F63B78; // 0x1EDC6F41 的反射形式
+
+struct SliceTables {
+    uint32_t table[8][256];
+
+    SliceTables() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ ((crc & 1) ? kPolynomial : 0);
+            }
+            table[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int slice = 1; slice < 8; ++slice) {
+                table[slice][i] = (table[slice - 1][i] >> 8) ^ table[0][table[slice - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+const SliceTables& sliceTables() {
+    static const SliceTables tables;
+    return tables;
+}
+
+bool detectHardware() {
+#if defined(CRC32C_X86)
+#if defined(_MSC_VER)
+    int info[4] = {};
+    __cpuid(info, 1);
+    return (info[2] & (1 << 20)) != 0; // ECX.SSE4_2
+#else
+    return __builtin_cpu_supports("sse4.2");
+#endif
+#else
+    return false;
+#endif
+}
+
+} // namespace
+
+namespace crc {
+
+uint32_t crc32cSoftware(const void* data, size_t len, uint32_t crc) {
+    const SliceTables& t = sliceTables();
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    // 每次处理8字节：两个32位字分别查4张表（按小端序读取）
+    while (len >= 8) {
+        uint32_t low;
+        uint32_t high;
+        memcpy(&low, p, sizeof(low));
+        memcpy(&high, p + 4, sizeof(high));
+        low ^= crc;
+        crc = t.table[7][low & 0xFF] ^ t.table[6][(low >> 8) & 0xFF] ^
+            t.table[5][(low >> 16) & 0xFF] ^ t.table[4][low >> 24] ^
+            t.table[3][high & 0xFF] ^ t.table[2][(high >> 8) & 0xFF] ^
+            t.table[1][(high >> 16) & 0xFF] ^ t.table[0][high >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while (len-- > 0) {
+        crc = (crc >> 8) ^ t.table[0][(crc ^ *p++) & 0xFF];
+    }
+    return ~crc;
+}
+
+#if defined(CRC32C_X86)
+CRC32C_TARGET_SSE42
+uint32_t crc32cHardware(const void* data, size_t len, uint32_t crc) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+#if defined(_M_X64) || defined(__x86_64__)
+    uint64_t crc64 = ~crc;
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        p += 8;
+        len -= 8;
+    }
+    uint32_t crc32 = static_cast<uint32_t>(crc64);
+#else
+    uint32_t crc32 = ~crc;
+#endif
+    while (len >= 4) {
+        uint32_t word;
+        memcpy(&word, p, sizeof(word));
+        crc32 = _mm_crc32_u32(crc32, word);
+        p += 4;
+        len -= 4;
+    }
+    while (len-- > 0) {
+        crc32 = _mm_crc32_u8(crc32, *p++);
+    }
+    return ~crc32;
+}
+#else
+uint32_t crc32cHardware(const void* data, size_t len, uint32_t crc) {
+    return crc32cSoftware(data, len, crc);
+}
+#endif
+
+bool hasHardwareCrc32c() {
+    static const bool supported = detectHardware();
+    return supported;
+}
+
+uint32_t crc32c(const void* data, size_t len, uint32_t crc) {
+    return hasHardwareCrc32c() ? crc32cHardware(data, len, crc) : crc32cSoftware(data, len, crc);
+}
+
+} // namespace crc
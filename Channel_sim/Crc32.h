@@ -0,0 +1,20 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32C（Castagnoli，多项式 0x1EDC6F41）：x86 上用 SSE4.2 的 crc32 指令，
+// 其他情况退回查表的 slicing-by-8。两种实现结果完全一致，可以混用。
+namespace crc {
+
+// 自动选择最快的实现；crc 为之前数据的结果，用于分段计算
+uint32_t crc32c(const void* data, size_t len, uint32_t crc = 0);
+
+// 纯软件实现（slicing-by-8）
+uint32_t crc32cSoftware(const void* data, size_t len, uint32_t crc = 0);
+
+// 硬件实现，只能在 hasHardwareCrc32c() 为 true 时调用
+uint32_t crc32cHardware(const void* data, size_t len, uint32_t crc = 0);
+
+bool hasHardwareCrc32c();
+
+} // namespace crc
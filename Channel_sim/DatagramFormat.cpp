@@ -0,0 +1,118 @@
+﻿#include "DatagramFormat.h"
+#include <cstring>
+
+#include "udp_with_ulpfec.h"
+
+namespace datagram {
+
+size_t trailerSize(int protocol_version) {
+    return protocol_version >= ForwardErrorCorrection::Packet::kProtocolV2 ? kTrailerSizeV2 : kTrailerSizeV1;
+}
+
+size_t writeTrailer(char* out, const Trailer& trailer, int protocol_version) {
+    char* p = out;
+    memcpy(p, &trailer.crc32, sizeof(trailer.crc32));
+    p += sizeof(trailer.crc32);
+    *p++ = static_cast<char>(trailer.stream_type);
+    *p++ = static_cast<char>(trailer.channel_index);
+    if (protocol_version >= ForwardErrorCorrection::Packet::kProtocolV2) {
+        memcpy(p, &trailer.seq, sizeof(trailer.seq));
+        p += sizeof(trailer.seq);
+    }
+    else {
+        *p++ = static_cast<char>(trailer.seq & 0xFF);
+    }
+    return static_cast<size_t>(p - out);
+}
+
+bool readTrailer(const char* in, size_t len, int protocol_version, Trailer* trailer) {
+    if (len < trailerSize(protocol_version)) return false;
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(in);
+    memcpy(&trailer->crc32, p, sizeof(trailer->crc32));
+    p += sizeof(trailer->crc32);
+    trailer->stream_type = *p++;
+    trailer->channel_index = *p++;
+    if (protocol_version >= ForwardErrorCorrection::Packet::kProtocolV2) {
+        memcpy(&trailer->seq, p, sizeof(trailer->seq));
+    }
+    else {
+        trailer->seq = *p;
+    }
+    return true;
+}
+
+size_t feedbackSize(const Feedback& feedback) {
+    return kFeedbackHeaderSize + static_cast<size_t>(feedback.group_count) * 8;
+}
+
+size_t writeFeedback(char* out, size_t capacity, const Feedback& feedback) {
+    if (feedback.group_count > kMaxFeedbackGroups || capacity < feedbackSize(feedback)) return 0;
+    char* p = out;
+    auto put = [&p](const void* value, size_t size) {
+        memcpy(p, value, size);
+        p += size;
+    };
+    put(&kFeedbackMagic, sizeof(kFeedbackMagic));
+    *p++ = static_cast<char>(kFeedbackVersion);
+    *p++ = static_cast<char>(feedback.channel);
+    put(&feedback.report_seq, sizeof(feedback.report_seq));
+    put(&feedback.report_us, sizeof(feedback.report_us));
+    put(&feedback.received_packets, sizeof(feedback.received_packets));
+    put(&feedback.received_bytes, sizeof(feedback.received_bytes));
+    put(&feedback.last_send_us, sizeof(feedback.last_send_us));
+    put(&feedback.hold_us, sizeof(feedback.hold_us));
+    *p++ = static_cast<char>(feedback.group_count);
+    for (int i = 0; i < feedback.group_count; ++i) {
+        put(&feedback.groups[i].send_us, sizeof(feedback.groups[i].send_us));
+        put(&feedback.groups[i].arrival_us, sizeof(feedback.groups[i].arrival_us));
+    }
+    return static_cast<size_t>(p - out);
+}
+
+bool readFeedback(const char* in, size_t len, Feedback* feedback) {
+    if (len < kFeedbackHeaderSize) return false;
+    const char* p = in;
+    auto get = [&p](void* value, size_t size) {
+        memcpy(value, p, size);
+        p += size;
+    };
+    uint16_t magic;
+    get(&magic, sizeof(magic));
+    if (magic != kFeedbackMagic || static_cast<uint8_t>(*p++) != kFeedbackVersion) return false;
+    feedback->channel = static_cast<uint8_t>(*p++);
+    get(&feedback->report_seq, sizeof(feedback->report_seq));
+    get(&feedback->report_us, sizeof(feedback->report_us));
+    get(&feedback->received_packets, sizeof(feedback->received_packets));
+    get(&feedback->received_bytes, sizeof(feedback->received_bytes));
+    get(&feedback->last_send_us, sizeof(feedback->last_send_us));
+    get(&feedback->hold_us, sizeof(feedback->hold_us));
+    feedback->group_count = static_cast<uint8_t>(*p++);
+    if (feedback->group_count > kMaxFeedbackGroups || len < feedbackSize(*feedback)) return false;
+    for (int i = 0; i < feedback->group_count; ++i) {
+        get(&feedback->groups[i].send_us, sizeof(feedback->groups[i].send_us));
+        get(&feedback->groups[i].arrival_us, sizeof(feedback->groups[i].arrival_us));
+    }
+    return true;
+}
+
+size_t writeNack(char* out, size_t capacity, const uint32_t* seqs, size_t count) {
+    if (count == 0 || count > kMaxNackSeqs || capacity < kNackHeaderSize + count * 4) return 0;
+    memcpy(out, &kNackMagic, sizeof(kNackMagic));
+    out[2] = static_cast<char>(kNackVersion);
+    out[3] = static_cast<char>(count);
+    memcpy(out + kNackHeaderSize, seqs, count * 4);
+    return kNackHeaderSize + count * 4;
+}
+
+bool readNack(const char* in, size_t len, Nack* nack) {
+    if (len < kNackHeaderSize) return false;
+    uint16_t magic;
+    memcpy(&magic, in, sizeof(magic));
+    if (magic != kNackMagic || static_cast<uint8_t>(in[2]) != kNackVersion) return false;
+    nack->count = static_cast<uint8_t>(in[3]);
+    if (nack->count == 0 || len < kNackHeaderSize + nack->count * 4u) return false;
+    memcpy(nack->seqs, in + kNackHeaderSize, nack->count * 4u);
+    return true;
+}
+
+} // namespace datagram
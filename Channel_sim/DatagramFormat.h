@@ -0,0 +1,81 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// 数据报格式：FEC头 | 负载 | 尾部（crc32 | stream_type | channel_index | seq）
+// v1：seq 8位；v2：seq 32位。两者的数据报长度都是 FEC头 + 负载 + 尾部，接收端从末尾定位尾部。
+namespace datagram {
+
+constexpr size_t kTrailerSizeV1 = 7;
+constexpr size_t kTrailerSizeV2 = 10;
+
+struct Trailer {
+    uint32_t crc32 = 0; // CRC-32C，覆盖 FEC头 + 负载
+    uint8_t stream_type = 0;
+    uint8_t channel_index = 0;
+    uint32_t seq = 0; // v1 线上只有低8位
+};
+
+size_t trailerSize(int protocol_version);
+
+// 写入尾部，返回写入的字节数
+size_t writeTrailer(char* out, const Trailer& trailer, int protocol_version);
+
+// 从 in 解析尾部，长度不足时返回 false
+bool readTrailer(const char* in, size_t len, int protocol_version, Trailer* trailer);
+
+// 带宽反馈（接收端 → 发送端）：每个通道单独发送，从该通道的接收端口发往该通道数据报的源地址，
+// 发送端在同一个套接字上收取。计数为累计值（32位回绕），反馈丢失不影响差值。
+// 格式：magic(2) | version | channel | report_seq(2) | report_us | received_packets | received_bytes |
+//       last_send_us | hold_us | group_count | group_count × (send_us | arrival_us)，多字节字段为小端
+constexpr uint16_t kFeedbackMagic = 0xFBCC;
+constexpr uint8_t kFeedbackVersion = 1;
+constexpr size_t kFeedbackHeaderSize = 27;
+constexpr size_t kMaxFeedbackGroups = 64;
+constexpr uint32_t kNoHoldTime = 0xFFFFFFFF;
+
+// 一个到达组：发送时刻相差不超过 5ms 的连续源包，取组内最后一个包的发送时刻（发送端时钟）和到达时刻（接收端时钟）
+struct FeedbackGroup {
+    uint32_t send_us = 0;
+    uint32_t arrival_us = 0;
+};
+
+struct Feedback {
+    uint8_t channel = 0;
+    uint16_t report_seq = 0;
+    uint32_t report_us = 0;        // 生成反馈的时刻，接收端时钟
+    uint32_t received_packets = 0; // 该通道收到的数据报数
+    uint32_t received_bytes = 0;
+    uint32_t last_send_us = 0;     // 最近收到的源包的发送时刻（发送端时钟）
+    uint32_t hold_us = kNoHoldTime; // 该包到达到生成反馈的间隔，发送端据此计算往返时间
+    uint8_t group_count = 0;
+    FeedbackGroup groups[kMaxFeedbackGroups];
+};
+
+size_t feedbackSize(const Feedback& feedback);
+
+// 写入反馈，capacity 不足时返回 0
+size_t writeFeedback(char* out, size_t capacity, const Feedback& feedback);
+
+// 解析反馈，magic、版本或长度不对时返回 false
+bool readFeedback(const char* in, size_t len, Feedback* feedback);
+
+// 重传请求（接收端 → 发送端）：按 v2 尾部的32位全局序列号列出需要重传的数据报，
+// 经任一通道发回发送端。格式：magic(2) | version | count | count × seq，多字节字段为小端
+constexpr uint16_t kNackMagic = 0xFBCD;
+constexpr uint8_t kNackVersion = 1;
+constexpr size_t kNackHeaderSize = 4;
+constexpr size_t kMaxNackSeqs = 255;
+
+struct Nack {
+    uint8_t count = 0;
+    uint32_t seqs[kMaxNackSeqs];
+};
+
+// 写入重传请求（最多 kMaxNackSeqs 个序列号），capacity 不足时返回 0
+size_t writeNack(char* out, size_t capacity, const uint32_t* seqs, size_t count);
+
+// 解析重传请求，magic、版本或长度不对时返回 false
+bool readNack(const char* in, size_t len, Nack* nack);
+
+} // namespace datagram
@@ -0,0 +1,653 @@
+﻿#include "FecBenchmark.h"
+#include <QDateTime>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSysInfo>
+#include <QThread>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "udp_with_ulpfec.h"
+#include "modules/rtp_rtcp/source/fec_private_tables_bursty.h"
+#include "modules/rtp_rtcp/source/fec_private_tables_random.h"
+#include "Crc32.h"
+#include "FecReceiver.h"
+#include "Udpserver.h"
+
+namespace {
+
+// 按掩码做逐包剥离解码：某个收到的冗余包只差一个源包时即可恢复该源包，反复进行直到没有进展。
+// lost 为源包丢失标记，调用后被恢复的包会清零；返回仍然丢失的源包数。
+int peelDecode(const uint8_t* packet_mask, int num_mask_bytes, int k, int r,
+    bool* lost, const bool* fec_lost) {
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        for (int row = 0; row < r; ++row) {
+            if (fec_lost[row]) continue;
+            const uint8_t* mask_row = &packet_mask[row * num_mask_bytes];
+            int missing = -1;
+            int missing_count = 0;
+            for (int col = 0; col < k && missing_count < 2; ++col) {
+                if ((mask_row[col / 8] & (1 << (7 - (col % 8)))) && lost[col]) {
+                    missing = col;
+                    missing_count++;
+                }
+            }
+            if (missing_count == 1) {
+                lost[missing] = false;
+                progress = true;
+            }
+        }
+    }
+    int remaining = 0;
+    for (int col = 0; col < k; ++col) {
+        remaining += lost[col] ? 1 : 0;
+    }
+    return remaining;
+}
+
+// 计时：先把迭代次数加倍直到单次运行超过 20ms，再按约 50ms 一轮重复 5 轮，
+// 报告每次操作的最小和中位耗时。body(iterations) 执行 iterations 次被测操作
+struct Timing {
+    double min_ns = 0;
+    double median_ns = 0;
+    long long iterations = 0; // 每轮的迭代次数
+};
+
+template <typename Body>
+Timing measure(Body&& body) {
+    using Clock = std::chrono::steady_clock;
+    auto run = [&](long long iterations) {
+        const auto start = Clock::now();
+        body(iterations);
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    };
+    long long iterations = 1;
+    double elapsed = run(iterations);
+    while (elapsed < 20e6 && iterations < (1LL << 40)) {
+        iterations *= 2;
+        elapsed = run(iterations);
+    }
+    iterations = std::max(1LL, static_cast<long long>(iterations * (50e6 / elapsed)));
+    std::vector<double> per_op;
+    for (int repetition = 0; repetition < 5; ++repetition) {
+        per_op.push_back(run(iterations) / iterations);
+    }
+    std::sort(per_op.begin(), per_op.end());
+    return { per_op.front(), per_op[per_op.size() / 2], iterations };
+}
+
+void addTiming(QJsonObject& result, const Timing& timing) {
+    result["ns_per_op"] = timing.min_ns;
+    result["ns_per_op_median"] = timing.median_ns;
+    result["iterations"] = static_cast<qint64>(timing.iterations);
+}
+
+// 可变的全局结果，防止被测代码被编译器整体优化掉
+volatile uint32_t benchmark_sink = 0;
+
+ForwardErrorCorrection::PacketList makeMediaPackets(int k, size_t payload_size, std::mt19937& generator) {
+    ForwardErrorCorrection::PacketList packets;
+    for (int i = 0; i < k; ++i) {
+        auto packet = std::make_unique<ForwardErrorCorrection::Packet>();
+        packet->group_number = 0;
+        packet->sequence_number = static_cast<uint8_t>(i);
+        packet->k = static_cast<uint8_t>(k);
+        packet->r = 0;
+        packet->is_important = false;
+        packet->length = payload_size;
+        for (size_t j = 0; j < payload_size; ++j) packet->data[j] = static_cast<uint8_t>(generator());
+        packets.push_back(std::move(packet));
+    }
+    return packets;
+}
+
+bool writeResult(const QString& name, const QJsonArray& results, const QString& out_path) {
+    // 运行环境，便于对比不同版本、不同机器的结果
+    QJsonObject context;
+    context["date"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    context["cpu"] = QSysInfo::currentCpuArchitecture();
+    context["os"] = QSysInfo::prettyProductName();
+    context["hardware_threads"] = QThread::idealThreadCount();
+    context["hardware_crc32c"] = crc::hasHardwareCrc32c();
+#if defined(NDEBUG)
+    context["build"] = "release";
+#else
+    context["build"] = "debug";
+#endif
+
+    QJsonObject root;
+    root["benchmark"] = name;
+    root["context"] = context;
+    root["results"] = results;
+    const QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Indented);
+    if (out_path.isEmpty()) {
+        fwrite(json.constData(), 1, static_cast<size_t>(json.size()), stdout);
+        fflush(stdout);
+        return true;
+    }
+    QFile file(out_path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        fprintf(stderr, "Failed to open %s\n", qPrintable(out_path));
+        return false;
+    }
+    file.write(json);
+    return true;
+}
+
+} // namespace
+
+namespace FecBenchmark {
+
+QJsonArray runUepRecovery(int trials) {
+    struct Config { int k; int r; int num_important; };
+    const Config configs[] = { { 10, 2, 2 }, { 10, 4, 2 }, { 16, 4, 3 } };
+    const double loss_rates[] = { 0.02, 0.05, 0.10, 0.20 };
+
+    std::mt19937 generator(12345); // 固定种子，保证结果可重复
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    QJsonArray results;
+
+    for (const Config& config : configs) {
+        // 重要包分散在组内，模拟 TS 关键帧出现在任意位置
+        bool important[kUlpfecMaxMediaPackets] = {};
+        for (int i = 0; i < config.num_important; ++i) {
+            important[(i * config.k) / config.num_important + 1] = true;
+        }
+        const int num_mask_bytes = static_cast<int>(PacketMaskSize(config.k));
+
+        for (bool uep : { false, true }) {
+            uint8_t packet_mask[kUlpfecMaxMediaPackets * kUlpfecMaxPacketMaskSize];
+            GenerateGroupPacketMasks(config.k, config.r, important, uep, kFecMaskRandom, packet_mask);
+
+            for (double loss_rate : loss_rates) {
+                long long important_total = 0, important_lost = 0;
+                long long ordinary_total = 0, ordinary_lost = 0;
+                for (int trial = 0; trial < trials; ++trial) {
+                    bool lost[kUlpfecMaxMediaPackets];
+                    bool fec_lost[kUlpfecMaxMediaPackets];
+                    for (int i = 0; i < config.k; ++i) lost[i] = distribution(generator) < loss_rate;
+                    for (int i = 0; i < config.r; ++i) fec_lost[i] = distribution(generator) < loss_rate;
+                    peelDecode(packet_mask, num_mask_bytes, config.k, config.r, lost, fec_lost);
+                    for (int i = 0; i < config.k; ++i) {
+                        if (important[i]) {
+                            important_total++;
+                            important_lost += lost[i] ? 1 : 0;
+                        }
+                        else {
+                            ordinary_total++;
+                            ordinary_lost += lost[i] ? 1 : 0;
+                        }
+                    }
+                }
+
+                QJsonObject result;
+                result["k"] = config.k;
+                result["r"] = config.r;
+                result["num_important"] = config.num_important;
+                result["unequal_protection"] = uep;
+                result["loss_rate"] = loss_rate;
+                result["trials"] = trials;
+                result["important_residual_loss"] = static_cast<double>(important_lost) / important_total;
+                result["ordinary_residual_loss"] = static_cast<double>(ordinary_lost) / ordinary_total;
+                results.append(result);
+            }
+        }
+    }
+    return results;
+}
+
+QJsonArray runGroupSize(int groups, int trials) {
+    // k<=16 为原来的上限（2字节掩码），之后是48位掩码的大组；冗余度固定约20%
+    const int group_sizes[] = { 4, 8, 10, 16, 24, 32, 48 };
+    const double loss_rates[] = { 0.02, 0.05, 0.10 };
+    const int kPayloadSize = 1024;
+
+    std::mt19937 generator(12345);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    std::vector<char> payload(kPayloadSize);
+    for (char& byte : payload) byte = static_cast<char>(generator());
+    QJsonArray results;
+
+    for (int k : group_sizes) {
+        const int r = std::max(1, (k + 2) / 5);
+        // v1 线上格式的头：kMaxHeaderSize 还含 v2 的版本扩展，不能用在这里
+        const size_t header_size = PacketMaskSize(k) == kUlpfecPacketMaskSizeLBitSet
+            ? ForwardErrorCorrection::Packet::kBaseHeaderSize + ForwardErrorCorrection::Packet::kMaskExtensionSize
+            : ForwardErrorCorrection::Packet::kBaseHeaderSize;
+
+        // 编码吞吐：PacketByFEC 全流程（建包、掩码、异或、拷贝到 buffer_packets）
+        ForwardErrorCorrection fec;
+        auto start = std::chrono::steady_clock::now();
+        for (int group = 0; group < groups; ++group) {
+            for (int i = 0; i < k; ++i) {
+                fec.PacketByFEC(payload.data(), kPayloadSize, k, r);
+            }
+            fec.buffer_packets.clear();
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const double media_bytes = static_cast<double>(groups) * k * kPayloadSize;
+
+        QJsonObject result;
+        result["k"] = k;
+        result["r"] = r;
+        result["header_bytes"] = static_cast<int>(header_size);
+        result["encode_mbytes_per_s"] = seconds > 0 ? media_bytes / seconds / 1e6 : 0.0;
+        result["encode_us_per_group"] = seconds * 1e6 / groups;
+        // 线上开销 = (k+r) 个头 + r 个冗余负载，相对 k 个源负载
+        result["overhead"] = (static_cast<double>(k + r) * header_size + static_cast<double>(r) * kPayloadSize) /
+            (static_cast<double>(k) * kPayloadSize);
+        result["header_overhead"] = static_cast<double>(header_size) / kPayloadSize;
+
+        // 同等冗余度下的残余丢包：大组能把冗余分摊到更多包上
+        uint8_t packet_mask[kUlpfecMaxMediaPackets * kUlpfecMaxPacketMaskSize];
+        const bool important[kUlpfecMaxMediaPackets] = {};
+        GenerateGroupPacketMasks(k, r, important, false, kFecMaskRandom, packet_mask);
+        const int num_mask_bytes = static_cast<int>(PacketMaskSize(k));
+        QJsonObject residual;
+        for (double loss_rate : loss_rates) {
+            long long lost_total = 0;
+            for (int trial = 0; trial < trials; ++trial) {
+                bool lost[kUlpfecMaxMediaPackets];
+                bool fec_lost[kUlpfecMaxMediaPackets];
+                for (int i = 0; i < k; ++i) lost[i] = distribution(generator) < loss_rate;
+                for (int i = 0; i < r; ++i) fec_lost[i] = distribution(generator) < loss_rate;
+                lost_total += peelDecode(packet_mask, num_mask_bytes, k, r, lost, fec_lost);
+            }
+            residual[QString::number(loss_rate)] = static_cast<double>(lost_total) / (static_cast<double>(trials) * k);
+        }
+        result["residual_loss"] = residual;
+        results.append(result);
+    }
+    return results;
+}
+
+QJsonArray runCrc(int iterations) {
+    const size_t packet_sizes[] = { 1037, 2000 };
+    std::mt19937 generator(12345);
+    QJsonArray results;
+
+    struct Implementation {
+        const char* name;
+        uint32_t (*function)(const void*, size_t, uint32_t);
+        bool available;
+    };
+    const Implementation implementations[] = {
+        { "sse42", crc::crc32cHardware, crc::hasHardwareCrc32c() },
+        { "slicing_by_8", crc::crc32cSoftware, true },
+    };
+
+    for (size_t packet_size : packet_sizes) {
+        std::vector<uint8_t> packet(packet_size);
+        for (uint8_t& byte : packet) byte = static_cast<uint8_t>(generator());
+        for (const Implementation& implementation : implementations) {
+            if (!implementation.available) continue;
+            uint32_t sink = 0; // 结果累积起来，防止被编译器优化掉
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; ++i) {
+                packet[0] = static_cast<uint8_t>(i);
+                sink ^= implementation.function(packet.data(), packet.size(), 0);
+            }
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            QJsonObject result;
+            result["implementation"] = implementation.name;
+            result["packet_bytes"] = static_cast<int>(packet_size);
+            result["iterations"] = iterations;
+            result["ns_per_packet"] = seconds * 1e9 / iterations;
+            result["gbytes_per_s"] = seconds > 0 ? static_cast<double>(packet_size) * iterations / seconds / 1e9 : 0.0;
+            result["checksum"] = static_cast<qint64>(sink);
+            results.append(result);
+        }
+    }
+    return results;
+}
+
+QJsonArray runXorPayloads() {
+    const size_t sizes[] = { 188, 955, 1500, 2000 };
+    std::vector<uint8_t> src(ForwardErrorCorrection::Packet::kMaxDataSize, 0x5A);
+    std::vector<uint8_t> dst(ForwardErrorCorrection::Packet::kMaxDataSize, 0);
+    QJsonArray results;
+    for (size_t size : sizes) {
+        const Timing timing = measure([&](long long iterations) {
+            for (long long i = 0; i < iterations; ++i) {
+                ForwardErrorCorrection::XorPayloads(src.data(), dst.data(), size);
+            }
+            benchmark_sink = benchmark_sink + dst[0];
+        });
+        QJsonObject result;
+        result["name"] = "XorPayloads";
+        result["payload_bytes"] = static_cast<int>(size);
+        addTiming(result, timing);
+        result["gbytes_per_s"] = size / timing.min_ns;
+        results.append(result);
+    }
+    return results;
+}
+
+QJsonArray runEncodeFec() {
+    const int group_sizes[] = { 4, 10, 16, 24, 48 };
+    const double redundancies[] = { 0.1, 0.2, 0.5 };
+    const size_t payload_sizes[] = { 200, 955, 1500 };
+    const FecMaskType mask_types[] = { kFecMaskRandom, kFecMaskBursty };
+    std::mt19937 generator(12345);
+    QJsonArray results;
+    for (size_t payload_size : payload_sizes) {
+        for (int k : group_sizes) {
+            ForwardErrorCorrection::PacketList media = makeMediaPackets(k, payload_size, generator);
+            int previous_r = 0;
+            for (double redundancy : redundancies) {
+                const int r = std::max(1, static_cast<int>(k * redundancy + 0.5));
+                if (r == previous_r) continue;
+                previous_r = r;
+                for (FecMaskType mask_type : mask_types) {
+                    ForwardErrorCorrection fec;
+                    std::list<ForwardErrorCorrection::Packet*> fec_packets;
+                    const Timing timing = measure([&](long long iterations) {
+                        for (long long i = 0; i < iterations; ++i) {
+                            fec.EncodeFec(media, r, 0, false, mask_type, &fec_packets);
+                            benchmark_sink = benchmark_sink + fec_packets.front()->data[0];
+                            for (ForwardErrorCorrection::Packet* packet : fec_packets) delete packet;
+                            fec_packets.clear();
+                        }
+                    });
+                    QJsonObject result;
+                    result["name"] = "EncodeFec";
+                    result["k"] = k;
+                    result["r"] = r;
+                    result["mask"] = mask_type == kFecMaskRandom ? "random" : "bursty";
+                    result["payload_bytes"] = static_cast<int>(payload_size);
+                    addTiming(result, timing);
+                    result["media_mbytes_per_s"] = static_cast<double>(k) * payload_size / timing.min_ns * 1e3;
+                    results.append(result);
+                }
+            }
+        }
+    }
+    return results;
+}
+
+QJsonArray runLookUpInFecTable() {
+    struct Table { const char* name; const uint8_t* table; FecMaskType type; };
+    const Table tables[] = { { "random", kPacketMaskRandomTbl, kFecMaskRandom }, { "bursty", kPacketMaskBurstyTbl, kFecMaskBursty } };
+    QJsonArray results;
+    for (const Table& table : tables) {
+        // 预定义表只覆盖 k<=12，逐个 (k, r) 查找
+        const Timing lookup = measure([&](long long iterations) {
+            uint32_t sum = 0;
+            for (long long i = 0; i < iterations; ++i) {
+                for (int k = 1; k <= 12; ++k) {
+                    for (int r = 1; r <= k; ++r) {
+                        sum += LookUpInFecTable(table.table, k - 1, r - 1).size();
+                    }
+                }
+            }
+            benchmark_sink = benchmark_sink + sum;
+        });
+        QJsonObject result;
+        result["name"] = "LookUpInFecTable";
+        result["mask"] = table.name;
+        result["lookups_per_op"] = 78; // k=1..12, r=1..k
+        addTiming(result, lookup);
+        result["ns_per_lookup"] = lookup.min_ns / 78;
+        results.append(result);
+
+        // 完整的掩码生成（查表或 k>12 时的交错掩码），每个新组都会调用一次
+        for (int k : { 10, 16, 24, 48 }) {
+            const int r = std::max(1, k / 5);
+            uint8_t packet_mask[kUlpfecMaxMediaPackets * kUlpfecMaxPacketMaskSize];
+            const bool important[kUlpfecMaxMediaPackets] = {};
+            const Timing generate = measure([&](long long iterations) {
+                for (long long i = 0; i < iterations; ++i) {
+                    GenerateGroupPacketMasks(k, r, important, false, table.type, packet_mask);
+                }
+                benchmark_sink = benchmark_sink + packet_mask[0];
+            });
+            QJsonObject mask_result;
+            mask_result["name"] = "GenerateGroupPacketMasks";
+            mask_result["mask"] = table.name;
+            mask_result["k"] = k;
+            mask_result["r"] = r;
+            addTiming(mask_result, generate);
+            results.append(mask_result);
+        }
+    }
+    return results;
+}
+
+QJsonArray runPacketByFec() {
+    struct Config { int k; int r; size_t payload_size; };
+    const Config configs[] = { { 10, 2, 955 }, { 16, 4, 955 }, { 48, 10, 955 }, { 10, 2, 200 } };
+    QJsonArray results;
+    for (const Config& config : configs) {
+        std::vector<char> payload(config.payload_size, 0x33);
+        ForwardErrorCorrection fec;
+        // 每次操作：一个源包进入 FEC，并像发送线程那样取走 buffer_packets 中的输出
+        const Timing timing = measure([&](long long iterations) {
+            for (long long i = 0; i < iterations; ++i) {
+                fec.PacketByFEC(payload.data(), static_cast<int>(config.payload_size), config.k, config.r);
+                while (!fec.buffer_packets.empty()) {
+                    benchmark_sink = benchmark_sink + fec.buffer_packets.front()->sequence_number;
+                    fec.buffer_packets.pop_front();
+                }
+            }
+        });
+        QJsonObject result;
+        result["name"] = "PacketByFEC";
+        result["k"] = config.k;
+        result["r"] = config.r;
+        result["payload_bytes"] = static_cast<int>(config.payload_size);
+        addTiming(result, timing);
+        result["media_mbytes_per_s"] = config.payload_size / timing.min_ns * 1e3;
+        results.append(result);
+    }
+    return results;
+}
+
+QJsonArray runSerialize() {
+    const size_t payload_size = 955;
+    QJsonArray results;
+    for (int k : { 10, 24 }) {
+        for (int version : { ForwardErrorCorrection::Packet::kProtocolV1, ForwardErrorCorrection::Packet::kProtocolV2 }) {
+            ForwardErrorCorrection::Packet packet;
+            packet.group_number = 7;
+            packet.sequence_number = 3;
+            packet.k = static_cast<uint8_t>(k);
+            packet.r = 2;
+            memset(packet.data, 0x44, payload_size);
+            // 两个版本共用：按 v2 的最大头和尾部留空间
+            char buffer[ForwardErrorCorrection::Packet::kMaxHeaderSize + ForwardErrorCorrection::Packet::kMaxDataSize
+                + datagram::kTrailerSizeV2];
+            const Timing serialize = measure([&](long long iterations) {
+                size_t total = 0;
+                for (long long i = 0; i < iterations; ++i) {
+                    total += packet.Serialize(buffer, sizeof(buffer), payload_size, version);
+                }
+                benchmark_sink = benchmark_sink + static_cast<uint32_t>(total);
+            });
+            // 发送线程实际做的：序列化 + CRC-32C + 写尾部
+            const Timing with_crc = measure([&](long long iterations) {
+                for (long long i = 0; i < iterations; ++i) {
+                    const size_t length = packet.Serialize(buffer, sizeof(buffer), payload_size, version);
+                    datagram::Trailer trailer;
+                    trailer.crc32 = crc::crc32c(buffer, length);
+                    trailer.seq = static_cast<uint32_t>(i);
+                    datagram::writeTrailer(buffer + length, trailer, version);
+                }
+                benchmark_sink = benchmark_sink + static_cast<uint8_t>(buffer[0]);
+            });
+            QJsonObject result;
+            result["name"] = "Serialize";
+            result["k"] = k;
+            result["protocol_version"] = version;
+            result["header_bytes"] = static_cast<int>(packet.HeaderSize(version));
+            result["payload_bytes"] = static_cast<int>(payload_size);
+            addTiming(result, serialize);
+            result["ns_per_op_with_crc_and_trailer"] = with_crc.min_ns;
+            results.append(result);
+        }
+    }
+    return results;
+}
+
+QJsonArray runQueueHandoff(int packets) {
+    QJsonArray results;
+    // 与 Udpserver 相同的通道队列：DeadlineQueue + QMutex + QWaitCondition，每个包一次加锁入队、一次唤醒
+    for (bool allocate : { false, true }) {
+        std::vector<double> per_packet;
+        for (int repetition = 0; repetition < 5; ++repetition) {
+            ChannelContext ctx;
+            QThread* consumer = QThread::create([&]() {
+                int received = 0;
+                std::vector<SendPacket> expired;
+                while (received < packets) {
+                    SendPacket sendPkt;
+                    {
+                        QMutexLocker lock(&ctx.queueMutex);
+                        while (ctx.packetQueue.empty()) {
+                            ctx.queueCondition.wait(&ctx.queueMutex);
+                        }
+                        ctx.packetQueue.pop(0, &sendPkt, &expired);
+                    }
+                    benchmark_sink = benchmark_sink + static_cast<uint32_t>(sendPkt.actual_payload_size);
+                    received++;
+                }
+            });
+            consumer->start();
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < packets; ++i) {
+                SendPacket sendPkt;
+                if (allocate) { // 真实路径上每个包都要分配一个 Packet（约 2KB）
+                    sendPkt.packet_to_send = std::make_unique<ForwardErrorCorrection::Packet>();
+                }
+                sendPkt.actual_payload_size = static_cast<size_t>(i);
+                {
+                    QMutexLocker lock(&ctx.queueMutex);
+                    ctx.packetQueue.push_back(std::move(sendPkt));
+                }
+                ctx.queueCondition.wakeOne();
+            }
+            consumer->wait();
+            const double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            delete consumer;
+            per_packet.push_back(elapsed / packets);
+        }
+        std::sort(per_packet.begin(), per_packet.end());
+        QJsonObject result;
+        result["name"] = "QueueHandoff";
+        result["allocate_packet"] = allocate;
+        result["packets"] = packets;
+        result["ns_per_op"] = per_packet.front();
+        result["ns_per_op_median"] = per_packet[per_packet.size() / 2];
+        result["mpackets_per_s"] = 1e3 / per_packet.front();
+        results.append(result);
+    }
+    return results;
+}
+
+QJsonArray runDecode(int media_packets) {
+    struct Config { int k; int r; };
+    const Config configs[] = { { 10, 2 }, { 48, 10 } };
+    const double loss_rates[] = { 0.0, 0.02, 0.05, 0.10 };
+    const size_t payload_size = 955;
+    std::mt19937 generator(12345);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    QJsonArray results;
+
+    for (const Config& config : configs) {
+        // 先生成 v2 的完整包序列，再按丢包率挑出收到的包
+        std::vector<char> payload(payload_size);
+        std::vector<ForwardErrorCorrection::Packet> all_packets;
+        ForwardErrorCorrection fec;
+        const int groups = std::max(1, media_packets / config.k);
+        for (int group = 0; group < groups; ++group) {
+            for (int i = 0; i < config.k; ++i) {
+                for (char& byte : payload) byte = static_cast<char>(generator());
+                fec.PacketByFEC(payload.data(), static_cast<int>(payload_size), config.k, config.r);
+                while (!fec.buffer_packets.empty()) {
+                    all_packets.push_back(*fec.buffer_packets.front());
+                    fec.buffer_packets.pop_front();
+                }
+            }
+        }
+        for (double loss_rate : loss_rates) {
+            std::vector<const ForwardErrorCorrection::Packet*> received;
+            for (const ForwardErrorCorrection::Packet& packet : all_packets) {
+                if (distribution(generator) >= loss_rate) received.push_back(&packet);
+            }
+            std::vector<double> per_packet;
+            FecReceiverStats stats;
+            for (int repetition = 0; repetition < 5; ++repetition) {
+                FecReceiver receiver;
+                uint64_t delivered = 0;
+                receiver.setMediaCallback([&](int64_t, int, const uint8_t*, size_t, bool) { delivered++; });
+                const auto start = std::chrono::steady_clock::now();
+                for (const ForwardErrorCorrection::Packet* packet : received) {
+                    receiver.insert(*packet, payload_size, ForwardErrorCorrection::Packet::kProtocolV2, 0);
+                }
+                receiver.flush();
+                const double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+                per_packet.push_back(elapsed / std::max<size_t>(1, received.size()));
+                stats = receiver.stats();
+                benchmark_sink = benchmark_sink + static_cast<uint32_t>(delivered);
+            }
+            std::sort(per_packet.begin(), per_packet.end());
+            QJsonObject result;
+            result["name"] = "Decode";
+            result["k"] = config.k;
+            result["r"] = config.r;
+            result["loss_rate"] = loss_rate;
+            result["packets_received"] = static_cast<qint64>(received.size());
+            result["ns_per_op"] = per_packet.front();
+            result["ns_per_op_median"] = per_packet[per_packet.size() / 2];
+            result["media_recovered"] = static_cast<qint64>(stats.media_recovered);
+            result["media_lost"] = static_cast<qint64>(stats.media_lost);
+            results.append(result);
+        }
+    }
+    return results;
+}
+
+QJsonArray runHotPaths() {
+    QJsonArray results;
+    for (const QJsonArray& part : { runXorPayloads(), runEncodeFec(), runLookUpInFecTable(), runPacketByFec(),
+        runSerialize(), runQueueHandoff(200000), runDecode(20000) }) {
+        for (const QJsonValue& value : part) results.append(value);
+    }
+    return results;
+}
+
+int runFromCommandLine(const QStringList& arguments) {
+    const int bench_index = arguments.indexOf("--bench");
+    const QString name = (bench_index >= 0 && bench_index + 1 < arguments.size()) ? arguments[bench_index + 1] : QString();
+    const int out_index = arguments.indexOf("--out");
+    const QString out_path = (out_index >= 0 && out_index + 1 < arguments.size()) ? arguments[out_index + 1] : QString();
+
+    if (name == "uep") {
+        return writeResult(name, runUepRecovery(100000), out_path) ? 0 : 1;
+    }
+    if (name == "groupsize") {
+        return writeResult(name, runGroupSize(2000, 100000), out_path) ? 0 : 1;
+    }
+    if (name == "crc") {
+        return writeResult(name, runCrc(1000000), out_path) ? 0 : 1;
+    }
+    if (name == "xor") return writeResult(name, runXorPayloads(), out_path) ? 0 : 1;
+    if (name == "encode") return writeResult(name, runEncodeFec(), out_path) ? 0 : 1;
+    if (name == "lookup") return writeResult(name, runLookUpInFecTable(), out_path) ? 0 : 1;
+    if (name == "packetbyfec") return writeResult(name, runPacketByFec(), out_path) ? 0 : 1;
+    if (name == "serialize") return writeResult(name, runSerialize(), out_path) ? 0 : 1;
+    if (name == "queue") return writeResult(name, runQueueHandoff(200000), out_path) ? 0 : 1;
+    if (name == "decode") return writeResult(name, runDecode(20000), out_path) ? 0 : 1;
+    if (name == "hotpaths") return writeResult(name, runHotPaths(), out_path) ? 0 : 1;
+    fprintf(stderr, "Unknown benchmark '%s'. Available: uep, groupsize, crc, xor, encode, lookup, "
+        "packetbyfec, serialize, queue, decode, hotpaths\n", qPrintable(name));
+    return 2;
+}
+
+} // namespace FecBenchmark
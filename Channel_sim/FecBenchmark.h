@@ -0,0 +1,39 @@
+﻿#pragma once
+#include <QJsonArray>
+#include <QStringList>
+
+// 离线基准测试，命令行调用：Channel_sim.exe --bench <name> [--out result.json]
+// 结果以 JSON 输出，便于不同版本之间对比。
+namespace FecBenchmark {
+
+// 不等保护：相同冗余度下重要包与普通包的残余丢包率（蒙特卡洛 + 逐包剥离解码）
+QJsonArray runUepRecovery(int trials);
+
+// 分组大小：k 从 4 到 48（超过16使用48位掩码）时的编码吞吐、线上开销和残余丢包率
+QJsonArray runGroupSize(int groups, int trials);
+
+// CRC-32C：硬件指令与 slicing-by-8 在 1037/2000 字节包上的单包耗时
+QJsonArray runCrc(int iterations);
+
+// 热路径微基准，每项结果带 name 字段，ns_per_op 为5轮中的最小值（另给中位数）：
+// XorPayloads 各负载长度
+QJsonArray runXorPayloads();
+// EncodeFec：k × r × 掩码类型 × 负载长度 的网格
+QJsonArray runEncodeFec();
+// LookUpInFecTable（k<=12 的预定义表）和完整的 GenerateGroupPacketMasks
+QJsonArray runLookUpInFecTable();
+// PacketByFEC 端到端：每个源包进入 FEC 并取走全部输出
+QJsonArray runPacketByFec();
+// Packet::Serialize，另给加上 CRC-32C 和尾部后的耗时
+QJsonArray runSerialize();
+// 通道队列（deque + QMutex + QWaitCondition）跨线程交接一个包的耗时
+QJsonArray runQueueHandoff(int packets);
+// FecReceiver 在不同丢包率下每收到一个包的处理耗时，media_packets 为每种配置的源包总数
+QJsonArray runDecode(int media_packets);
+// 以上全部
+QJsonArray runHotPaths();
+
+// 解析命令行并运行对应的基准测试，返回进程退出码
+int runFromCommandLine(const QStringList& arguments);
+
+} // namespace FecBenchmark
@@ -0,0 +1,429 @@
+﻿#include "FecReceiver.h"
+#include <algorithm>
+#include <cstring>
+
+#include "Crc32.h"
+#include "OneWayDelay.h"
+
+FecReceiver::FecReceiver(const FecReceiverConfig& config)
+    : config(config) {
+    size_t capacity = 16;
+    while (capacity < config.max_groups) capacity *= 2;
+    slots.resize(capacity);
+    slot_mask = static_cast<int64_t>(capacity - 1);
+    playout_delay_ms = static_cast<double>(config.min_playout_ms);
+}
+
+void FecReceiverStats::accumulate(const FecReceiverStats& other) {
+    datagrams += other.datagrams;
+    malformed += other.malformed;
+    crc_errors += other.crc_errors;
+    duplicates += other.duplicates;
+    late += other.late;
+    media_received += other.media_received;
+    media_recovered += other.media_recovered;
+    media_lost += other.media_lost;
+    groups_complete += other.groups_complete;
+    groups_expired += other.groups_expired;
+    late_media += other.late_media;
+    slot_overflows += other.slot_overflows;
+}
+
+// 由 FEC 头的 V 位确定协议版本，再从数据报末尾取出尾部
+bool FecReceiver::parseFraming(const char* data, size_t len, size_t* header_size, int* protocol_version,
+    datagram::Trailer* trailer) {
+    *header_size = ForwardErrorCorrection::Packet::PeekHeaderSize(data, len);
+    *protocol_version = (*header_size > 0 && (static_cast<uint8_t>(data[4]) & ForwardErrorCorrection::Packet::kVBit))
+        ? ForwardErrorCorrection::Packet::kProtocolV2 : ForwardErrorCorrection::Packet::kProtocolV1;
+    const size_t trailer_size = datagram::trailerSize(*protocol_version);
+    if (*header_size == 0 || len < *header_size + trailer_size) {
+        return false;
+    }
+    return datagram::readTrailer(data + len - trailer_size, trailer_size, *protocol_version, trailer);
+}
+
+bool FecReceiver::peekTrailer(const char* data, size_t len, datagram::Trailer* trailer) {
+    size_t header_size = 0;
+    int protocol_version = 0;
+    return parseFraming(data, len, &header_size, &protocol_version, trailer);
+}
+
+bool FecReceiver::onDatagram(const char* data, size_t len, int64_t now_ms, datagram::Trailer* trailer) {
+    receiver_stats.datagrams++;
+    last_group_id = -1;
+    size_t header_size = 0;
+    int protocol_version = 0;
+    datagram::Trailer parsed_trailer;
+    if (!parseFraming(data, len, &header_size, &protocol_version, &parsed_trailer)) {
+        receiver_stats.malformed++;
+        return false;
+    }
+    last_protocol_version = protocol_version;
+    const size_t payload_size = len - header_size - datagram::trailerSize(protocol_version);
+    if (trailer) {
+        *trailer = parsed_trailer;
+    }
+    if (config.verify_crc && crc::crc32c(data, header_size + payload_size) != parsed_trailer.crc32) {
+        receiver_stats.crc_errors++;
+        return false;
+    }
+
+    ForwardErrorCorrection::Packet packet;
+    int parsed_version = 0;
+    if (packet.Deserialize(data, len, payload_size, &parsed_version) == 0) {
+        receiver_stats.malformed++;
+        return false;
+    }
+    return insert(packet, payload_size, parsed_version, now_ms, parsed_trailer.channel_index);
+}
+
+bool FecReceiver::insert(const ForwardErrorCorrection::Packet& packet, size_t payload_size, int protocol_version, int64_t now_ms,
+    int channel) {
+    const int k = packet.k;
+    const int r = packet.r;
+    const int sequence_number = packet.sequence_number;
+    if (k <= 0 || k > static_cast<int>(kUlpfecMaxMediaPackets) || r > k || sequence_number >= k + r) {
+        receiver_stats.malformed++;
+        return false;
+    }
+
+    // 组号展开为单调的64位值；v1 只用到低8位
+    const int64_t group_id = protocol_version >= ForwardErrorCorrection::Packet::kProtocolV2
+        ? unwrapper_v2.Unwrap(packet.group_number)
+        : unwrapper_v1.Unwrap(static_cast<uint8_t>(packet.group_number));
+    last_now_ms = now_ms;
+    last_group_id = group_id;
+
+    const int64_t capacity = slot_mask + 1;
+    if (!started) {
+        started = true;
+        head_group = group_id;
+        newest_group = group_id;
+    }
+    expire(now_ms);
+    if (group_id < head_group) {
+        if (!released_any && newest_group - group_id < capacity) {
+            head_group = group_id; // 刚开始接收时的乱序，还没有组被释放过
+        }
+        else {
+            // 所属组已释放：槽位还没被复用时区分重复包、已完整播出的组的多余包和迟到的缺失源包
+            Group& old = slotOf(group_id);
+            if (!old.used || old.group_id != group_id) {
+                receiver_stats.late++;
+                return false;
+            }
+            // 迟到的包同样反映该通道的时延，必须计入估计，否则播出延迟永远追不上慢通道
+            updateDelayEstimate(channel, now_ms - old.first_seen_ms);
+            if (old.arrived.test(static_cast<size_t>(sequence_number))) {
+                receiver_stats.duplicates++;
+                return false;
+            }
+            old.arrived.set(static_cast<size_t>(sequence_number));
+            if (old.complete()) {
+                return true; // 组已完整播出，冗余包不再需要
+            }
+            receiver_stats.late++;
+            if (sequence_number < old.k && !old.available.test(static_cast<size_t>(sequence_number))) {
+                receiver_stats.late_media++;
+            }
+            return false;
+        }
+    }
+    // 组号跨度超过槽位数：提前释放最老的组腾出槽位
+    if (group_id - head_group >= capacity) {
+        const int64_t new_head = group_id - capacity + 1;
+        for (int64_t id = head_group; id < new_head && id <= newest_group; ++id) {
+            if (Group* stale = findLive(id)) {
+                receiver_stats.slot_overflows++;
+                release(*stale, now_ms);
+            }
+        }
+        head_group = new_head;
+        released_any = true;
+    }
+    newest_group = std::max(newest_group, group_id);
+
+    Group& group = slotOf(group_id);
+    if (!group.used || group.released || group.group_id != group_id) {
+        // 槽位空闲或存放的是已释放的更早的组，直接复用
+        group.used = true;
+        group.released = false;
+        group.group_id = group_id;
+        group.k = k;
+        group.r = r;
+        group.first_seen_ms = now_ms;
+        group.media_done = 0;
+        group.arrived.reset();
+        group.available.reset();
+        group.recovered.reset();
+        if (group.payloads.size() < kMaxPacketsPerGroup) {
+            group.payloads.resize(kMaxPacketsPerGroup);
+        }
+        live_groups++;
+    }
+    updateDelayEstimate(channel, now_ms - group.first_seen_ms);
+
+    if ((group.k != k || group.r != r) && !reconcileShortened(group, k, r, sequence_number)) {
+        receiver_stats.malformed++;
+        return false;
+    }
+    if (group.arrived.test(static_cast<size_t>(sequence_number))) {
+        receiver_stats.duplicates++;
+        return false;
+    }
+    group.arrived.set(static_cast<size_t>(sequence_number));
+    if (group.complete() || group.available.test(static_cast<size_t>(sequence_number))) {
+        // 源包已经齐了或该包已被恢复，迟到的包不再需要
+        return true;
+    }
+    group.available.set(static_cast<size_t>(sequence_number));
+
+    group.payloads[sequence_number].assign(packet.data, packet.data + payload_size);
+    if (sequence_number < k) {
+        receiver_stats.media_received++;
+        deliver(group_id, group, sequence_number, false, now_ms);
+    }
+    else {
+        const size_t mask_size = PacketMaskSize(static_cast<size_t>(k));
+        memcpy(&group.masks[(sequence_number - k) * mask_size], packet.packet_mask, mask_size);
+    }
+    if (!group.complete()) {
+        recover(group_id, group);
+    }
+    if (config.ordered_playout && group.complete()) {
+        expire(now_ms); // 组完成后立即尝试播出
+    }
+    return true;
+}
+
+bool FecReceiver::groupComplete(int64_t group_id) const {
+    const Group& group = slots[static_cast<size_t>(group_id & slot_mask)];
+    return group.used && group.group_id == group_id && group.complete();
+}
+
+FecReceiver::Group* FecReceiver::findLive(int64_t group_id) {
+    Group& group = slotOf(group_id);
+    return (group.used && !group.released && group.group_id == group_id) ? &group : nullptr;
+}
+
+// 通道相对组内首包的到达时延：快升慢降，时延变大时迅速跟上，变小时缓慢回落，
+// 避免在抖动中频繁缩短播出延迟造成迟到丢包。播出延迟取最慢通道的估计再加余量
+void FecReceiver::updateDelayEstimate(int channel, int64_t offset_ms) {
+    if (channel < 0 || channel >= kMaxChannels) return;
+    double& estimate = channel_delay_ms[channel];
+    const double sample = static_cast<double>(offset_ms);
+    estimate += (sample - estimate) * (sample > estimate ? 0.25 : 1.0 / 64);
+
+    const double slowest = *std::max_element(std::begin(channel_delay_ms), std::end(channel_delay_ms));
+    playout_delay_ms = std::max(static_cast<double>(config.min_playout_ms),
+        std::min(slowest * 1.25 + config.playout_margin_ms, static_cast<double>(config.hold_ms)));
+}
+
+double FecReceiver::channelDelayMs(int channel) const {
+    return (channel >= 0 && channel < kMaxChannels) ? channel_delay_ms[channel] : 0.0;
+}
+
+// 提前结束的组（缩短码）：冗余包头中是 k'/r'，在此之前发出的源包头仍是原来的 k/r。
+// 以冗余包为准把组缩短为 k' 个源包，之后到达的源包只要序号小于 k' 就接受。
+bool FecReceiver::reconcileShortened(Group& group, int k, int r, int sequence_number) {
+    if (sequence_number < k) {
+        // 源包：组已经按冗余包缩短过
+        return k > group.k && sequence_number < group.k;
+    }
+    if (k >= group.k) {
+        return false;
+    }
+    // 冗余包：缩短前组内不能已经有序号 >= k' 的包
+    for (int seq = k; seq < group.k + group.r; ++seq) {
+        if (group.arrived.test(static_cast<size_t>(seq))) return false;
+    }
+    group.k = k;
+    group.r = r;
+    if (group.complete()) {
+        receiver_stats.groups_complete++;
+    }
+    return true;
+}
+
+// 逐包剥离：某个冗余包只差一个源包时，用冗余包异或其余源包恢复它，反复进行直到没有进展
+void FecReceiver::recover(int64_t group_id, Group& group) {
+    const size_t mask_size = PacketMaskSize(static_cast<size_t>(group.k));
+    bool progress = true;
+    while (progress && !group.complete()) {
+        progress = false;
+        for (int row = 0; row < group.r; ++row) {
+            if (!group.available.test(static_cast<size_t>(group.k + row))) continue;
+            const uint8_t* mask_row = &group.masks[row * mask_size];
+            int missing = -1;
+            int missing_count = 0;
+            for (int col = 0; col < group.k && missing_count < 2; ++col) {
+                if ((mask_row[col / 8] & (1 << (7 - (col % 8)))) && !group.available.test(static_cast<size_t>(col))) {
+                    missing = col;
+                    missing_count++;
+                }
+            }
+            if (missing_count != 1) continue;
+
+            // 直接在丢失包的缓冲区里恢复，复用其容量
+            std::vector<uint8_t>& recovered = group.payloads[missing];
+            recovered.assign(group.payloads[group.k + row].begin(), group.payloads[group.k + row].end());
+            for (int col = 0; col < group.k; ++col) {
+                if (col == missing || !(mask_row[col / 8] & (1 << (7 - (col % 8))))) continue;
+                const std::vector<uint8_t>& media = group.payloads[col];
+                ForwardErrorCorrection::XorPayloads(media.data(), recovered.data(), std::min(media.size(), recovered.size()));
+            }
+            // 其余源包带着发送线程填写的时间戳，冗余包里是占位值，异或后这两个字段是垃圾
+            flight_header::clearStamp(recovered.data(), recovered.size());
+            group.available.set(static_cast<size_t>(missing));
+            receiver_stats.media_recovered++;
+            deliver(group_id, group, missing, true, last_now_ms);
+            progress = true;
+            if (group.complete()) break;
+        }
+    }
+}
+
+void FecReceiver::deliver(int64_t group_id, Group& group, int sequence_number, bool recovered, int64_t now_ms) {
+    group.media_done++;
+    group.available_ms[sequence_number] = now_ms;
+    if (recovered) {
+        group.recovered.set(static_cast<size_t>(sequence_number));
+    }
+    // 播出模式下等整组释放时按序号顺序交付
+    if (!config.ordered_playout && media_callback) {
+        const std::vector<uint8_t>& payload = group.payloads[sequence_number];
+        media_callback(group_id, sequence_number, payload.data(), payload.size(), recovered);
+    }
+    if (group.complete()) {
+        receiver_stats.groups_complete++;
+    }
+}
+
+void FecReceiver::release(Group& group, int64_t now_ms) {
+    if (!group.complete()) {
+        receiver_stats.groups_expired++;
+        receiver_stats.media_lost += static_cast<uint64_t>(group.k - group.media_done);
+    }
+    if (config.ordered_playout) {
+        for (int seq = 0; seq < group.k; ++seq) {
+            if (!group.available.test(static_cast<size_t>(seq))) continue;
+            buffer_delay.record(static_cast<uint64_t>(std::max<int64_t>(0, now_ms - group.available_ms[seq])) * 1000000);
+            if (media_callback) {
+                const std::vector<uint8_t>& payload = group.payloads[seq];
+                media_callback(group.group_id, seq, payload.data(), payload.size(), group.recovered.test(static_cast<size_t>(seq)));
+            }
+        }
+    }
+    group.released = true;
+    live_groups--;
+}
+
+void FecReceiver::expire(int64_t now_ms) {
+    // 从最小的未释放组号开始按顺序释放（整组都没收到的组号直接跳过），遇到还不能释放的组即停止，
+    // 避免慢通道上的老组被新组挤掉。保持时间按首包到达时间计算
+    while (started && head_group <= newest_group) {
+        int64_t id = head_group;
+        Group* group = nullptr;
+        for (; id <= newest_group && !group; ++id) {
+            group = findLive(id);
+        }
+        if (!group) break;
+        const int64_t age = now_ms - group->first_seen_ms;
+        bool ready = age > config.hold_ms;
+        if (config.ordered_playout) {
+            // 前面的组都已播出时完成即播出；前面有整组缺失时等到播出时限，给它留出迟到的机会
+            ready = ready || (group->group_id == head_group && group->complete()) ||
+                age >= static_cast<int64_t>(playout_delay_ms);
+        }
+        if (!ready) break;
+        release(*group, now_ms);
+        head_group = group->group_id + 1;
+        released_any = true;
+    }
+}
+
+void FecReceiver::flush() {
+    if (!started) return;
+    for (int64_t id = head_group; id <= newest_group; ++id) {
+        if (Group* group = findLive(id)) {
+            release(*group, last_now_ms);
+        }
+    }
+    head_group = newest_group + 1;
+    released_any = true;
+}
+
+void FecReceiver::reset() {
+    for (Group& group : slots) {
+        group.used = false;
+        group.released = false;
+    }
+    receiver_stats = FecReceiverStats();
+    unwrapper_v1.Reset();
+    unwrapper_v2.Reset();
+    started = false;
+    released_any = false;
+    head_group = 0;
+    newest_group = 0;
+    live_groups = 0;
+    last_group_id = -1;
+    last_protocol_version = 0;
+
+    std::fill(std::begin(channel_delay_ms), std::end(channel_delay_ms), 0.0);
+    playout_delay_ms = static_cast<double>(config.min_playout_ms);
+    buffer_delay.reset();
+}
+
+FecStreamDemux::FecStreamDemux(const FecReceiverConfig& config)
+    : config(config) {
+}
+
+FecReceiver& FecStreamDemux::receiverFor(uint8_t stream_type) {
+    std::unique_ptr<FecReceiver>& receiver = receivers[stream_type];
+    if (!receiver) {
+        receiver = std::make_unique<FecReceiver>(config);
+        if (media_callback) {
+            receiver->setMediaCallback([this, stream_type](int64_t group_id, int sequence_number,
+                const uint8_t* payload, size_t len, bool recovered) {
+                media_callback(stream_type, group_id, sequence_number, payload, len, recovered);
+            });
+        }
+        stream_types.push_back(stream_type);
+    }
+    return *receiver;
+}
+
+bool FecStreamDemux::onDatagram(const char* data, size_t len, int64_t now_ms, datagram::Trailer* trailer) {
+    datagram::Trailer parsed_trailer;
+    last_receiver = nullptr;
+    if (!FecReceiver::peekTrailer(data, len, &parsed_trailer)) {
+        unrouted++;
+        return false;
+    }
+    FecReceiver& receiver = receiverFor(parsed_trailer.stream_type);
+    last_receiver = &receiver;
+    return receiver.onDatagram(data, len, now_ms, trailer);
+}
+
+void FecStreamDemux::expire(int64_t now_ms) {
+    for (uint8_t stream_type : stream_types) receivers[stream_type]->expire(now_ms);
+}
+
+void FecStreamDemux::flush() {
+    for (uint8_t stream_type : stream_types) receivers[stream_type]->flush();
+}
+
+void FecStreamDemux::reset() {
+    for (uint8_t stream_type : stream_types) receivers[stream_type].reset();
+    stream_types.clear();
+    unrouted = 0;
+    last_receiver = nullptr;
+}
+
+FecReceiverStats FecStreamDemux::stats() const {
+    FecReceiverStats total;
+    for (uint8_t stream_type : stream_types) total.accumulate(receivers[stream_type]->stats());
+    total.datagrams += unrouted;
+    total.malformed += unrouted;
+    return total;
+}
@@ -0,0 +1,188 @@
+﻿#pragma once
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "udp_with_ulpfec.h"
+#include "rtc_base/numerics/sequence_number_unwrapper.h"
+#include "DatagramFormat.h"
+#include "ChannelMetrics.h"
+
+struct FecReceiverConfig {
+    int64_t hold_ms = 3000;   // 组最多保留多久（从收到该组第一个包算起），覆盖慢通道的乱序
+    size_t max_groups = 2048; // 组槽位数（向上取2的幂），组号跨度超出时提前释放最老的组
+    bool verify_crc = true;   // 进入解码器前校验尾部的 CRC-32C
+
+    // 抖动缓冲：按组号顺序播出。组完成（含可恢复）且之前的组都已播出时立即整组交付，
+    // 否则等到播出时限（首包到达 + 自适应播出延迟）后交付已有的源包
+    bool ordered_playout = false;
+    int64_t min_playout_ms = 5;     // 播出延迟下限
+    int64_t playout_margin_ms = 5;  // 在通道间时延差估计之上额外留的余量
+};
+
+struct FecReceiverStats {
+    uint64_t datagrams = 0;
+    uint64_t malformed = 0;       // 头或尾部不合法
+    uint64_t crc_errors = 0;      // CRC 校验失败，整包丢弃，避免污染组内的异或恢复
+    uint64_t duplicates = 0;      // 多路冗余等原因重复收到的包
+    uint64_t late = 0;            // 所属组已过期，只能丢弃
+    uint64_t media_received = 0;  // 直接收到的源包
+    uint64_t media_recovered = 0; // 由冗余包恢复的源包
+    uint64_t media_lost = 0;      // 组过期时仍缺失的源包
+    uint64_t groups_complete = 0;
+    uint64_t groups_expired = 0;  // 过期时仍不完整的组
+    uint64_t late_media = 0;      // 迟到的源包：到达时所属组已播出且当时缺少它（延迟再大一些就不会丢）
+    uint64_t slot_overflows = 0;  // 组号跨度超过槽位数而被提前释放的组
+
+    // 累加另一个解码器的统计（多个流或多个接收线程汇总时用）
+    void accumulate(const FecReceiverStats& other);
+};
+
+// 接收端的 FEC 组缓存：按展开后的组号保存多个在途组，收到足够的包后用异或恢复丢失的源包。
+// v1 组号只有8位，只能区分前后 128 组以内的乱序；v2 使用32位组号，保持时间内的组不会混淆。
+// 组保存在按组号取模的固定槽位环中，槽位和负载缓冲区循环复用，稳定运行后收包路径不分配内存。
+// 开启 ordered_playout 后同时作为抖动缓冲：按组号顺序播出，播出延迟根据各通道相对于
+// 组内首包的到达时延自适应调整。
+// 不是线程安全的，应由单个接收线程调用。
+class FecReceiver {
+public:
+    // group_id 为展开后的组号，单调递增不回绕；recovered 表示该源包是恢复出来的
+    using MediaCallback = std::function<void(int64_t group_id, int sequence_number,
+        const uint8_t* payload, size_t len, bool recovered)>;
+
+    explicit FecReceiver(const FecReceiverConfig& config = FecReceiverConfig());
+
+    void setMediaCallback(MediaCallback callback) { media_callback = std::move(callback); }
+
+    // 解析一个完整的数据报（FEC头 | 负载 | 尾部）并校验 CRC，v1 和 v2 都从末尾定位尾部
+    bool onDatagram(const char* data, size_t len, int64_t now_ms, datagram::Trailer* trailer = nullptr);
+
+    // 只定位并解析尾部（不校验 CRC、不解析 FEC 头的其余字段），数据报太短时返回 false
+    static bool peekTrailer(const char* data, size_t len, datagram::Trailer* trailer);
+
+    // 直接交给组缓存，返回 false 表示该包被丢弃（重复、过期或不合法）。
+    // channel 为到达的通道号（用于估计通道间时延差），未知时传 -1
+    bool insert(const ForwardErrorCorrection::Packet& packet, size_t payload_size, int protocol_version, int64_t now_ms,
+        int channel = -1);
+
+    // 释放超过保持时间（或播出时限）的组，insert 时会自动调用
+    void expire(int64_t now_ms);
+
+    // 结束接收：所有未完成的组按过期处理
+    void flush();
+    void reset();
+
+    const FecReceiverStats& stats() const { return receiver_stats; }
+    size_t groupsInFlight() const { return live_groups; }
+
+    // 最近一次 onDatagram 的数据报通过了校验并交给组缓存时为展开后的组号，否则为 -1
+    int64_t lastGroupId() const { return last_group_id; }
+    int lastProtocolVersion() const { return last_protocol_version; }
+    // 组的源包都已收到或恢复（组已释放但槽位还没复用时同样可查）
+    bool groupComplete(int64_t group_id) const;
+
+    // 当前播出延迟和各通道相对组内首包的到达时延估计（毫秒）
+    double playoutDelayMs() const { return playout_delay_ms; }
+    double channelDelayMs(int channel) const;
+    // 播出模式下每个源包从可用（收到或恢复）到交付的时间（纳秒）
+    const LatencyHistogram& bufferDelay() const { return buffer_delay; }
+
+    static constexpr int kMaxChannels = 8;
+
+private:
+    static constexpr size_t kMaxPacketsPerGroup = 2 * kUlpfecMaxMediaPackets; // k + r
+
+    struct Group {
+        bool used = false;     // 槽位曾经存放过 group_id 这个组
+        bool released = false; // 已过期或已播出，只保留收包标记用于识别迟到包
+        int64_t group_id = 0;
+        int k = 0;
+        int r = 0;
+        int64_t first_seen_ms = 0;
+        int media_done = 0; // 已交付（收到或恢复）的源包数
+        std::bitset<kMaxPacketsPerGroup> arrived;   // 实际收到过的包，用于去重
+        std::bitset<kMaxPacketsPerGroup> available; // 收到或恢复出来的包
+        std::bitset<kUlpfecMaxMediaPackets> recovered;
+        int64_t available_ms[kUlpfecMaxMediaPackets] = {}; // 源包可用的时刻，用于统计缓冲时延
+        std::vector<std::vector<uint8_t>> payloads; // 下标为组内序号，容量随槽位复用
+        uint8_t masks[kUlpfecMaxMediaPackets * kUlpfecMaxPacketMaskSize] = {};
+
+        bool complete() const { return media_done == k; }
+    };
+
+    FecReceiverConfig config;
+    FecReceiverStats receiver_stats;
+    MediaCallback media_callback;
+    webrtc::SeqNumUnwrapper<uint8_t> unwrapper_v1;
+    webrtc::SeqNumUnwrapper<uint32_t> unwrapper_v2;
+    std::vector<Group> slots; // 下标为 group_id & slot_mask
+    int64_t slot_mask = 0;
+    bool started = false;
+    bool released_any = false;
+    int64_t head_group = 0;   // 最小的未释放组号，更早的组的包都算迟到
+    int64_t newest_group = 0;
+    size_t live_groups = 0;
+    int64_t last_now_ms = 0;
+    int64_t last_group_id = -1;
+    int last_protocol_version = 0;
+
+    double channel_delay_ms[kMaxChannels] = {};
+    double playout_delay_ms = 0;
+    LatencyHistogram buffer_delay;
+
+    static bool parseFraming(const char* data, size_t len, size_t* header_size, int* protocol_version,
+        datagram::Trailer* trailer);
+    Group& slotOf(int64_t group_id) { return slots[static_cast<size_t>(group_id & slot_mask)]; }
+    Group* findLive(int64_t group_id);
+    void updateDelayEstimate(int channel, int64_t offset_ms);
+    bool reconcileShortened(Group& group, int k, int r, int sequence_number);
+    void recover(int64_t group_id, Group& group);
+    void deliver(int64_t group_id, Group& group, int sequence_number, bool recovered, int64_t now_ms);
+    void release(Group& group, int64_t now_ms);
+};
+
+// 多路流的接收端：按尾部的 stream_type 把数据报分给各自的 FecReceiver。
+// 发送端每个流有独立的 FEC 编码器，组号各自编号，所以不同流不能共用一个组缓存。
+// 某个流的解码器在第一次收到该流的数据报时创建。不是线程安全的，应由单个接收线程调用。
+class FecStreamDemux {
+public:
+    using MediaCallback = std::function<void(uint8_t stream_type, int64_t group_id, int sequence_number,
+        const uint8_t* payload, size_t len, bool recovered)>;
+
+    explicit FecStreamDemux(const FecReceiverConfig& config = FecReceiverConfig());
+
+    // 须在收到第一个数据报之前设置
+    void setMediaCallback(MediaCallback callback) { media_callback = std::move(callback); }
+
+    bool onDatagram(const char* data, size_t len, int64_t now_ms, datagram::Trailer* trailer = nullptr);
+    void expire(int64_t now_ms);
+    void flush();
+    void reset();
+
+    // 最近一次 onDatagram 交给的流的 lastGroupId / lastProtocolVersion，没有交给任何流时为 -1 / 0
+    int64_t lastGroupId() const { return last_receiver ? last_receiver->lastGroupId() : -1; }
+    int lastProtocolVersion() const { return last_receiver ? last_receiver->lastProtocolVersion() : 0; }
+    bool groupComplete(uint8_t stream_type, int64_t group_id) const {
+        return receivers[stream_type] && receivers[stream_type]->groupComplete(group_id);
+    }
+
+    // 所有流的统计之和，另加无法定位尾部、没有交给任何流的数据报（计入 malformed）
+    FecReceiverStats stats() const;
+    // 未收到过该流时返回 nullptr
+    const FecReceiver* stream(uint8_t stream_type) const { return receivers[stream_type].get(); }
+    // 已收到过的流，按第一次出现的顺序
+    const std::vector<uint8_t>& streamTypes() const { return stream_types; }
+
+private:
+    FecReceiverConfig config;
+    MediaCallback media_callback;
+    std::unique_ptr<FecReceiver> receivers[256];
+    std::vector<uint8_t> stream_types;
+    uint64_t unrouted = 0;
+    const FecReceiver* last_receiver = nullptr;
+
+    FecReceiver& receiverFor(uint8_t stream_type);
+};
@@ -0,0 +1,647 @@
+﻿#include "InputSource.h"
+#include <QDebug>
+#include <QFile>
+#include <QThread>
+#include <QUrl>
+#include <QUrlQuery>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <thread>
+
+#include "TsPacketizer.h"
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+using SocketHandle = SOCKET;
+constexpr SocketHandle kInvalidSocket = INVALID_SOCKET;
+#else
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+using SocketHandle = int;
+constexpr SocketHandle kInvalidSocket = -1;
+#endif
+
+namespace {
+
+int64_t steadyNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void storeMax(std::atomic<uint64_t>& target, uint64_t value) {
+    if (value > target.load(std::memory_order_relaxed)) target.store(value, std::memory_order_relaxed);
+}
+
+} // namespace
+
+void IngestNotifier::notify() {
+    counter.fetch_add(1, std::memory_order_release);
+    QMutexLocker lock(&mutex);
+    condition.wakeAll();
+}
+
+bool IngestNotifier::wait(uint64_t seen, int timeout_ms) {
+    QMutexLocker lock(&mutex);
+    if (counter.load(std::memory_order_acquire) != seen) return true;
+    condition.wait(&mutex, static_cast<unsigned long>(std::max(0, timeout_ms)));
+    return counter.load(std::memory_order_acquire) != seen;
+}
+
+IngestBuffer::IngestBuffer(size_t capacity_bytes)
+    : capacity_bytes(std::max<size_t>(capacity_bytes, 64 * 1024)) {
+}
+
+void IngestBuffer::setNotifier(std::shared_ptr<IngestNotifier> notifier) {
+    QMutexLocker lock(&mutex);
+    this->notifier = std::move(notifier);
+}
+
+void IngestBuffer::push(const char* data, size_t len, int64_t ingest_ns) {
+    if (len == 0) return;
+    std::shared_ptr<IngestNotifier> notify_target;
+    {
+        QMutexLocker lock(&mutex);
+        // 满了就从最老的块开始丢，直到放得下
+        while (!blocks.empty() && buffered + len > capacity_bytes) {
+            Block& oldest = blocks.front();
+            const size_t remaining = oldest.data.size() - oldest.offset;
+            buffered -= remaining;
+            stats.bytes_dropped.store(stats.bytes_dropped.load(std::memory_order_relaxed) + remaining, std::memory_order_relaxed);
+            stats.blocks_dropped.store(stats.blocks_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            spare.push_back(std::move(oldest.data));
+            blocks.pop_front();
+        }
+        Block block;
+        if (!spare.empty()) {
+            block.data = std::move(spare.back());
+            spare.pop_back();
+        }
+        block.data.assign(data, data + len);
+        block.ingest_ns = ingest_ns;
+        blocks.push_back(std::move(block));
+        buffered += len;
+        stats.buffered_bytes.store(buffered, std::memory_order_relaxed);
+        storeMax(stats.peak_buffered_bytes, buffered);
+        notify_target = notifier;
+    }
+    stats.bytes_in.store(stats.bytes_in.load(std::memory_order_relaxed) + len, std::memory_order_relaxed);
+    stats.blocks_in.store(stats.blocks_in.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    condition.wakeOne();
+    if (notify_target) notify_target->notify();
+}
+
+qint64 IngestBuffer::pop(char* out, qint64 max_len, int timeout_ms, int64_t* ingest_ns) {
+    QMutexLocker lock(&mutex);
+    if (blocks.empty() && !closed && timeout_ms > 0) {
+        condition.wait(&mutex, static_cast<unsigned long>(timeout_ms));
+    }
+    if (blocks.empty()) return closed ? -1 : 0;
+    if (ingest_ns) *ingest_ns = blocks.front().ingest_ns;
+    qint64 copied = 0;
+    while (copied < max_len && !blocks.empty()) {
+        Block& block = blocks.front();
+        const size_t take = std::min(block.data.size() - block.offset, static_cast<size_t>(max_len - copied));
+        memcpy(out + copied, block.data.data() + block.offset, take);
+        block.offset += take;
+        copied += static_cast<qint64>(take);
+        if (block.offset == block.data.size()) {
+            spare.push_back(std::move(block.data));
+            blocks.pop_front();
+        }
+    }
+    buffered -= static_cast<size_t>(copied);
+    stats.buffered_bytes.store(buffered, std::memory_order_relaxed);
+    return copied;
+}
+
+QByteArray IngestBuffer::peek(int len, int timeout_ms) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    QMutexLocker lock(&mutex);
+    while (buffered < static_cast<size_t>(len) && !closed) {
+        const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0) break;
+        condition.wait(&mutex, static_cast<unsigned long>(remaining));
+    }
+    QByteArray head;
+    for (const Block& block : blocks) {
+        if (head.size() >= len) break;
+        const size_t take = std::min(block.data.size() - block.offset, static_cast<size_t>(len - head.size()));
+        head.append(block.data.data() + block.offset, static_cast<qsizetype>(take));
+    }
+    return head;
+}
+
+void IngestBuffer::close() {
+    std::shared_ptr<IngestNotifier> notify_target;
+    {
+        QMutexLocker lock(&mutex);
+        closed = true;
+        notify_target = notifier;
+    }
+    condition.wakeAll();
+    if (notify_target) notify_target->notify();
+}
+
+bool IngestBuffer::hasData() const {
+    QMutexLocker lock(&mutex);
+    return !blocks.empty() || closed;
+}
+
+bool IngestBuffer::isClosed() const {
+    QMutexLocker lock(&mutex);
+    return closed;
+}
+
+IngestSnapshot InputSource::snapshot() const {
+    IngestSnapshot snapshot;
+    snapshot.source = source_uri;
+    snapshot.live = isLive();
+    return snapshot;
+}
+
+namespace {
+
+// 文件：不经过缓冲区，读取时刻即进入时刻
+class FileInputSource : public InputSource {
+public:
+    explicit FileInputSource(const QString& path) : InputSource(path), file(path) {}
+
+    bool open(QString* error) override {
+        if (file.open(QIODevice::ReadOnly)) return true;
+        if (error) *error = file.errorString();
+        return false;
+    }
+    void close() override { file.close(); }
+    qint64 read(char* out, qint64 max_len, int, int64_t* ingest_ns) override {
+        if (ingest_ns) *ingest_ns = steadyNowNs();
+        const qint64 got = file.read(out, max_len);
+        if (got > 0) {
+            bytes_in += static_cast<uint64_t>(got);
+            return got;
+        }
+        return -1; // 读完或出错
+    }
+    QByteArray peek(int len, int) override { return file.peek(len); }
+    bool hasData() const override { return true; }
+    bool isLive() const override { return false; }
+    IngestSnapshot snapshot() const override {
+        IngestSnapshot snapshot = InputSource::snapshot();
+        snapshot.bytes_in = bytes_in;
+        return snapshot;
+    }
+
+private:
+    QFile file;
+    std::atomic<uint64_t> bytes_in{ 0 };
+};
+
+// 直播源的公共部分：接收线程写 IngestBuffer，读取线程从中取
+class LiveInputSource : public InputSource {
+public:
+    LiveInputSource(const QString& uri, size_t buffer_bytes) : InputSource(uri), buffer(buffer_bytes) {}
+
+    bool open(QString* error) override {
+        if (!openInput(error)) {
+            closeInput();
+            return false;
+        }
+        running.store(true);
+        thread = QThread::create([this]() {
+            ingestLoop();
+            buffer.close();
+        });
+        thread->setObjectName("IngestThread");
+        thread->start();
+        return true;
+    }
+    void close() override {
+        if (!thread) return;
+        running.store(false);
+        // 阻塞在管道读取上的线程无法唤醒，等一段时间后强制结束
+        if (!thread->wait(1000)) {
+            qWarning() << "Ingest thread for" << uri() << "did not finish in time, terminating...";
+            thread->terminate();
+            thread->wait();
+        }
+        delete thread;
+        thread = nullptr;
+        closeInput();
+        buffer.close();
+    }
+    qint64 read(char* out, qint64 max_len, int timeout_ms, int64_t* ingest_ns) override {
+        return buffer.pop(out, max_len, timeout_ms, ingest_ns);
+    }
+    QByteArray peek(int len, int timeout_ms) override { return buffer.peek(len, timeout_ms); }
+    bool hasData() const override { return buffer.hasData(); }
+    bool isLive() const override { return true; }
+    void setNotifier(std::shared_ptr<IngestNotifier> notifier) override { buffer.setNotifier(std::move(notifier)); }
+    IngestSnapshot snapshot() const override {
+        IngestSnapshot snapshot = InputSource::snapshot();
+        const IngestCounters& counters = buffer.counters();
+        snapshot.bytes_in = counters.bytes_in.load(std::memory_order_relaxed);
+        snapshot.blocks_in = counters.blocks_in.load(std::memory_order_relaxed);
+        snapshot.bytes_dropped = counters.bytes_dropped.load(std::memory_order_relaxed);
+        snapshot.blocks_dropped = counters.blocks_dropped.load(std::memory_order_relaxed);
+        snapshot.buffered_bytes = counters.buffered_bytes.load(std::memory_order_relaxed);
+        snapshot.peak_buffered_bytes = counters.peak_buffered_bytes.load(std::memory_order_relaxed);
+        snapshot.capacity_bytes = buffer.capacity();
+        return snapshot;
+    }
+
+protected:
+    IngestBuffer buffer;
+    std::atomic<bool> running{ false };
+
+    virtual bool openInput(QString* error) = 0;
+    // 在接收线程中运行，running 变为 false 或输入结束时返回
+    virtual void ingestLoop() = 0;
+    virtual void closeInput() = 0;
+
+private:
+    QThread* thread = nullptr;
+};
+
+// UDP 单播/组播 TS：一个非阻塞套接字，等待可读后按批收空
+class UdpInputSource : public LiveInputSource {
+public:
+    UdpInputSource(const QString& uri, size_t buffer_bytes) : LiveInputSource(uri, buffer_bytes) {}
+    ~UdpInputSource() override { close(); }
+
+protected:
+    bool openInput(QString* error) override {
+        const QUrl url(uri());
+        const QString host = url.host().isEmpty() ? QStringLiteral("0.0.0.0") : url.host();
+        const int port = url.port();
+        const QString interface_address = QUrlQuery(url).queryItemValue("ifaddr");
+        in_addr group;
+        if (port <= 0 || inet_pton(AF_INET, host.toStdString().c_str(), &group) != 1) {
+            if (error) *error = "expected udp://[@]ipv4:port";
+            return false;
+        }
+#if defined(_WIN32)
+        WSADATA wsa;
+        if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+            if (error) *error = "WSAStartup failed";
+            return false;
+        }
+        winsock_started = true;
+#endif
+        socket_handle = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (socket_handle == kInvalidSocket) {
+            if (error) *error = "socket creation failed";
+            return false;
+        }
+        int enable = 1;
+        setsockopt(socket_handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&enable), sizeof(enable));
+        // 编码器按帧突发输出，内核缓冲区开大，接收线程来不及时先在内核里排队
+        int buffer_size = 8 * 1024 * 1024;
+        setsockopt(socket_handle, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&buffer_size), sizeof(buffer_size));
+#if defined(_WIN32)
+        u_long non_blocking = 1;
+        ioctlsocket(socket_handle, FIONBIO, &non_blocking);
+#else
+        fcntl(socket_handle, F_SETFL, fcntl(socket_handle, F_GETFL) | O_NONBLOCK);
+#endif
+        const bool multicast = (ntohl(group.s_addr) & 0xF0000000) == 0xE0000000; // 224.0.0.0/4
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        // 组播绑定任意地址（Windows 不能绑定组地址），单播绑定给定的本机地址
+        addr.sin_addr.s_addr = multicast ? htonl(INADDR_ANY) : group.s_addr;
+        if (bind(socket_handle, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            if (error) *error = QString("bind to port %1 failed").arg(port);
+            return false;
+        }
+        if (multicast) {
+            ip_mreq request;
+            memset(&request, 0, sizeof(request));
+            request.imr_multiaddr = group;
+            request.imr_interface.s_addr = htonl(INADDR_ANY);
+            if (!interface_address.isEmpty()) {
+                inet_pton(AF_INET, interface_address.toStdString().c_str(), &request.imr_interface);
+            }
+            if (setsockopt(socket_handle, IPPROTO_IP, IP_ADD_MEMBERSHIP, reinterpret_cast<const char*>(&request), sizeof(request)) != 0) {
+                if (error) *error = QString("joining multicast group %1 failed").arg(host);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void ingestLoop() override {
+        constexpr int kBatch = 32;
+        constexpr size_t kMaxDatagram = 65536;
+        std::vector<char> buffers(kBatch * kMaxDatagram);
+        while (running.load()) {
+#if defined(_WIN32)
+            WSAPOLLFD poll_fd;
+            poll_fd.fd = socket_handle;
+            poll_fd.events = POLLRDNORM;
+            poll_fd.revents = 0;
+            if (WSAPoll(&poll_fd, 1, 50) <= 0) continue;
+#else
+            pollfd poll_fd{ socket_handle, POLLIN, 0 };
+            if (poll(&poll_fd, 1, 50) <= 0) continue;
+#endif
+            // 可读后一直收到没有数据为止，一次系统调用最多取 kBatch 个数据报
+            for (;;) {
+                const int64_t now_ns = steadyNowNs();
+                int received = 0;
+#if defined(__linux__)
+                mmsghdr messages[kBatch];
+                iovec vectors[kBatch];
+                for (int i = 0; i < kBatch; ++i) {
+                    vectors[i].iov_base = &buffers[static_cast<size_t>(i) * kMaxDatagram];
+                    vectors[i].iov_len = kMaxDatagram;
+                    memset(&messages[i].msg_hdr, 0, sizeof(messages[i].msg_hdr));
+                    messages[i].msg_hdr.msg_iov = &vectors[i];
+                    messages[i].msg_hdr.msg_iovlen = 1;
+                }
+                received = std::max(0, recvmmsg(socket_handle, messages, kBatch, MSG_DONTWAIT, nullptr));
+                for (int i = 0; i < received; ++i) {
+                    buffer.push(&buffers[static_cast<size_t>(i) * kMaxDatagram], messages[i].msg_len, now_ns);
+                }
+#else
+                for (; received < kBatch; ++received) {
+                    const int len = static_cast<int>(recv(socket_handle, buffers.data(), static_cast<int>(kMaxDatagram), 0));
+                    if (len <= 0) break;
+                    buffer.push(buffers.data(), static_cast<size_t>(len), now_ns);
+                }
+#endif
+                if (received < kBatch) break;
+            }
+        }
+    }
+
+    void closeInput() override {
+        if (socket_handle != kInvalidSocket) {
+#if defined(_WIN32)
+            closesocket(socket_handle);
+#else
+            ::close(socket_handle);
+#endif
+            socket_handle = kInvalidSocket;
+        }
+#if defined(_WIN32)
+        if (winsock_started) WSACleanup();
+        winsock_started = false;
+#endif
+    }
+
+private:
+    SocketHandle socket_handle = kInvalidSocket;
+#if defined(_WIN32)
+    bool winsock_started = false;
+#endif
+};
+
+// 命名管道和标准输入：阻塞读取，管道里有多少取多少，不等凑满缓冲区
+class PipeInputSource : public LiveInputSource {
+public:
+    // path 为空表示标准输入
+    PipeInputSource(const QString& uri, const QString& path, size_t buffer_bytes)
+        : LiveInputSource(uri, buffer_bytes), path(path) {}
+    ~PipeInputSource() override { close(); }
+
+protected:
+    bool openInput(QString* error) override {
+#if defined(_WIN32)
+        if (path.isEmpty()) {
+            handle = GetStdHandle(STD_INPUT_HANDLE);
+            owns_handle = false;
+        }
+        else {
+            handle = CreateFileW(reinterpret_cast<const wchar_t*>(path.utf16()), GENERIC_READ, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+            owns_handle = true;
+        }
+        if (handle == INVALID_HANDLE_VALUE || handle == nullptr) {
+            if (error) *error = QString("cannot open %1 (error %2)").arg(path.isEmpty() ? QStringLiteral("stdin") : path).arg(GetLastError());
+            return false;
+        }
+#else
+        if (path.isEmpty()) {
+            fd = 0;
+            owns_handle = false;
+        }
+        else {
+            fd = ::open(path.toLocal8Bit().constData(), O_RDONLY);
+            owns_handle = true;
+        }
+        if (fd < 0) {
+            if (error) *error = QString("cannot open %1 (errno %2)").arg(path).arg(errno);
+            return false;
+        }
+#endif
+        return true;
+    }
+
+    void ingestLoop() override {
+        std::vector<char> chunk(64 * 1024);
+        while (running.load()) {
+#if defined(_WIN32)
+            DWORD got = 0;
+            if (!ReadFile(handle, chunk.data(), static_cast<DWORD>(chunk.size()), &got, nullptr) || got == 0) break; // 对端关闭
+#else
+            const ssize_t got = ::read(fd, chunk.data(), chunk.size());
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) break; // 对端关闭
+#endif
+            buffer.push(chunk.data(), static_cast<size_t>(got), steadyNowNs());
+        }
+    }
+
+    void closeInput() override {
+#if defined(_WIN32)
+        if (owns_handle && handle != INVALID_HANDLE_VALUE && handle != nullptr) CloseHandle(handle);
+        handle = INVALID_HANDLE_VALUE;
+#else
+        if (owns_handle && fd >= 0) ::close(fd);
+        fd = -1;
+#endif
+    }
+
+private:
+    QString path;
+    bool owns_handle = false;
+#if defined(_WIN32)
+    HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
+};
+
+// MPEG-2 PSI 使用的 CRC-32（多项式 0x04C11DB7，不反转）
+uint32_t crc32Mpeg(const uint8_t* data, size_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; ++i) {
+        crc ^= static_cast<uint32_t>(data[i]) << 24;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+// 合成 TS 流：PAT/PMT + 一路视频 PID，按帧率突发输出。每个 GOP 第一帧是带随机访问标志的 I 帧，
+// 每帧第一个包带 PCR。用于在没有编码器的情况下测试直播路径的突发吸收和时延。
+class SyntheticInputSource : public LiveInputSource {
+public:
+    SyntheticInputSource(const QString& uri, size_t buffer_bytes) : LiveInputSource(uri, buffer_bytes) {}
+    ~SyntheticInputSource() override { close(); }
+
+protected:
+    bool openInput(QString* error) override {
+        const QUrlQuery query{ QUrl(uri()) };
+        auto value = [&query](const char* name, double fallback) {
+            bool ok = false;
+            const double parsed = query.queryItemValue(name).toDouble(&ok);
+            return ok ? parsed : fallback;
+        };
+        bitrate_bps = value("bitrate", 8e6);
+        fps = value("fps", 25);
+        gop = std::max(1, static_cast<int>(value("gop", 12)));
+        iframe_ratio = std::max(1.0, value("iframe", 6));
+        duration_s = value("duration", 0);
+        generator.seed(static_cast<uint32_t>(value("seed", 1)));
+        if (bitrate_bps <= 0 || fps <= 0) {
+            if (error) *error = "bitrate and fps must be positive";
+            return false;
+        }
+        return true;
+    }
+
+    void ingestLoop() override {
+        constexpr uint16_t kPmtPid = 0x1000;
+        constexpr uint16_t kVideoPid = 0x0100;
+        constexpr size_t kPacketsPerBlock = 7; // 与常见的 UDP TS 数据报一致
+        // GOP 内 I 帧占 iframe_ratio 份，其余每帧 1 份
+        const double gop_bytes = bitrate_bps / 8 * gop / fps;
+        const double p_frame_bytes = gop_bytes / (iframe_ratio + gop - 1);
+        const int64_t frame_interval_ns = static_cast<int64_t>(1e9 / fps);
+        const int64_t total_frames = duration_s > 0 ? static_cast<int64_t>(duration_s * fps) : -1;
+        uint8_t continuity[0x2000] = {};
+        std::vector<uint8_t> block;
+        block.reserve(kPacketsPerBlock * ts::kPacketSize);
+
+        auto flushBlock = [&](int64_t now_ns) {
+            if (block.empty()) return;
+            buffer.push(reinterpret_cast<const char*>(block.data()), block.size(), now_ns);
+            block.clear();
+        };
+        auto appendPacket = [&](const uint8_t* packet, int64_t now_ns) {
+            block.insert(block.end(), packet, packet + ts::kPacketSize);
+            if (block.size() >= kPacketsPerBlock * ts::kPacketSize) flushBlock(now_ns);
+        };
+        auto header = [&](uint8_t* packet, uint16_t pid, bool unit_start, bool adaptation) {
+            packet[0] = ts::kSyncByte;
+            packet[1] = static_cast<uint8_t>((unit_start ? 0x40 : 0x00) | (pid >> 8));
+            packet[2] = static_cast<uint8_t>(pid & 0xFF);
+            packet[3] = static_cast<uint8_t>((adaptation ? 0x30 : 0x10) | (continuity[pid]++ & 0x0F));
+        };
+        auto sectionPacket = [&](uint16_t pid, const uint8_t* section, size_t len, int64_t now_ns) {
+            uint8_t packet[ts::kPacketSize];
+            memset(packet, 0xFF, sizeof(packet));
+            header(packet, pid, true, false);
+            packet[4] = 0; // pointer_field
+            memcpy(packet + 5, section, len);
+            const uint32_t crc = crc32Mpeg(section, len);
+            packet[5 + len] = static_cast<uint8_t>(crc >> 24);
+            packet[6 + len] = static_cast<uint8_t>(crc >> 16);
+            packet[7 + len] = static_cast<uint8_t>(crc >> 8);
+            packet[8 + len] = static_cast<uint8_t>(crc);
+            appendPacket(packet, now_ns);
+        };
+        const uint8_t pat[] = { 0x00, 0xB0, 0x0D, 0x00, 0x01, 0xC1, 0x00, 0x00,
+            0x00, 0x01, static_cast<uint8_t>(0xE0 | (kPmtPid >> 8)), static_cast<uint8_t>(kPmtPid & 0xFF) };
+        const uint8_t pmt[] = { 0x02, 0xB0, 0x12, 0x00, 0x01, 0xC1, 0x00, 0x00,
+            static_cast<uint8_t>(0xE0 | (kVideoPid >> 8)), static_cast<uint8_t>(kVideoPid & 0xFF), 0xF0, 0x00,
+            0x1B, static_cast<uint8_t>(0xE0 | (kVideoPid >> 8)), static_cast<uint8_t>(kVideoPid & 0xFF), 0xF0, 0x00 };
+
+        const int64_t start_ns = steadyNowNs();
+        for (int64_t frame = 0; running.load() && (total_frames < 0 || frame < total_frames); ++frame) {
+            const int64_t release_ns = start_ns + frame * frame_interval_ns;
+            std::this_thread::sleep_for(std::chrono::nanoseconds(std::max<int64_t>(0, release_ns - steadyNowNs())));
+            const int64_t now_ns = steadyNowNs();
+            const bool key_frame = frame % gop == 0;
+            // PAT/PMT 每个 I 帧前和大约每 100ms 各插一次
+            if (key_frame || frame % std::max(1, static_cast<int>(fps / 10)) == 0) {
+                sectionPacket(ts::kPatPid, pat, sizeof(pat), now_ns);
+                sectionPacket(kPmtPid, pmt, sizeof(pmt), now_ns);
+            }
+            const size_t frame_bytes = static_cast<size_t>(key_frame ? p_frame_bytes * iframe_ratio : p_frame_bytes);
+            const size_t frame_packets = std::max<size_t>(1, (frame_bytes + 183) / 184);
+            const uint64_t pcr = static_cast<uint64_t>(frame * 27e6 / fps);
+            for (size_t i = 0; i < frame_packets; ++i) {
+                uint8_t packet[ts::kPacketSize];
+                size_t payload_start = 4;
+                header(packet, kVideoPid, i == 0, i == 0);
+                if (i == 0) {
+                    // 适配域：随机访问标志 + PCR
+                    packet[4] = 7;
+                    packet[5] = static_cast<uint8_t>(0x10 | (key_frame ? 0x40 : 0x00));
+                    const uint64_t base = pcr / 300;
+                    const uint16_t extension = static_cast<uint16_t>(pcr % 300);
+                    packet[6] = static_cast<uint8_t>(base >> 25);
+                    packet[7] = static_cast<uint8_t>(base >> 17);
+                    packet[8] = static_cast<uint8_t>(base >> 9);
+                    packet[9] = static_cast<uint8_t>(base >> 1);
+                    packet[10] = static_cast<uint8_t>(((base & 0x01) << 7) | 0x7E | (extension >> 8));
+                    packet[11] = static_cast<uint8_t>(extension & 0xFF);
+                    payload_start = 12;
+                }
+                for (size_t j = payload_start; j < ts::kPacketSize; ++j) packet[j] = static_cast<uint8_t>(generator());
+                appendPacket(packet, now_ns);
+            }
+            flushBlock(now_ns);
+        }
+    }
+
+    void closeInput() override {}
+
+private:
+    double bitrate_bps = 8e6;
+    double fps = 25;
+    int gop = 12;
+    double iframe_ratio = 6;
+    double duration_s = 0;
+    std::mt19937 generator;
+};
+
+} // namespace
+
+std::unique_ptr<InputSource> InputSource::create(const QString& uri, size_t ingest_buffer_bytes) {
+    if (uri == "-" || uri == "stdin") {
+        return std::make_unique<PipeInputSource>(uri, QString(), ingest_buffer_bytes);
+    }
+    if (uri.startsWith("udp://")) {
+        // 兼容 udp://@239.1.1.1:1234 的写法
+        QString normalized = uri;
+        normalized.replace("udp://@", "udp://");
+        return std::make_unique<UdpInputSource>(normalized, ingest_buffer_bytes);
+    }
+    if (uri.startsWith("pipe://")) {
+        const QString name = uri.mid(7);
+#if defined(_WIN32)
+        return std::make_unique<PipeInputSource>(uri, QStringLiteral("\\\\.\\pipe\\") + name, ingest_buffer_bytes);
+#else
+        return std::make_unique<PipeInputSource>(uri, name, ingest_buffer_bytes);
+#endif
+    }
+    if (uri.startsWith("\\\\.\\pipe\\")) {
+        return std::make_unique<PipeInputSource>(uri, uri, ingest_buffer_bytes);
+    }
+    if (uri.startsWith("synthetic://")) {
+        return std::make_unique<SyntheticInputSource>(uri, ingest_buffer_bytes);
+    }
+    return std::make_unique<FileInputSource>(uri);
+}
@@ -0,0 +1,119 @@
+﻿#pragma once
+#include <QByteArray>
+#include <QMutex>
+#include <QString>
+#include <QWaitCondition>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "ChannelMetrics.h" // IngestSnapshot
+
+// 发送端的输入源：文件、UDP/组播 TS、命名管道/标准输入、合成 TS 流。
+// 直播源由各自的接收线程写入有界的 IngestBuffer，文件读取线程再从缓冲区取数据，
+// 输入突发时由缓冲区吸收，缓冲区满时丢弃最老的数据块并计数（直播宁可丢旧数据也不积压时延）。
+
+// 多个直播源共用的数据到达通知，读取线程在所有流都没有数据时等待它，而不是轮询休眠
+class IngestNotifier {
+public:
+    void notify();
+    // 等待 generation() 超过 seen 或超时，返回是否有新数据
+    bool wait(uint64_t seen, int timeout_ms);
+    uint64_t generation() const { return counter.load(std::memory_order_acquire); }
+
+private:
+    QMutex mutex;
+    QWaitCondition condition;
+    std::atomic<uint64_t> counter{ 0 };
+};
+
+// 输入统计，接收线程写、任意线程读
+struct IngestCounters {
+    std::atomic<uint64_t> bytes_in{ 0 };
+    std::atomic<uint64_t> blocks_in{ 0 };     // 写入的数据块（UDP 数据报、一次管道读取或一帧合成数据）
+    std::atomic<uint64_t> bytes_dropped{ 0 }; // 缓冲区满时丢弃的字节
+    std::atomic<uint64_t> blocks_dropped{ 0 };
+    std::atomic<uint64_t> buffered_bytes{ 0 };
+    std::atomic<uint64_t> peak_buffered_bytes{ 0 };
+};
+
+// 有界的数据块队列：一个写线程、一个读线程。每个块带进入发送端的时刻，用于统计输入到发出的时延。
+// 满时从队首丢弃整块：输入块都是整数个 TS 包（一个数据报通常为 7 x 188），丢块后 TS 仍然对齐；
+// 已被读走一部分的块被丢弃时由打包器重新同步。
+class IngestBuffer {
+public:
+    explicit IngestBuffer(size_t capacity_bytes);
+
+    void setNotifier(std::shared_ptr<IngestNotifier> notifier);
+    void push(const char* data, size_t len, int64_t ingest_ns);
+    // 取最多 max_len 字节（可跨多个块），等待最多 timeout_ms；返回字节数，0 表示暂时没有数据，
+    // -1 表示写端已结束且已读空。ingest_ns 为返回的第一个字节进入的时刻
+    qint64 pop(char* out, qint64 max_len, int timeout_ms, int64_t* ingest_ns);
+    // 复制开头最多 len 字节但不取走，等待最多 timeout_ms 直到攒够
+    QByteArray peek(int len, int timeout_ms);
+    // 写端结束（输入源关闭或管道对端退出）
+    void close();
+    bool hasData() const;
+    bool isClosed() const;
+
+    const IngestCounters& counters() const { return stats; }
+    size_t capacity() const { return capacity_bytes; }
+
+private:
+    struct Block {
+        std::vector<char> data;
+        size_t offset = 0; // 已被读走的字节数
+        int64_t ingest_ns = 0;
+    };
+
+    const size_t capacity_bytes;
+    mutable QMutex mutex;
+    QWaitCondition condition;
+    std::deque<Block> blocks;
+    std::vector<std::vector<char>> spare; // 读空的块缓冲，写入时复用
+    size_t buffered = 0;
+    bool closed = false;
+    IngestCounters stats;
+    std::shared_ptr<IngestNotifier> notifier;
+};
+
+class InputSource {
+public:
+    static constexpr size_t kDefaultIngestBufferBytes = 4 * 1024 * 1024;
+
+    // 按 uri 创建输入源：
+    //   文件路径                         按文件读取，读完即结束
+    //   udp://[@]地址:端口[?ifaddr=本机地址]  UDP 单播或组播（地址为组播地址时加入该组）TS 流
+    //   pipe://名称                      命名管道（Windows 为 \\.\pipe\名称，其他平台为 FIFO 路径），也可直接写管道路径
+    //   stdin 或 -                       标准输入
+    //   synthetic://[?bitrate=bps&fps=25&gop=12&iframe=6&duration=秒&seed=n]
+    //                                    合成 TS 流：按帧突发输出，I 帧大小为 P 帧的 iframe 倍，duration 为 0 时不结束
+    static std::unique_ptr<InputSource> create(const QString& uri, size_t ingest_buffer_bytes = kDefaultIngestBufferBytes);
+
+    virtual ~InputSource() = default;
+
+    virtual bool open(QString* error) = 0;
+    virtual void close() = 0;
+    // 读取最多 max_len 字节：返回 >0 为字节数，0 表示暂时没有数据（直播源），-1 表示输入已结束或出错。
+    // ingest_ns 为这些数据进入发送端的时刻（单调时钟，纳秒）
+    virtual qint64 read(char* out, qint64 max_len, int timeout_ms, int64_t* ingest_ns) = 0;
+    // 开头的数据（用于自动判断 TS 格式），不取走；直播源最多等待 timeout_ms
+    virtual QByteArray peek(int len, int timeout_ms) = 0;
+    // 现在读取是否能立即得到数据（或得到结束标志）
+    virtual bool hasData() const = 0;
+    virtual bool isLive() const = 0;
+    // 直播源的数据到达时通知 notifier，须在 open 之前设置
+    virtual void setNotifier(std::shared_ptr<IngestNotifier> notifier) { (void)notifier; }
+    virtual IngestSnapshot snapshot() const;
+
+    const QString& uri() const { return source_uri; }
+
+protected:
+    explicit InputSource(const QString& uri) : source_uri(uri) {}
+
+private:
+    QString source_uri;
+};
@@ -1,6 +1,7 @@
 // logemitter.cpp ( main.cpp, һ .cpp)
 #include "logemitter.h"
 #include <QDebug> // Ϊԭʼ qDebug  (Ҫ)
+#include "AsyncLogger.h"
 
 // ʼ LogEmitter 캯 (Ϊ)
 LogEmitter::LogEmitter(QObject* parent) : QObject(parent) {}
@@ -11,6 +12,13 @@ QtMessageHandler previousMessageHandler = nullptr;
 // ԶϢʵ
 void customMessageHandler(QtMsgType type, const QMessageLogContext& context, const QString& msg)
 {
+    // 첽־ʱֻӣɺ̨߳ͳһʱ̨͵棻
+    // ֮̾ͻȻͬ
+    if (type != QtFatalMsg && AsyncLogger::instance().isRunning()) {
+        AsyncLogger::instance().logText(type, msg);
+        return;
+    }
+
     QString formattedMessage;
     QTextStream stream(&formattedMessage);
 
@@ -0,0 +1,850 @@
+﻿#include "LoopbackHarness.h"
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTemporaryDir>
+#include <QThread>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <random>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+
+#include "ChannelMetrics.h"
+#include "Crc32.h"
+#include "DatagramFormat.h"
+#include "FecReceiver.h"
+#include "OneWayDelay.h"
+#include "PacketCapture.h"
+#include "ReceiverEngine.h"
+#include "Udpserver.h"
+
+namespace {
+
+int64_t steadyNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 进程累计 CPU 时间（用户态 + 内核态，纳秒），发送和接收都在本进程内
+int64_t processCpuNs() {
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) return 0;
+    auto toNs = [](const FILETIME& time) {
+        return ((static_cast<int64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 100;
+    };
+    return toNs(kernel) + toNs(user);
+}
+
+// 同进程内的接收端：由 ReceiverEngine 收包解码，这里只统计交付字节和恢复时延。
+// 多个分片时不同流的媒体回调在不同的反应器线程里，统计在锁内更新。
+class LoopbackReceiver {
+public:
+    LoopbackReceiver(const QString& bind_host, int base_port, bool nack, int shards)
+        : engine(engineConfig(bind_host, base_port, nack, shards)) {
+        engine.setMediaCallback([this](uint8_t stream_type, int64_t group_id, int, const uint8_t*, size_t len, bool recovered) {
+            onMedia(stream_type, group_id, len, recovered);
+        });
+        engine.setDatagramHook([](int channel, const char* data, size_t len) {
+            PacketCapture::capture(PacketCapture::Direction::Inbound, channel, data, len);
+        });
+    }
+
+    bool start() { return engine.start(); }
+    // 停止收包并结束所有在途的组，之后才能读取统计
+    void stop() { engine.stop(); }
+
+    FecReceiverStats stats() const { return engine.stats().decoder; }
+    FecReceiverStats streamStats(uint8_t stream_type) const { return engine.streamStats(stream_type); }
+    uint64_t mediaBytes() const { return media_bytes; }
+    uint64_t mediaBytes(uint8_t stream_type) const { return streams[stream_type].media_bytes; }
+    // 该流最后一个源包交付的时刻（单调时钟，纳秒），未收到时为 0
+    int64_t lastMediaNs(uint8_t stream_type) const { return streams[stream_type].last_media_ns; }
+    uint64_t datagramBytes() const { return engine.stats().bytes; }
+    // 解码最多的分片的耗时分布（每个流固定在一个分片上解码，流少于分片时有的分片不解码）
+    const LatencyHistogram& decodeLatency() const {
+        int busiest = 0;
+        uint64_t most = 0;
+        for (int shard = 0; shard < engine.shardCount(); ++shard) {
+            LatencyHistogram::Snapshot snapshot;
+            engine.decodeLatency(shard).snapshot(&snapshot);
+            if (snapshot.count > most) {
+                busiest = shard;
+                most = snapshot.count;
+            }
+        }
+        return engine.decodeLatency(busiest);
+    }
+    OneWayDelaySnapshot channelDelay(int channel) const { return engine.channelDelay(channel); }
+    const LatencyHistogram& recoveryDelay() const { return recovery_delay_ns; }
+    const LatencyHistogram& deliveryDelay() const { return delivery_delay_ns; }
+    NackStats nackStats() const { return engine.stats().nack; }
+
+private:
+    static constexpr int64_t kTrackedGroups = 4096; // 记录组首个源包到达时刻的组数
+
+    // 各流的组号独立编号，分别记录
+    struct StreamTrack {
+        uint64_t media_bytes = 0;
+        int64_t last_media_ns = 0;
+        std::map<int64_t, int64_t> group_first_ns;
+    };
+
+    ReceiverEngine engine;
+    std::mutex media_mutex;
+    uint64_t media_bytes = 0;
+    LatencyHistogram recovery_delay_ns; // 恢复出的源包比该组第一个源包晚多久交付
+    LatencyHistogram delivery_delay_ns; // 所有源包（收到、恢复或重传）比该组第一个源包晚多久交付
+    StreamTrack streams[256];
+
+    static ReceiverEngineConfig engineConfig(const QString& bind_host, int base_port, bool nack, int shards) {
+        ReceiverEngineConfig config;
+        config.bind_host = bind_host;
+        config.base_port = base_port;
+        config.channels = SOCKET_POOL_SIZE;
+        config.shards = shards;
+        config.nack = nack;
+        return config;
+    }
+
+    void onMedia(uint8_t stream_type, int64_t group_id, size_t len, bool recovered) {
+        std::lock_guard<std::mutex> lock(media_mutex);
+        media_bytes += len;
+        const int64_t now_ns = steadyNowNs();
+        StreamTrack& stream = streams[stream_type];
+        stream.media_bytes += len;
+        stream.last_media_ns = now_ns;
+        std::map<int64_t, int64_t>& group_first_ns = stream.group_first_ns;
+        auto inserted = group_first_ns.emplace(group_id, now_ns);
+        const uint64_t delay_ns = static_cast<uint64_t>(now_ns - inserted.first->second);
+        delivery_delay_ns.record(delay_ns);
+        if (recovered && !inserted.second) {
+            recovery_delay_ns.record(delay_ns);
+        }
+        while (!group_first_ns.empty() && group_first_ns.begin()->first < group_id - kTrackedGroups) {
+            group_first_ns.erase(group_first_ns.begin());
+        }
+    }
+};
+
+// 生成 bytes 字节的随机输入文件（按 Raw 格式切块发送）
+bool writeInputFile(const QString& path, qint64 bytes) {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+    std::mt19937 generator(12345);
+    QByteArray block(1 << 20, Qt::Uninitialized);
+    for (char& byte : block) byte = static_cast<char>(generator());
+    for (qint64 written = 0; written < bytes;) {
+        const qint64 chunk = std::min<qint64>(block.size(), bytes - written);
+        if (file.write(block.constData(), chunk) != chunk) return false;
+        written += chunk;
+    }
+    return true;
+}
+
+QJsonObject nackToJson(const NackStats& nack) {
+    QJsonObject object;
+    object["reports"] = static_cast<qint64>(nack.reports);
+    object["requests"] = static_cast<qint64>(nack.requests);
+    object["repaired"] = static_cast<qint64>(nack.repaired);
+    object["reordered"] = static_cast<qint64>(nack.reordered);
+    object["fec_repaired"] = static_cast<qint64>(nack.fec_repaired);
+    object["abandoned"] = static_cast<qint64>(nack.abandoned);
+    object["overflow"] = static_cast<qint64>(nack.overflow);
+    object["rtt_ms"] = nack.rtt_ms;
+    return object;
+}
+
+double maxP99Ms(const MetricsSnapshot& snapshot, LatencySummary ChannelMetricsSnapshot::* field) {
+    double p99_us = 0;
+    for (const ChannelMetricsSnapshot& channel : snapshot.channels) {
+        p99_us = std::max(p99_us, (channel.*field).p99_us);
+    }
+    return p99_us / 1000.0;
+}
+
+// 一级压测：按 offered_bps 限速发送 input_paths（多个时每个文件一个流，stream_type 和权重都是 1..N），返回本级结果
+QJsonObject runStep(const LoopbackHarness::Options& options, int k, int r, bool nack, double offered_bps, const QStringList& input_paths) {
+    QJsonObject step;
+    step["offered_mbps"] = offered_bps / 1e6;
+
+    LoopbackReceiver receiver(options.bind_host, options.base_port, nack, options.shards);
+    if (!receiver.start()) {
+        step["error"] = "receiver bind failed";
+        return step;
+    }
+
+    // Udpserver 停止时会关闭套接字，每一级都新建一个
+    Udpserver server(nullptr, options.dest_host, options.base_port);
+    server.setPayloadFormat(PayloadFormat::Raw);
+    server.setScheduleMode(ScheduleMode::RoundRobin);
+    server.setFecParameters(k, r);
+    server.setProtocolVersion(options.protocol_version);
+    server.setGroupDeadline(0);
+    server.setPacingRate(static_cast<qint64>(offered_bps));
+    server.setCongestionControl(options.congestion_control);
+    server.setRetransmission(nack);
+    server.setRepairBudget(options.repair_budget);
+    server.setQueueDeadline(options.deadline_ms);
+    server.setQueueOrdering(options.earliest_deadline ? QueueOrdering::EarliestDeadline : QueueOrdering::Fifo);
+    server.setQueueClassWeights(options.queue_weights);
+    if (options.congestion_control) {
+        const BweConfig defaults;
+        server.setBandwidthLimits(defaults.min_bps, static_cast<qint64>(offered_bps / SOCKET_POOL_SIZE), defaults.max_bps);
+    }
+    if (input_paths.size() == 1) {
+        server.SetFileName(input_paths.front());
+    }
+    else {
+        for (int i = 0; i < input_paths.size(); ++i) {
+            StreamConfig stream;
+            stream.stream_type = static_cast<uint8_t>(i + 1);
+            stream.source = input_paths[i];
+            stream.weight = i + 1;
+            server.addStream(stream);
+        }
+    }
+    for (int i = 0; i < SOCKET_POOL_SIZE; ++i) {
+        server.channelStateChange(i, true);
+        server.setLossRate(i, options.loss_rate);
+    }
+
+    const int64_t cpu_start_ns = processCpuNs();
+    const int64_t start_ns = steadyNowNs();
+    QElapsedTimer timer;
+    timer.start();
+    server.StartSending();
+    // 发送端跟不上限速时最多等待 4 倍的计划时长
+    const qint64 timeout_ms = static_cast<qint64>(options.step_seconds * 4000) + 5000;
+    bool timed_out = false;
+    bool channel_failed = false;
+    while (!server.sendingFinished()) {
+        if (timer.elapsed() > timeout_ms) {
+            timed_out = true;
+            break;
+        }
+        if (options.fail_channel >= 0 && !channel_failed && timer.elapsed() >= options.fail_after_seconds * 1000) {
+            server.channelStateChange(options.fail_channel, false);
+            channel_failed = true;
+        }
+        QThread::msleep(2);
+    }
+    const double send_seconds = timer.nsecsElapsed() / 1e9;
+    QThread::msleep(200); // 让工作线程发出最后几个包、接收端收完
+    const MetricsSnapshot snapshot = server.getMetricsSnapshot();
+    server.StopSending();
+    receiver.stop();
+    const double cpu_seconds = (processCpuNs() - cpu_start_ns) / 1e9;
+
+    uint64_t media_expected = 0;
+    uint64_t bytes_sent = 0;
+    uint64_t sendto_errors = 0;
+    uint64_t media_bytes_sent = 0;
+    uint64_t retransmitted_bytes = 0;
+    uint64_t packets_expired = 0;
+    for (const ChannelMetricsSnapshot& channel : snapshot.channels) {
+        media_expected += channel.media_packets;
+        bytes_sent += channel.bytes_sent;
+        sendto_errors += channel.sendto_errors;
+        media_bytes_sent += channel.media_bytes_sent;
+        retransmitted_bytes += channel.retransmitted_bytes;
+        packets_expired += channel.packets_expired;
+    }
+    const FecReceiverStats stats = receiver.stats();
+    const uint64_t media_delivered = stats.media_received + stats.media_recovered;
+    const double residual_loss = media_expected > 0
+        ? std::max(0.0, 1.0 - static_cast<double>(media_delivered) / media_expected) : 0.0;
+    const double send_mbps = bytes_sent * 8 / send_seconds / 1e6;
+    const double goodput_mbps = receiver.mediaBytes() * 8 / send_seconds / 1e6;
+    const double received_gbit = receiver.datagramBytes() * 8 / 1e9;
+
+    step["send_seconds"] = send_seconds;
+    step["send_mbps"] = send_mbps;
+    step["goodput_mbps"] = goodput_mbps;
+    step["cpu_seconds"] = cpu_seconds;
+    step["cpu_seconds_per_gbit"] = received_gbit > 0 ? cpu_seconds / received_gbit : 0.0;
+    step["media_expected"] = static_cast<qint64>(media_expected);
+    step["media_received"] = static_cast<qint64>(stats.media_received);
+    step["media_recovered"] = static_cast<qint64>(stats.media_recovered);
+    step["media_lost"] = static_cast<qint64>(stats.media_lost);
+    step["crc_errors"] = static_cast<qint64>(stats.crc_errors);
+    step["malformed"] = static_cast<qint64>(stats.malformed);
+    step["sendto_errors"] = static_cast<qint64>(sendto_errors);
+    step["packets_expired"] = static_cast<qint64>(packets_expired);
+    step["residual_loss"] = residual_loss;
+    // 带宽代价：发出的总字节（头、冗余包和重传）相对源数据负载的额外比例
+    step["overhead_ratio"] = media_bytes_sent > 0 ? static_cast<double>(bytes_sent) / media_bytes_sent - 1.0 : 0.0;
+    step["retransmitted_share"] = bytes_sent > 0 ? static_cast<double>(retransmitted_bytes) / bytes_sent : 0.0;
+    if (nack) {
+        step["retransmission"] = metrics::retransmissionToJson(snapshot.retransmission);
+        step["nack"] = nackToJson(receiver.nackStats());
+    }
+    if (input_paths.size() > 1) {
+        // 各流按权重分配的文件大小发送：加权公平时各流应大致同时发完，交付量之比等于权重之比
+        QJsonArray streams;
+        for (int i = 0; i < input_paths.size(); ++i) {
+            const uint8_t stream_type = static_cast<uint8_t>(i + 1);
+            const FecReceiverStats stream_stats = receiver.streamStats(stream_type);
+            QJsonObject stream;
+            stream["stream_type"] = i + 1;
+            stream["weight"] = i + 1;
+            stream["media_bytes"] = static_cast<qint64>(receiver.mediaBytes(stream_type));
+            stream["media_share"] = receiver.mediaBytes() > 0
+                ? static_cast<double>(receiver.mediaBytes(stream_type)) / receiver.mediaBytes() : 0.0;
+            stream["media_lost"] = static_cast<qint64>(stream_stats.media_lost);
+            stream["finish_seconds"] = receiver.lastMediaNs(stream_type) > 0
+                ? (receiver.lastMediaNs(stream_type) - start_ns) / 1e9 : 0.0;
+            streams.append(stream);
+        }
+        step["streams"] = streams;
+    }
+
+    // 各阶段时延：发送端排队、sendto（取最差的通道），接收端解码和恢复等待
+    QJsonObject latency;
+    QJsonArray queue_wait;
+    QJsonArray send_latency;
+    for (const ChannelMetricsSnapshot& channel : snapshot.channels) {
+        queue_wait.append(metrics::latencyToJson(channel.queue_wait));
+        send_latency.append(metrics::latencyToJson(channel.send_latency));
+    }
+    latency["queue_wait"] = queue_wait;
+    latency["sendto"] = send_latency;
+    // 各优先级类别排队时延的 p99（取最差的通道）
+    QJsonObject class_wait;
+    for (int i = 0; i < kQueueClassCount; ++i) {
+        double p99_us = 0;
+        for (const ChannelMetricsSnapshot& channel : snapshot.channels) {
+            p99_us = std::max(p99_us, channel.class_wait[i].p99_us);
+        }
+        class_wait[queueClassName(static_cast<QueueClass>(i))] = p99_us / 1000.0;
+    }
+    latency["queue_wait_p99_ms_by_class"] = class_wait;
+    const LatencySummary decode = metrics::summarize(receiver.decodeLatency());
+    const LatencySummary recovery = metrics::summarize(receiver.recoveryDelay());
+    latency["decode"] = metrics::latencyToJson(decode);
+    latency["recovery_delay"] = metrics::latencyToJson(recovery);
+    latency["delivery_delay"] = metrics::latencyToJson(metrics::summarize(receiver.deliveryDelay()));
+    step["latency"] = latency;
+
+    // 各通道单向时延（回环上时钟偏差即两端的同一时钟，应接近 0）
+    QJsonArray delays;
+    for (int channel = 0; channel < SOCKET_POOL_SIZE; ++channel) {
+        const OneWayDelaySnapshot delay = receiver.channelDelay(channel);
+        if (delay.samples > 0) delays.append(metrics::delayToJson(delay));
+    }
+    step["one_way_delay"] = delays;
+    if (channel_failed) {
+        const ChannelMetricsSnapshot& failed = snapshot.channels[static_cast<size_t>(options.fail_channel)];
+        QJsonObject failover;
+        failover["channel"] = options.fail_channel;
+        failover["packets_rescued"] = static_cast<qint64>(failed.packets_rescued);
+        failover["failover_time"] = metrics::latencyToJson(failed.failover_time);
+        step["failover"] = failover;
+    }
+    if (options.congestion_control) {
+        QJsonArray estimates;
+        for (const ChannelMetricsSnapshot& channel : snapshot.channels) {
+            QJsonObject estimate = metrics::bweToJson(channel.bwe);
+            estimate["channel"] = channel.channel;
+            estimates.append(estimate);
+        }
+        step["bwe"] = estimates;
+    }
+
+    // 判断是否越过阈值
+    const double worst_p99_ms = std::max({ maxP99Ms(snapshot, &ChannelMetricsSnapshot::queue_wait),
+        maxP99Ms(snapshot, &ChannelMetricsSnapshot::send_latency), decode.p99_us / 1000.0, recovery.p99_us / 1000.0 });
+    QString breach;
+    if (timed_out || send_mbps < offered_bps / 1e6 * options.min_rate_ratio) {
+        breach = "sender_limited";
+    }
+    else if (residual_loss > options.max_residual_loss) {
+        breach = "loss";
+    }
+    else if (worst_p99_ms > options.max_latency_ms) {
+        breach = "latency";
+    }
+    step["worst_p99_ms"] = worst_p99_ms;
+    if (!breach.isEmpty()) step["breach"] = breach;
+    return step;
+}
+
+// ---- 自检场景：每个场景返回失败原因，通过时返回空串 ----
+
+constexpr double kSelfTestBps = 20e6;
+
+// 没有模拟丢包时，所有源包都应直接收到，不应有 CRC 错误或格式错误
+QString checkLossless(const QJsonObject& step) {
+    if (step.contains("error")) return step["error"].toString();
+    if (step["crc_errors"].toInt() > 0 || step["malformed"].toInt() > 0) {
+        return QString("%1 crc errors, %2 malformed").arg(step["crc_errors"].toInt()).arg(step["malformed"].toInt());
+    }
+    if (step["media_expected"].toInt() == 0 || step["media_received"].toInt() != step["media_expected"].toInt()) {
+        return QString("received %1 of %2 media packets").arg(step["media_received"].toInt()).arg(step["media_expected"].toInt());
+    }
+    return QString();
+}
+
+// 文件长度不是读取块大小的整数倍，最后一个源包负载较短：v1 和 v2 的数据报都应按实际长度发送
+QString testShortFinalPayload(const LoopbackHarness::Options& base, const QString& directory) {
+    const QString path = QDir(directory).filePath("short_final.bin");
+    if (!writeInputFile(path, (64 << 10) + 1)) return "failed to write input file";
+    for (int protocol_version : { 1, 2 }) {
+        LoopbackHarness::Options options = base;
+        options.protocol_version = protocol_version;
+        options.loss_rate = 0;
+        const QString failure = checkLossless(runStep(options, 10, 2, false, kSelfTestBps, { path }));
+        if (!failure.isEmpty()) return QString("protocol v%1: %2").arg(protocol_version).arg(failure);
+    }
+    return QString();
+}
+
+// 编解码自检用的一个流：源包经 ForwardErrorCorrection 编码后直接交给 FecReceiver，每组丢掉序号为 1 的源包。
+// 与发送路径一致，编码时试飞院头的发送时刻和通道号是占位值 0，送入接收端的源包再填上时间戳。
+// 交付的源包（收到或恢复）都应与原包一致，恢复出的包在原长度之后只能是补零
+class CodecStream {
+public:
+    CodecStream() {
+        receiver.setMediaCallback([this](int64_t group_id, int sequence_number, const uint8_t* data, size_t len, bool recovered) {
+            // 时间戳单独检查，其余字节与原包比较
+            std::vector<uint8_t> payload(data, data + len);
+            flight_header::clearStamp(payload.data(), payload.size());
+            const auto it = sent.find(group_id * 256 + sequence_number);
+            const bool intact = it != sent.end() && len >= it->second.size()
+                && memcmp(payload.data(), it->second.data(), it->second.size()) == 0
+                && std::all_of(payload.begin() + it->second.size(), payload.end(), [](uint8_t byte) { return byte == 0; });
+            if (intact) {
+                ++delivered;
+            }
+            else {
+                ++corrupted;
+            }
+            if (recovered) {
+                ++recovered_count;
+                if (payload != std::vector<uint8_t>(data, data + len)) ++stale_stamps;
+            }
+        });
+    }
+
+    void send(std::vector<char> payload, int k, int r) {
+        flight_header::clearStamp(reinterpret_cast<uint8_t*>(payload.data()), payload.size());
+        char buffer[ForwardErrorCorrection::Packet::kMaxDataSize] = {};
+        memcpy(buffer, payload.data(), payload.size());
+        encoder.PacketByFEC(buffer, static_cast<int>(payload.size()), k, r);
+        drain(&payload);
+    }
+
+    // 结束最后一组，所有源包都应完好地交付一次，返回失败原因
+    QString finish() {
+        encoder.Flush();
+        drain(nullptr);
+        receiver.flush();
+        if (corrupted > 0 || delivered != sent.size()) {
+            return QString("%1 of %2 media packets delivered intact, %3 corrupted").arg(delivered).arg(sent.size()).arg(corrupted);
+        }
+        if (stale_stamps > 0) {
+            return QString("%1 of %2 recovered media packets carry a send time or channel").arg(stale_stamps).arg(recovered_count);
+        }
+        return QString();
+    }
+
+    size_t recoveredCount() const { return recovered_count; }
+
+private:
+    ForwardErrorCorrection encoder;
+    FecReceiver receiver;
+    std::map<int64_t, std::vector<char>> sent; // 组号 * 256 + 组内序号 -> 原包（时间戳为占位值）
+    size_t delivered = 0;
+    size_t corrupted = 0;
+    size_t recovered_count = 0;
+    size_t stale_stamps = 0; // 恢复出的源包里发送时刻或通道号不是占位值
+    uint32_t last_send_us = 0; // 送入接收端的源包依次填写的发送时刻
+
+    // 取走编码器的输出，其中的源包就是 payload（Flush 只产出冗余包，传 nullptr）。
+    // 与发送线程一致：每个包按自己的长度发送（冗余包为组内最长源包的长度）
+    void drain(const std::vector<char>* payload) {
+        while (!encoder.buffer_packets.empty()) {
+            const ForwardErrorCorrection::Packet& packet = *encoder.buffer_packets.front();
+            const bool is_media = packet.sequence_number < packet.k;
+            if (is_media) {
+                sent[static_cast<int64_t>(packet.group_number) * 256 + packet.sequence_number] = *payload;
+            }
+            if (!is_media) {
+                receiver.insert(packet, packet.length, ForwardErrorCorrection::Packet::kProtocolV2, 0);
+            }
+            else if (packet.sequence_number != 1) {
+                // 发送线程只改序列化后的副本，编码器里的源包仍是占位值
+                ForwardErrorCorrection::Packet stamped = packet;
+                flight_header::stamp(reinterpret_cast<char*>(stamped.data), stamped.length, ++last_send_us,
+                    static_cast<uint8_t>(1 + last_send_us % SOCKET_POOL_SIZE));
+                receiver.insert(stamped, stamped.length, ForwardErrorCorrection::Packet::kProtocolV2, 0);
+            }
+            encoder.buffer_packets.pop_front();
+        }
+    }
+};
+
+// 两个流的源包长度不同，交替送入各自的 FEC 编码器，各流都应按自己的包长编码和生成冗余包
+// （包长曾是所有编码器共用的静态变量，后开始的短包流会把长包流截断）
+QString testStreamPacketSizes(const LoopbackHarness::Options&, const QString&) {
+    const size_t sizes[] = { 1300, 200 };
+    CodecStream streams[2];
+    std::mt19937 generator(12345);
+    for (int i = 0; i < 40; ++i) {
+        for (int s = 0; s < 2; ++s) {
+            std::vector<char> payload(sizes[s]);
+            for (char& byte : payload) byte = static_cast<char>(generator());
+            streams[s].send(payload, 4, 1);
+        }
+    }
+    for (int s = 0; s < 2; ++s) {
+        const QString failure = streams[s].finish();
+        if (!failure.isEmpty()) return QString("stream %1 (%2 bytes): %3").arg(s + 1).arg(sizes[s]).arg(failure);
+    }
+    return QString();
+}
+
+// 直播源的短读：流的第一个块和之后零星的块都不足一整块，同一组里的源包长度不同，
+// 每个源包都应完整发送，冗余包按组内最长的包生成
+QString testShortReads(const LoopbackHarness::Options&, const QString&) {
+    CodecStream stream;
+    std::mt19937 generator(12345);
+    for (int i = 0; i < 200; ++i) {
+        const size_t size = (i == 0 || i % 7 == 3) ? 40 + generator() % 900 : 1045;
+        std::vector<char> payload(size);
+        for (char& byte : payload) byte = static_cast<char>(generator());
+        stream.send(payload, 10, 2);
+    }
+    return stream.finish();
+}
+
+// 发送线程在源包的试飞院头里填写发送时刻和通道号，冗余包按占位值 0 生成：恢复出的源包这两个字段应是
+// 占位值 0（曾是其他源包时间戳的异或，当作发送时刻和通道号交给应用）
+QString testRecoveredStamp(const LoopbackHarness::Options&, const QString&) {
+    CodecStream stream;
+    std::mt19937 generator(12345);
+    for (int i = 0; i < 40; ++i) {
+        std::vector<char> payload(1000);
+        for (char& byte : payload) byte = static_cast<char>(generator());
+        stream.send(payload, 4, 1);
+    }
+    const QString failure = stream.finish();
+    if (!failure.isEmpty()) return failure;
+    if (stream.recoveredCount() == 0) return "no media packet was recovered";
+    return QString();
+}
+
+// 接收端两个分片，两个流的数据报轮流走各个通道（通道按通道号分给两个分片收取），每组丢掉序号为 1 的源包：
+// 每个流的组都应在同一个分片里解码，丢掉的源包全部恢复
+// （曾按收到的通道解码，一组被拆到两个分片的解码器里，哪个都凑不齐 k 个包）
+QString testShardsRecoverLoss(const LoopbackHarness::Options& options, const QString&) {
+    constexpr int kStreams = 2;
+    constexpr int kPackets = 60; // 每个流的源包数，k = 10 时正好 6 组
+    ReceiverEngineConfig config;
+    config.bind_host = options.bind_host;
+    config.base_port = options.base_port;
+    config.channels = SOCKET_POOL_SIZE;
+    config.shards = 2;
+    config.feedback_interval_ms = 0;
+    ReceiverEngine engine(config);
+    std::mutex mutex;
+    uint64_t delivered = 0;
+    uint64_t recovered = 0;
+    engine.setMediaCallback([&](uint8_t, int64_t, int, const uint8_t*, size_t, bool was_recovered) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++delivered;
+        if (was_recovered) ++recovered;
+    });
+    if (!engine.start()) return "receiver bind failed";
+
+    SOCKET sender = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    sockaddr_in destination;
+    memset(&destination, 0, sizeof(destination));
+    destination.sin_family = AF_INET;
+    inet_pton(AF_INET, options.dest_host.toStdString().c_str(), &destination.sin_addr);
+    ForwardErrorCorrection encoders[kStreams];
+    std::mt19937 generator(12345);
+    uint32_t seq = 0;
+    uint64_t dropped = 0;
+    char datagram_buffer[ForwardErrorCorrection::Packet::kMaxHeaderSize + ForwardErrorCorrection::Packet::kMaxDataSize
+        + datagram::kTrailerSizeV2];
+    auto sendOutput = [&](int s) {
+        ForwardErrorCorrection& encoder = encoders[s];
+        while (!encoder.buffer_packets.empty()) {
+            const ForwardErrorCorrection::Packet& packet = *encoder.buffer_packets.front();
+            const int channel = static_cast<int>(seq % SOCKET_POOL_SIZE);
+            if (packet.sequence_number == 1) {
+                ++dropped;
+            }
+            else {
+                const size_t size = packet.Serialize(datagram_buffer, sizeof(datagram_buffer), packet.length,
+                    ForwardErrorCorrection::Packet::kProtocolV2);
+                datagram::Trailer trailer;
+                trailer.crc32 = crc::crc32c(datagram_buffer, size);
+                trailer.stream_type = static_cast<uint8_t>(s + 1);
+                trailer.channel_index = static_cast<uint8_t>(channel);
+                trailer.seq = seq;
+                const size_t length = size + datagram::writeTrailer(datagram_buffer + size, trailer, ForwardErrorCorrection::Packet::kProtocolV2);
+                destination.sin_port = htons(static_cast<uint16_t>(options.base_port + channel));
+                sendto(sender, datagram_buffer, static_cast<int>(length), 0, reinterpret_cast<const sockaddr*>(&destination), sizeof(destination));
+            }
+            ++seq;
+            encoder.buffer_packets.pop_front();
+        }
+    };
+    for (int i = 0; i < kPackets; ++i) {
+        for (int s = 0; s < kStreams; ++s) {
+            char payload[1000];
+            for (char& byte : payload) byte = static_cast<char>(generator());
+            encoders[s].PacketByFEC(payload, static_cast<int>(sizeof(payload)), 10, 2);
+            sendOutput(s);
+        }
+    }
+    for (int s = 0; s < kStreams; ++s) {
+        encoders[s].Flush();
+        sendOutput(s);
+    }
+    closesocket(sender);
+    QThread::msleep(200); // 让接收端收完
+    engine.stop();
+
+    // 分片之间转交会改变到达顺序，冗余包先到时组会提前恢复，迟到的源包作为重复包丢弃，恢复数可以多于丢弃数
+    const uint64_t expected = static_cast<uint64_t>(kStreams) * kPackets;
+    if (delivered != expected || recovered < dropped) {
+        return QString("delivered %1 of %2 media packets, %3 recovered for %4 dropped")
+            .arg(delivered).arg(expected).arg(recovered).arg(dropped);
+    }
+    return QString();
+}
+
+struct SelfTest {
+    const char* name;
+    QString (*run)(const LoopbackHarness::Options& options, const QString& directory);
+};
+
+const SelfTest kSelfTests[] = {
+    { "short_final_payload", testShortFinalPayload },
+    { "stream_packet_sizes", testStreamPacketSizes },
+    { "short_reads", testShortReads },
+    { "recovered_stamp", testRecoveredStamp },
+    { "shards_recover_loss", testShardsRecoverLoss },
+};
+
+} // namespace
+
+namespace LoopbackHarness {
+
+QJsonObject runFecConfig(const Options& options, int k, int r, bool nack) {
+    QJsonObject result;
+    result["k"] = k;
+    result["r"] = r;
+    result["repair"] = nack ? "fec+nack" : "fec";
+    QTemporaryDir directory;
+    QStringList input_paths;
+    for (int i = 0; i < std::max(1, options.streams); ++i) {
+        input_paths.append(directory.filePath(QString("loopback_input_%1.bin").arg(i + 1)));
+    }
+    const int weight_sum = input_paths.size() * (input_paths.size() + 1) / 2;
+
+    QJsonArray steps;
+    QJsonObject best;
+    for (double offered_mbps = options.start_mbps; offered_mbps <= options.max_mbps; offered_mbps *= options.step_factor) {
+        // 输入文件按限速和计划时长确定大小，文件发完即本级结束
+        const qint64 bytes = std::max<qint64>(1 << 20, std::min<qint64>(
+            static_cast<qint64>(offered_mbps * 1e6 / 8 * options.step_seconds), qint64(512) << 20));
+        // 多个流时按权重（1..N）分配
+        bool written = true;
+        for (int i = 0; i < input_paths.size() && written; ++i) {
+            written = writeInputFile(input_paths[i], std::max<qint64>(64 << 10, bytes * (i + 1) / weight_sum));
+        }
+        if (!written) {
+            result["error"] = "failed to write input file";
+            break;
+        }
+        const QJsonObject step = runStep(options, k, r, nack, offered_mbps * 1e6, input_paths);
+        steps.append(step);
+        fprintf(stderr, "k=%d r=%d%s offered=%.0f Mbps goodput=%.1f Mbps loss=%.2e overhead=%.3f p99=%.2f ms %s\n", k, r,
+            nack ? " +nack" : "", offered_mbps, step["goodput_mbps"].toDouble(), step["residual_loss"].toDouble(),
+            step["overhead_ratio"].toDouble(), step["worst_p99_ms"].toDouble(), qPrintable(step["breach"].toString()));
+        if (step.contains("error") || step.contains("breach")) break;
+        best = step;
+    }
+    result["steps"] = steps;
+    result["max_goodput_mbps"] = best.isEmpty() ? 0.0 : best["goodput_mbps"].toDouble();
+    result["cpu_seconds_per_gbit_at_max"] = best.isEmpty() ? 0.0 : best["cpu_seconds_per_gbit"].toDouble();
+    result["residual_loss_at_max"] = best.isEmpty() ? 0.0 : best["residual_loss"].toDouble();
+    result["overhead_ratio_at_max"] = best.isEmpty() ? 0.0 : best["overhead_ratio"].toDouble();
+    result["delivery_p99_ms_at_max"] = best.isEmpty() ? 0.0
+        : best["latency"].toObject()["delivery_delay"].toObject()["p99_us"].toDouble() / 1000.0;
+    return result;
+}
+
+bool runSelfTests(const Options& options) {
+    QTemporaryDir directory;
+    int failed = 0;
+    for (const SelfTest& test : kSelfTests) {
+        const QString failure = test.run(options, directory.path());
+        fprintf(stderr, "%-24s %s%s\n", test.name, failure.isEmpty() ? "PASS" : "FAIL: ", qPrintable(failure));
+        if (!failure.isEmpty()) ++failed;
+    }
+    fprintf(stderr, "%d of %d self tests passed\n", static_cast<int>(std::size(kSelfTests)) - failed,
+        static_cast<int>(std::size(kSelfTests)));
+    return failed == 0;
+}
+
+int runFromCommandLine(const QStringList& arguments) {
+    auto valueOf = [&arguments](const QString& name) {
+        const int index = arguments.indexOf(name);
+        return index >= 0 && index + 1 < arguments.size() ? arguments[index + 1] : QString();
+    };
+    Options options;
+    if (!valueOf("--host").isEmpty()) options.dest_host = valueOf("--host");
+    if (!valueOf("--bind").isEmpty()) options.bind_host = valueOf("--bind");
+    if (!valueOf("--port").isEmpty()) options.base_port = valueOf("--port").toInt();
+    if (!valueOf("--protocol").isEmpty()) options.protocol_version = valueOf("--protocol").toInt();
+    if (!valueOf("--start-mbps").isEmpty()) options.start_mbps = valueOf("--start-mbps").toDouble();
+    if (!valueOf("--max-mbps").isEmpty()) options.max_mbps = valueOf("--max-mbps").toDouble();
+    if (!valueOf("--step-seconds").isEmpty()) options.step_seconds = valueOf("--step-seconds").toDouble();
+    if (!valueOf("--max-loss").isEmpty()) options.max_residual_loss = valueOf("--max-loss").toDouble();
+    if (!valueOf("--max-latency-ms").isEmpty()) options.max_latency_ms = valueOf("--max-latency-ms").toDouble();
+    if (!valueOf("--streams").isEmpty()) options.streams = std::max(1, std::min(valueOf("--streams").toInt(), 255));
+    if (!valueOf("--shards").isEmpty()) options.shards = std::max(1, valueOf("--shards").toInt());
+    options.congestion_control = arguments.contains("--cc");
+    if (!valueOf("--loss").isEmpty()) options.loss_rate = std::max(0.0, std::min(valueOf("--loss").toDouble(), 1.0));
+    options.nack = arguments.contains("--nack");
+    if (!valueOf("--repair-budget").isEmpty()) options.repair_budget = valueOf("--repair-budget").toDouble();
+    if (!valueOf("--fail-channel").isEmpty()) options.fail_channel = valueOf("--fail-channel").toInt();
+    if (!valueOf("--fail-after").isEmpty()) options.fail_after_seconds = valueOf("--fail-after").toDouble();
+    if (!valueOf("--deadline-ms").isEmpty()) options.deadline_ms = std::max(0, valueOf("--deadline-ms").toInt());
+    options.earliest_deadline = arguments.contains("--edf");
+    // --queue-weights critical,retransmit,media,parity
+    if (!valueOf("--queue-weights").isEmpty()) {
+        const QStringList weights = valueOf("--queue-weights").split(',');
+        if (weights.size() != kQueueClassCount) {
+            fprintf(stderr, "--queue-weights expects %d comma-separated weights (critical,retransmit,media,parity)\n", kQueueClassCount);
+            return 1;
+        }
+        for (int i = 0; i < kQueueClassCount; ++i) {
+            options.queue_weights.weight[i] = std::max(0, weights[i].toInt());
+        }
+    }
+    // --fec k:r[,k:r...]
+    if (!valueOf("--fec").isEmpty()) {
+        options.fec_configs.clear();
+        for (const QString& config : valueOf("--fec").split(',', Qt::SkipEmptyParts)) {
+            const QStringList parts = config.split(':');
+            if (parts.size() != 2) {
+                fprintf(stderr, "Invalid --fec entry '%s', expected k:r\n", qPrintable(config));
+                return 1;
+            }
+            options.fec_configs.append({ parts[0].toInt(), parts[1].toInt() });
+        }
+    }
+    if (options.start_mbps <= 0) {
+        fprintf(stderr, "--start-mbps must be positive\n");
+        return 1;
+    }
+    if (options.fail_channel >= SOCKET_POOL_SIZE) {
+        fprintf(stderr, "--fail-channel must be below %d\n", SOCKET_POOL_SIZE);
+        return 1;
+    }
+    if (options.nack && options.protocol_version < 2) {
+        fprintf(stderr, "--nack needs --protocol 2 (32-bit sequence numbers)\n");
+        return 1;
+    }
+    if (options.nack && options.shards > 1) {
+        fprintf(stderr, "--nack needs --shards 1 (gaps in the global sequence are only visible to a single shard)\n");
+        return 1;
+    }
+
+    // 接收端套接字在 Udpserver 之外单独初始化 Winsock（引用计数，Udpserver 停止时的 WSACleanup 不影响这里）
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        fprintf(stderr, "WSAStartup failed\n");
+        return 1;
+    }
+    if (arguments.contains("--selftest")) {
+        const bool passed = runSelfTests(options);
+        WSACleanup();
+        return passed ? 0 : 1;
+    }
+    QJsonArray results;
+    QJsonArray tradeoffs;
+    for (const QPair<int, int>& config : options.fec_configs) {
+        const QJsonObject fec = runFecConfig(options, config.first, config.second);
+        results.append(fec);
+        if (!options.nack) continue;
+        // 同一个 FEC 配置加上重传：比较最大可持续吞吐下的带宽代价、残余丢包和交付时延
+        const QJsonObject hybrid = runFecConfig(options, config.first, config.second, true);
+        results.append(hybrid);
+        QJsonObject tradeoff;
+        tradeoff["k"] = config.first;
+        tradeoff["r"] = config.second;
+        for (const char* field : { "max_goodput_mbps", "overhead_ratio_at_max", "residual_loss_at_max", "delivery_p99_ms_at_max" }) {
+            QJsonObject pair;
+            pair["fec"] = fec[field];
+            pair["fec+nack"] = hybrid[field];
+            tradeoff[field] = pair;
+        }
+        tradeoffs.append(tradeoff);
+        fprintf(stderr, "k=%d r=%d fec vs fec+nack: goodput %.1f / %.1f Mbps, overhead %.3f / %.3f, loss %.2e / %.2e, delivery p99 %.2f / %.2f ms\n",
+            config.first, config.second, fec["max_goodput_mbps"].toDouble(), hybrid["max_goodput_mbps"].toDouble(),
+            fec["overhead_ratio_at_max"].toDouble(), hybrid["overhead_ratio_at_max"].toDouble(),
+            fec["residual_loss_at_max"].toDouble(), hybrid["residual_loss_at_max"].toDouble(),
+            fec["delivery_p99_ms_at_max"].toDouble(), hybrid["delivery_p99_ms_at_max"].toDouble());
+    }
+    WSACleanup();
+
+    QJsonObject root;
+    root["harness"] = "loopback";
+    root["dest_host"] = options.dest_host;
+    root["bind_host"] = options.bind_host;
+    root["protocol_version"] = options.protocol_version;
+    root["streams"] = options.streams;
+    root["shards"] = options.shards;
+    root["congestion_control"] = options.congestion_control;
+    root["loss_rate"] = options.loss_rate;
+    root["nack"] = options.nack;
+    root["fail_channel"] = options.fail_channel;
+    root["deadline_ms"] = options.deadline_ms;
+    root["earliest_deadline"] = options.earliest_deadline;
+    QJsonObject queue_weights;
+    for (int i = 0; i < kQueueClassCount; ++i) {
+        queue_weights[queueClassName(static_cast<QueueClass>(i))] = options.queue_weights.weight[i];
+    }
+    root["queue_weights"] = queue_weights;
+    if (options.nack) {
+        root["repair_budget"] = options.repair_budget;
+        root["tradeoff"] = tradeoffs;
+    }
+
+    root["max_residual_loss"] = options.max_residual_loss;
+    root["max_latency_ms"] = options.max_latency_ms;
+    root["hardware_threads"] = QThread::idealThreadCount();
+    root["results"] = results;
+    const QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Indented);
+
+    const QString out_path = valueOf("--out");
+    if (out_path.isEmpty()) {
+        fwrite(json.constData(), 1, static_cast<size_t>(json.size()), stdout);
+        return 0;
+    }
+    QFile file(out_path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        fprintf(stderr, "Failed to open %s for writing\n", qPrintable(out_path));
+        return 1;
+    }
+    file.write(json);
+    fprintf(stderr, "Results written to %s\n", qPrintable(out_path));
+    return 0;
+}
+
+} // namespace LoopbackHarness
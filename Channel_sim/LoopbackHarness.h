@@ -0,0 +1,51 @@
+﻿#pragma once
+#include <QJsonObject>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "SendQueue.h"
+
+// 本机端到端压测：Udpserver 发送 → 回环（或 veth 对）→ 同进程内的接收端 FecReceiver 解码。
+// 逐级提高限速直到残余丢包或时延超过阈值，报告每个 FEC 配置的最大可持续吞吐。
+// 命令行调用：Channel_sim.exe --loopback [--out result.json] [--fec 10:2,24:4] [选项见 runFromCommandLine]
+//             Channel_sim.exe --loopback --selftest：只跑几个固定的自检场景（编解码和回环）并检查交付结果，失败时退出码非 0
+namespace LoopbackHarness {
+
+struct Options {
+    QString dest_host = "127.0.0.1"; // 发送目的地址
+    QString bind_host = "127.0.0.1"; // 接收端绑定地址，veth 对时为对端地址
+    int base_port = 21000;           // 通道 i 使用 base_port + i
+    QVector<QPair<int, int>> fec_configs{ { 10, 2 }, { 24, 4 }, { 48, 8 } };
+    int protocol_version = 2;
+    double start_mbps = 20;          // 第一级限速
+    double max_mbps = 4000;          // 最高限速
+    double step_factor = 1.5;        // 每级限速的倍数
+    double step_seconds = 2;         // 每级按限速发送约这么长时间的数据
+    double max_residual_loss = 1e-4; // 解码后残余丢包率上限
+    double max_latency_ms = 50;      // 各阶段 p99 时延上限
+    double min_rate_ratio = 0.9;     // 实际发送速率低于限速的这个比例时认为发送端已到瓶颈
+    int streams = 1;                 // >1 时同时发送多个流（stream_type 1..N，权重 1..N），输入数据按权重分配
+    int shards = 1;                  // 接收端的反应器分片数，各流按 stream_type 分到各分片解码
+    bool congestion_control = false; // 开启逐通道拥塞控制（估计初值为限速的 1/通道数），每级结果带各通道的带宽估计
+    double loss_rate = 0;            // 各通道的模拟丢包率
+    bool nack = false;               // 每个 FEC 配置分别以纯 FEC 和 FEC + 重传运行，报告两者的带宽和时延对比
+    double repair_budget = 0.3;      // 重传模式下冗余和重传共用的预算（相对源包字节数）
+    int fail_channel = -1;           // 每级发送 fail_after_seconds 后禁用这个通道，报告故障切换时间和迁走的包数
+    double fail_after_seconds = 0.5;
+    int deadline_ms = 0;             // 通道队列的截止时长，0 表示不限；每级结果带过期丢弃的包数
+    bool earliest_deadline = false;  // 各流之间按截止时刻先后出队
+    QueueClassWeights queue_weights; // 通道队列各类别的轮询权重，每级结果带各类别的排队时延
+};
+
+// 对一个 FEC 配置逐级加压，返回各级结果和最大可持续吞吐；nack 为 true 时同时开启重传
+QJsonObject runFecConfig(const Options& options, int k, int r, bool nack = false);
+
+// 依次运行回环自检场景，逐个打印结果，全部通过时返回 true
+bool runSelfTests(const Options& options);
+
+// 解析命令行并运行，返回进程退出码
+int runFromCommandLine(const QStringList& arguments);
+
+} // namespace LoopbackHarness
@@ -0,0 +1,139 @@
+﻿#include "MetricsPlotWidget.h"
+#include <QPainter>
+#include <QPainterPath>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+struct SeriesStyle {
+    const char16_t* title; // UTF-16 字面量，与执行字符集无关
+    const char16_t* unit;
+    double fixed_max; // 大于0时纵轴固定，否则按数据自动缩放
+};
+
+const SeriesStyle kSeriesStyles[] = {
+    { u"有效吞吐", u"Mbps", 0.0 },
+    { u"丢包率", u"%", 100.0 },
+    { u"队列深度", u"包", 0.0 },
+    { u"FEC可恢复率", u"%", 100.0 },
+};
+
+const QColor kChannelColors[] = { QColor(31, 119, 180), QColor(255, 127, 14), QColor(44, 160, 44),
+    QColor(214, 39, 40), QColor(148, 103, 189), QColor(140, 86, 75) };
+
+// 自动缩放时把最大值取整到 1/2/5 x 10^n，避免刻度频繁跳动
+double niceCeiling(double value) {
+    if (value <= 0) return 1.0;
+    const double magnitude = std::pow(10.0, std::floor(std::log10(value)));
+    for (double step : { 1.0, 2.0, 5.0, 10.0 }) {
+        if (value <= step * magnitude) return step * magnitude;
+    }
+    return 10.0 * magnitude;
+}
+
+} // namespace
+
+MetricsPlotWidget::MetricsPlotWidget(QWidget* parent)
+    : QWidget(parent) {
+    setMinimumSize(240, 320);
+    setAutoFillBackground(true);
+}
+
+void MetricsPlotWidget::appendSnapshot(const MetricsSnapshot& snapshot) {
+    if (static_cast<int>(snapshot.channels.size()) != num_channels) {
+        frames.clear();
+        num_channels = static_cast<int>(snapshot.channels.size());
+    }
+    Frame frame(snapshot.channels.size());
+    for (size_t i = 0; i < snapshot.channels.size(); ++i) {
+        const ChannelMetricsSnapshot& channel = snapshot.channels[i];
+        frame[i][Goodput] = channel.goodput_bps / 1e6;
+        frame[i][DropRate] = channel.drop_rate * 100.0;
+        frame[i][QueueDepth] = channel.queue_depth;
+        frame[i][FecRecovery] = channel.fec_recovery_rate * 100.0;
+    }
+    frames.push_back(std::move(frame));
+    while (frames.size() > kHistoryLength) {
+        frames.pop_front();
+    }
+    update(); // 合并到下一次绘制，不会立即重绘
+}
+
+void MetricsPlotWidget::clear() {
+    frames.clear();
+    update();
+}
+
+void MetricsPlotWidget::paintEvent(QPaintEvent*) {
+    QPainter painter(this);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+
+    const int legend_height = painter.fontMetrics().height() + 6;
+    const QRectF plots_area(4, legend_height, width() - 8, height() - legend_height - 4);
+    const double plot_height = plots_area.height() / kSeriesCount;
+    for (int series = 0; series < kSeriesCount; ++series) {
+        const QRectF area(plots_area.left(), plots_area.top() + series * plot_height, plots_area.width(), plot_height - 4);
+        drawSeries(painter, area, static_cast<Series>(series));
+    }
+
+    // 图例
+    double x = 6;
+    for (int channel = 0; channel < num_channels; ++channel) {
+        const QColor& color = kChannelColors[channel % (sizeof(kChannelColors) / sizeof(kChannelColors[0]))];
+        painter.fillRect(QRectF(x, legend_height / 2.0 - 2, 14, 4), color);
+        const QString label = QStringLiteral("通道%1").arg(channel + 1);
+        painter.setPen(palette().color(QPalette::WindowText));
+        painter.drawText(QPointF(x + 18, legend_height - 6), label);
+        x += 26 + painter.fontMetrics().horizontalAdvance(label);
+    }
+}
+
+void MetricsPlotWidget::drawSeries(QPainter& painter, const QRectF& area, Series series) const {
+    const SeriesStyle& style = kSeriesStyles[series];
+    const QColor text_color = palette().color(QPalette::WindowText);
+    const int text_height = painter.fontMetrics().height();
+
+    double y_max = style.fixed_max;
+    if (y_max <= 0) {
+        double observed = 0;
+        for (const Frame& frame : frames) {
+            for (const auto& values : frame) observed = std::max(observed, values[series]);
+        }
+        y_max = niceCeiling(observed);
+    }
+
+    // 标题行：名称、纵轴上限和各通道的当前值
+    QString title = QStringLiteral("%1 (%2)  0~%3").arg(QString::fromUtf16(style.title), QString::fromUtf16(style.unit)).arg(y_max);
+    if (!frames.empty()) {
+        for (int channel = 0; channel < num_channels; ++channel) {
+            title += QStringLiteral("  %1").arg(frames.back()[channel][series], 0, 'f', series == QueueDepth ? 0 : 1);
+        }
+    }
+    painter.setPen(text_color);
+    painter.drawText(QPointF(area.left() + 2, area.top() + text_height - 2), title);
+
+    const QRectF plot(area.left(), area.top() + text_height, area.width(), area.height() - text_height);
+    painter.setPen(QPen(palette().color(QPalette::Mid), 1));
+    painter.drawRect(plot);
+    painter.setPen(QPen(palette().color(QPalette::Midlight), 1, Qt::DotLine));
+    for (int line = 1; line < 4; ++line) {
+        const double y = plot.top() + plot.height() * line / 4;
+        painter.drawLine(QPointF(plot.left(), y), QPointF(plot.right(), y));
+    }
+    if (frames.size() < 2) return;
+
+    // 最新的一帧在最右侧，历史不满时曲线从右向左增长
+    const double x_step = plot.width() / (kHistoryLength - 1);
+    const double x_start = plot.right() - (frames.size() - 1) * x_step;
+    for (int channel = 0; channel < num_channels; ++channel) {
+        QPolygonF line;
+        line.reserve(static_cast<int>(frames.size()));
+        for (size_t i = 0; i < frames.size(); ++i) {
+            const double value = std::min(frames[i][channel][series], y_max);
+            line.append(QPointF(x_start + i * x_step, plot.bottom() - value / y_max * plot.height()));
+        }
+        painter.setPen(QPen(kChannelColors[channel % (sizeof(kChannelColors) / sizeof(kChannelColors[0]))], 1.5));
+        painter.drawPolyline(line);
+    }
+}
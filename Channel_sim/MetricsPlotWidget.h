@@ -0,0 +1,35 @@
+﻿#pragma once
+#include <QWidget>
+#include <array>
+#include <deque>
+#include <vector>
+
+#include "ChannelMetrics.h"
+
+// 各通道的实时曲线：有效吞吐、模拟丢包率、队列深度和 FEC 可恢复率。
+// 数据只来自按固定帧率取得的统计快照，重绘开销与发包速率无关，
+// 界面线程不会收到任何逐包的信号。
+class MetricsPlotWidget : public QWidget {
+public:
+    static constexpr int kHistoryLength = 300; // 帧数，10Hz 下为最近 30 秒
+
+    explicit MetricsPlotWidget(QWidget* parent = nullptr);
+
+    // 追加一帧并请求重绘，只能在界面线程调用
+    void appendSnapshot(const MetricsSnapshot& snapshot);
+    void clear();
+
+    QSize sizeHint() const override { return QSize(360, 480); }
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+
+private:
+    enum Series { Goodput = 0, DropRate, QueueDepth, FecRecovery, kSeriesCount };
+    using Frame = std::vector<std::array<double, kSeriesCount>>; // 每个通道一组数值
+
+    std::deque<Frame> frames;
+    int num_channels = 0;
+
+    void drawSeries(QPainter& painter, const QRectF& area, Series series) const;
+};
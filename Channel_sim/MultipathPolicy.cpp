@@ -0,0 +1,170 @@
+﻿#include "MultipathPolicy.h"
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+double percent(uint64_t part, uint64_t whole) {
+    return whole == 0 ? 0.0 : 100.0 * static_cast<double>(part) / static_cast<double>(whole);
+}
+} // namespace
+
+// ---------------- TsPayloadClassifier ----------------
+
+PacketClass TsPayloadClassifier::operator()(const uint8_t* payload, size_t len) {
+    // 负载不一定按188对齐，先找到第一个同步字节
+    size_t offset = 0;
+    while (offset < len && offset < ts::kPacketSize && payload[offset] != ts::kSyncByte) {
+        ++offset;
+    }
+
+    PacketClass result = PacketClass::Bulk;
+    for (; offset + ts::kPacketSize <= len; offset += ts::kPacketSize) {
+        const uint8_t* ts_packet = payload + offset;
+        ts::PacketFields fields;
+        if (!ts::parsePacket(ts_packet, &fields)) break; // 失步，剩余部分不再解析
+        if (psi.onPacket(ts_packet, fields) || fields.random_access) {
+            result = PacketClass::Critical;
+        }
+    }
+    return result;
+}
+
+PacketClass classifyTsChunk(const TsChunkInfo& info) {
+    return info.isCritical() ? PacketClass::Critical : PacketClass::Bulk;
+}
+
+// ---------------- MultipathStats ----------------
+
+void MultipathStats::onCopyResolved(DeliveryRecord& record, bool is_primary, bool dropped, size_t bytes) {
+    if (is_primary) {
+        primary_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        record.primary_lost = dropped;
+    }
+    else {
+        duplicate_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+    if (!dropped) {
+        record.delivered.store(true, std::memory_order_relaxed);
+    }
+    // 最后一个结束的副本负责汇总，fetch_sub 的 acq_rel 保证能看到其他副本写入的状态
+    if (record.pending_copies.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        onPacketResolved(record);
+    }
+}
+
+void MultipathStats::onPacketResolved(DeliveryRecord& record) {
+    const bool critical = record.packet_class == PacketClass::Critical;
+    const bool lost = !record.delivered.load(std::memory_order_relaxed);
+
+    unique_packets.fetch_add(1, std::memory_order_relaxed);
+    if (critical) critical_packets.fetch_add(1, std::memory_order_relaxed);
+    if (record.primary_lost) {
+        lost_without_redundancy.fetch_add(1, std::memory_order_relaxed);
+        if (critical) critical_lost_without_redundancy.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (lost) {
+        lost_with_redundancy.fetch_add(1, std::memory_order_relaxed);
+        if (critical) critical_lost_with_redundancy.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (!record.group) return;
+    GroupDeliveryRecord& group = *record.group;
+    if (record.primary_lost) group.lost_primary.fetch_add(1, std::memory_order_relaxed);
+    if (lost) group.lost_packets.fetch_add(1, std::memory_order_relaxed);
+    if (group.pending_packets.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        onGroupResolved(group);
+    }
+}
+
+void MultipathStats::onGroupShortened(GroupDeliveryRecord& group, int missing_packets, int r) {
+    group.r = r; // 在扣减计数之前写入，汇总线程通过 acq_rel 可见
+    if (missing_packets > 0 &&
+        group.pending_packets.fetch_sub(missing_packets, std::memory_order_acq_rel) == missing_packets) {
+        onGroupResolved(group);
+    }
+}
+
+void MultipathStats::onGroupResolved(GroupDeliveryRecord& group) {
+    // 按 MDS 近似：组内丢包数不超过 r 即认为可恢复
+    groups.fetch_add(1, std::memory_order_relaxed);
+    if (group.lost_primary.load(std::memory_order_relaxed) > group.r) {
+        groups_unrecoverable_without_redundancy.fetch_add(1, std::memory_order_relaxed);
+    }
+    const int lost = group.lost_packets.load(std::memory_order_relaxed);
+    if (lost > group.r) {
+        groups_unrecoverable_with_redundancy.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (group.metrics && lost > 0) {
+        group.metrics->fec_lost_packets.fetch_add(lost, std::memory_order_relaxed);
+        if (lost <= group.r) {
+            group.metrics->fec_recovered_packets.fetch_add(lost, std::memory_order_relaxed);
+        }
+    }
+}
+
+void MultipathStats::reset() {
+    primary_bytes = 0;
+    duplicate_bytes = 0;
+    unique_packets = 0;
+    critical_packets = 0;
+    lost_without_redundancy = 0;
+    lost_with_redundancy = 0;
+    critical_lost_without_redundancy = 0;
+    critical_lost_with_redundancy = 0;
+    groups = 0;
+    groups_unrecoverable_without_redundancy = 0;
+    groups_unrecoverable_with_redundancy = 0;
+}
+
+void MultipathStats::report() const {
+    const uint64_t unique = unique_packets.load();
+    const uint64_t critical = critical_packets.load();
+    const uint64_t group_count = groups.load();
+    qDebug("Multipath: bandwidth overhead %.2f%% (%llu duplicate bytes / %llu primary bytes)",
+        percent(duplicate_bytes.load(), primary_bytes.load()),
+        static_cast<unsigned long long>(duplicate_bytes.load()),
+        static_cast<unsigned long long>(primary_bytes.load()));
+    qDebug("Multipath: packet loss %.3f%% -> %.3f%% (%llu packets)",
+        percent(lost_without_redundancy.load(), unique), percent(lost_with_redundancy.load(), unique),
+        static_cast<unsigned long long>(unique));
+    qDebug("Multipath: critical packet loss %.3f%% -> %.3f%% (%llu packets)",
+        percent(critical_lost_without_redundancy.load(), critical), percent(critical_lost_with_redundancy.load(), critical),
+        static_cast<unsigned long long>(critical));
+    qDebug("Multipath: residual group loss after FEC %.3f%% -> %.3f%% (%llu groups)",
+        percent(groups_unrecoverable_without_redundancy.load(), group_count),
+        percent(groups_unrecoverable_with_redundancy.load(), group_count),
+        static_cast<unsigned long long>(group_count));
+}
+
+// ---------------- DuplicateFilter ----------------
+
+bool DuplicateFilter::insert(uint8_t group_number, uint8_t sequence_number) {
+    if (sequence_number >= kMaxPacketsPerGroup) return true; // 超出记录范围，交给解码器判断
+    if (newest_group < 0) {
+        newest_group = group_number;
+        slots[group_number].reset();
+    }
+    // 组号前进时清掉新进入窗口的槽位，旧组号回绕后不会被误判为重复
+    const uint8_t ahead = static_cast<uint8_t>(group_number - newest_group);
+    if (ahead != 0 && ahead < kWindowGroups / 2) {
+        for (uint8_t i = 1; i <= ahead; ++i) {
+            slots[static_cast<uint8_t>(newest_group + i)].reset();
+        }
+        newest_group = group_number;
+    }
+    std::bitset<kMaxPacketsPerGroup>& received = slots[group_number];
+    if (received.test(sequence_number)) {
+        ++duplicate_count;
+        return false;
+    }
+    received.set(sequence_number);
+    return true;
+}
+
+void DuplicateFilter::reset() {
+    for (auto& received : slots) {
+        received.reset();
+    }
+    newest_group = -1;
+    duplicate_count = 0;
+}
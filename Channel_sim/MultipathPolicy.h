@@ -0,0 +1,104 @@
+﻿#pragma once
+#include <atomic>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "modules/rtp_rtcp/source/forward_error_correction_internal.h" // kUlpfecMaxMediaPackets
+#include "TsPacketizer.h"
+#include "ChannelMetrics.h"
+
+// 多路调度模式
+enum class ScheduleMode : int {
+    RoundRobin = 0,        // 原有方式：每组只走一个通道，组间轮询
+    DuplicateCritical = 1, // 关键包（PAT/PMT、I帧起始等）额外复制到其他通道
+    RedundantGroup = 2,    // 整个FEC组（源包+冗余包）同时走多个通道
+};
+
+// 负载分类结果
+enum class PacketClass : uint8_t {
+    Bulk = 0,     // 普通数据
+    Critical = 1, // 关键数据，丢失后影响远大于普通包
+};
+
+// 负载分类钩子：输入一块待发送的负载（不含FEC头），返回其重要程度
+using PayloadClassifier = std::function<PacketClass(const uint8_t* payload, size_t len)>;
+
+// 默认分类器：按188字节TS包扫描负载，PAT/PMT 以及带随机访问指示的包视为关键包。
+// 会记住PAT中声明的PMT PID，因此需要按发送顺序调用。
+// 负载已经由 TsPacketizer 对齐时直接用 classifyTsChunk，不必重复解析。
+class TsPayloadClassifier {
+public:
+    PacketClass operator()(const uint8_t* payload, size_t len);
+
+private:
+    ts::PsiTracker psi;
+};
+
+PacketClass classifyTsChunk(const TsChunkInfo& info);
+
+// 单个组的投递记录：所有副本结束（发送或被模拟丢弃）后统计该组是否可恢复
+struct GroupDeliveryRecord {
+    std::atomic<int> pending_packets{ 0 }; // 尚未结束的包数（每个唯一包算一个）
+    std::atomic<int> lost_packets{ 0 };    // 所有副本都丢失的包数
+    std::atomic<int> lost_primary{ 0 };    // 主副本丢失的包数（等价于不做冗余时的丢包）
+    int r = 0;                             // 该组的冗余包数
+    ChannelMetrics* metrics = nullptr;     // 主通道的统计，组结束时累计丢包和可恢复数
+};
+
+// 单个唯一包（group, seq）的投递记录，所有副本共享
+struct DeliveryRecord {
+    std::atomic<int> pending_copies{ 0 };
+    std::atomic<bool> delivered{ false };
+    bool primary_lost = false; // 只由主副本写入
+    PacketClass packet_class = PacketClass::Bulk;
+    std::shared_ptr<GroupDeliveryRecord> group;
+};
+
+// 多路冗余的代价和收益统计（发送端根据模拟丢包直接计算）
+class MultipathStats {
+public:
+    // 每个副本结束时调用一次；dropped 表示该副本被模拟丢弃
+    void onCopyResolved(DeliveryRecord& record, bool is_primary, bool dropped, size_t bytes);
+    // 组被提前结束（缩短码）时调用一次：missing_packets 为不会再发送的包数，r 为实际冗余包数
+    void onGroupShortened(GroupDeliveryRecord& group, int missing_packets, int r);
+    void reset();
+    void report() const; // 以 qDebug 输出
+
+    std::atomic<uint64_t> primary_bytes{ 0 };   // 主副本字节数
+    std::atomic<uint64_t> duplicate_bytes{ 0 }; // 额外副本字节数（带宽代价）
+    std::atomic<uint64_t> unique_packets{ 0 };
+    std::atomic<uint64_t> critical_packets{ 0 };
+    std::atomic<uint64_t> lost_without_redundancy{ 0 }; // 主副本丢失数
+    std::atomic<uint64_t> lost_with_redundancy{ 0 };    // 所有副本都丢失数
+    std::atomic<uint64_t> critical_lost_without_redundancy{ 0 };
+    std::atomic<uint64_t> critical_lost_with_redundancy{ 0 };
+    std::atomic<uint64_t> groups{ 0 };
+    std::atomic<uint64_t> groups_unrecoverable_without_redundancy{ 0 }; // 丢包数 > r
+    std::atomic<uint64_t> groups_unrecoverable_with_redundancy{ 0 };
+
+private:
+    void onPacketResolved(DeliveryRecord& record);
+    void onGroupResolved(GroupDeliveryRecord& group);
+};
+
+// 接收端去重：按 (组号, 组内序号) 记录已收到的包，重复副本直接丢弃。
+// 以最新组号为基准保留半个组号空间（128组）的状态，组号回绕后槽位自动复用。
+class DuplicateFilter {
+public:
+    // 返回 true 表示第一次收到，应交给解码器；false 表示重复副本
+    bool insert(uint8_t group_number, uint8_t sequence_number);
+    void reset();
+
+    uint64_t duplicates() const { return duplicate_count; }
+
+private:
+    static constexpr int kWindowGroups = 256;
+    static constexpr size_t kMaxPacketsPerGroup = 2 * kUlpfecMaxMediaPackets; // k + r
+
+    std::bitset<kMaxPacketsPerGroup> slots[kWindowGroups];
+    int newest_group = -1;
+    uint64_t duplicate_count = 0;
+};
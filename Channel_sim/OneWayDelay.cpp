@@ -0,0 +1,159 @@
+﻿#include "OneWayDelay.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "udp_with_ulpfec.h" // ForwardErrorCorrection::Packet
+
+namespace flight_header {
+
+void stamp(char* payload, size_t payload_size, uint32_t send_us, uint8_t which_channel) {
+    if (payload_size < kSize) return;
+    memcpy(payload + kNowTimeOffset, &send_us, sizeof(send_us));
+    payload[kWhichChannelOffset] = static_cast<char>(which_channel);
+}
+
+bool peekSendTime(const char* datagram, size_t len, uint32_t* send_us) {
+    const size_t header_size = ForwardErrorCorrection::Packet::PeekHeaderSize(datagram, len);
+    if (header_size == 0 || len < header_size + kSize) return false;
+    // FEC 头：mask[0..1] | group | seq | L+V+k | r，k 占低6位
+    const uint8_t sequence_number = static_cast<uint8_t>(datagram[3]);
+    const uint8_t k = static_cast<uint8_t>(datagram[4]) & 0x3F;
+    if (sequence_number >= k) return false; // 冗余包
+    memcpy(send_us, datagram + header_size + kNowTimeOffset, sizeof(*send_us));
+    return true;
+}
+
+void clearStamp(uint8_t* payload, size_t payload_size) {
+    if (payload_size < kSize) return;
+    memset(payload + kNowTimeOffset, 0, sizeof(uint32_t));
+    payload[kWhichChannelOffset] = 0;
+}
+
+} // namespace flight_header
+
+int64_t OneWayDelayEstimator::baseline(int64_t arrival_us) const {
+    if (have_fit) {
+        return static_cast<int64_t>(fit_intercept + fit_slope * static_cast<double>(arrival_us - fit_origin_us));
+    }
+    int64_t lowest = buckets.front().min_transit_us;
+    for (const Bucket& bucket : buckets) lowest = std::min(lowest, bucket.min_transit_us);
+    return lowest;
+}
+
+// 对已结束的各秒最小值做最小二乘直线拟合
+void OneWayDelayEstimator::refit() {
+    const size_t complete = buckets.size() - 1;
+    if (complete < kMinBucketsForDrift) {
+        have_fit = false;
+        return;
+    }
+    fit_origin_us = buckets.front().min_arrival_us;
+    double sum_x = 0, sum_y = 0;
+    for (size_t i = 0; i < complete; ++i) {
+        sum_x += static_cast<double>(buckets[i].min_arrival_us - fit_origin_us);
+        sum_y += static_cast<double>(buckets[i].min_transit_us);
+    }
+    const double mean_x = sum_x / complete;
+    const double mean_y = sum_y / complete;
+    double covariance = 0, variance = 0;
+    for (size_t i = 0; i < complete; ++i) {
+        const double dx = static_cast<double>(buckets[i].min_arrival_us - fit_origin_us) - mean_x;
+        covariance += dx * (static_cast<double>(buckets[i].min_transit_us) - mean_y);
+        variance += dx * dx;
+    }
+    fit_slope = variance > 0 ? covariance / variance : 0.0;
+    // 直线平移到所有最小值之下，保持为下包络
+    double shift = 0;
+    for (size_t i = 0; i < complete; ++i) {
+        const double x = static_cast<double>(buckets[i].min_arrival_us - fit_origin_us);
+        shift = std::min(shift, static_cast<double>(buckets[i].min_transit_us) - (mean_y + fit_slope * (x - mean_x)));
+    }
+    fit_intercept = mean_y - fit_slope * mean_x + shift;
+    have_fit = true;
+    drift_ppm.store(fit_slope * 1e6, std::memory_order_relaxed);
+}
+
+void OneWayDelayEstimator::onPacket(uint32_t send_us, int64_t arrival_ns) {
+    const int64_t arrival_us = arrival_ns / 1000;
+    const int64_t transit_us = arrival_us - unwrapper.PeekUnwrap(send_us);
+
+    if (!buckets.empty() && std::llabs(transit_us - baseline(arrival_us)) > kMaxSpreadUs) {
+        discarded.fetch_add(1, std::memory_order_relaxed);
+        // 连续多个样本都偏离说明是发送端重启（时钟重新计数）而不是个别损坏，重新开始估计
+        if (++consecutive_discards < kMaxConsecutiveDiscards) return;
+        buckets.clear();
+        have_fit = false;
+        have_previous = false;
+        unwrapper.Reset();
+        onPacket(send_us, arrival_ns);
+        return;
+    }
+    consecutive_discards = 0;
+    unwrapper.Unwrap(send_us);
+
+    // 按到达时刻每秒一个桶，桶结束时重新拟合
+    if (buckets.empty() || arrival_us - buckets.back().start_us >= kBucketUs) {
+        if (!buckets.empty()) {
+            if (buckets.size() > kMaxBuckets) buckets.pop_front();
+            refit();
+        }
+        buckets.push_back({ arrival_us, transit_us, arrival_us });
+    }
+    else if (transit_us < buckets.back().min_transit_us) {
+        buckets.back().min_transit_us = transit_us;
+        buckets.back().min_arrival_us = arrival_us;
+    }
+
+    // 低于基线的样本说明基线偏高（刚开始或漂移变化），下移基线
+    int64_t above_us = transit_us - baseline(arrival_us);
+    if (above_us < 0) {
+        if (have_fit) fit_intercept += static_cast<double>(above_us);
+        above_us = 0;
+    }
+    variation_ns.record(static_cast<uint64_t>(above_us) * 1000);
+    offset_us.store(static_cast<double>(baseline(arrival_us)), std::memory_order_relaxed);
+    const double smoothed = delay_us.load(std::memory_order_relaxed);
+    delay_us.store(sample_count.load(std::memory_order_relaxed) == 0
+        ? static_cast<double>(above_us) : smoothed + (static_cast<double>(above_us) - smoothed) / 16,
+        std::memory_order_relaxed);
+
+    if (have_previous) {
+        const double difference = static_cast<double>(std::llabs(transit_us - previous_transit_us));
+        const double jitter = jitter_us.load(std::memory_order_relaxed);
+        jitter_us.store(jitter + (difference - jitter) / 16, std::memory_order_relaxed);
+    }
+    previous_transit_us = transit_us;
+    have_previous = true;
+    sample_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+OneWayDelaySnapshot OneWayDelayEstimator::snapshot() const {
+    OneWayDelaySnapshot snapshot;
+    snapshot.channel = channel;
+    snapshot.samples = sample_count.load(std::memory_order_relaxed);
+    snapshot.discarded = discarded.load(std::memory_order_relaxed);
+    snapshot.clock_offset_ms = offset_us.load(std::memory_order_relaxed) / 1000.0;
+    snapshot.delay_ms = delay_us.load(std::memory_order_relaxed) / 1000.0;
+    snapshot.jitter_ms = jitter_us.load(std::memory_order_relaxed) / 1000.0;
+    snapshot.drift_ppm = drift_ppm.load(std::memory_order_relaxed);
+    snapshot.variation = metrics::summarize(variation_ns);
+    return snapshot;
+}
+
+void OneWayDelayEstimator::reset() {
+    unwrapper.Reset();
+    buckets.clear();
+    have_fit = false;
+    fit_slope = 0;
+    fit_intercept = 0;
+    have_previous = false;
+    consecutive_discards = 0;
+    sample_count.store(0);
+    discarded.store(0);
+    offset_us.store(0);
+    delay_us.store(0);
+    jitter_us.store(0);
+    drift_ppm.store(0);
+    variation_ns.reset();
+}
@@ -0,0 +1,75 @@
+﻿#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+#include "rtc_base/numerics/sequence_number_unwrapper.h"
+#include "ChannelMetrics.h"
+
+// 试飞院头（Udpserver.h 中的 videoStruct，位于每个源包负载的开头）里由发送线程在 sendto 前填写的字段。
+// 冗余包按读取线程写入的占位值（0）异或生成，收到的源包却带着发送时刻，恢复时异或出来的是其他源包
+// 时间戳的组合，所以接收端在交付恢复出的源包前把这两个字段改回占位值。
+namespace flight_header {
+constexpr size_t kNowTimeOffset = 5;       // unsigned int nowTime：发送时刻，单调时钟微秒（32位回绕）
+constexpr size_t kWhichChannelOffset = 11; // unsigned char whichChannel：发送通道号，从1开始
+constexpr size_t kSize = 15;
+
+// 写入负载开头的试飞院头，负载不足 kSize 时不写
+void stamp(char* payload, size_t payload_size, uint32_t send_us, uint8_t which_channel);
+// 从完整的数据报（FEC头 | 负载 | 尾部）读出源包的发送时刻；冗余包或长度不足时返回 false
+bool peekSendTime(const char* datagram, size_t len, uint32_t* send_us);
+// 把恢复出的源包负载开头的发送时刻和通道号改回占位值 0，负载不足 kSize 时不改
+void clearStamp(uint8_t* payload, size_t payload_size);
+} // namespace flight_header
+
+// 单个通道的单向时延估计。两端时钟不同步：传输时间样本 = 到达时刻 - 发送时刻 = 时钟偏差 + 单向时延。
+// 每秒取一次样本最小值（排队为零时的下包络），对最近 kMaxBuckets 秒的最小值做最小二乘直线拟合，
+// 斜率即两端时钟的相对漂移，直线在当前时刻的值作为基线（时钟偏差 + 最小传播时延）；
+// 样本减去基线即高于基线的单向时延（排队和时延抖动），抖动缓冲按它的分布确定大小。
+// 只允许一个线程调用 onPacket（接收线程），snapshot 可以在任意线程调用。
+class OneWayDelayEstimator {
+public:
+    static constexpr int64_t kBucketUs = 1000000;
+    static constexpr size_t kMaxBuckets = 60;
+    static constexpr size_t kMinBucketsForDrift = 5; // 不足时不估计漂移，基线取各秒最小值中的最小者
+    static constexpr int64_t kMaxSpreadUs = 10000000; // 偏离基线超过 10 秒的样本视为时间戳损坏，丢弃
+    static constexpr int kMaxConsecutiveDiscards = 16;
+
+    explicit OneWayDelayEstimator(int channel = 0) : channel(channel) {}
+
+    // send_us 为试飞院头中的发送时刻，arrival_ns 为接收端单调时钟
+    void onPacket(uint32_t send_us, int64_t arrival_ns);
+    OneWayDelaySnapshot snapshot() const;
+    uint64_t samples() const { return sample_count.load(std::memory_order_relaxed); }
+    void reset(); // 只能在接收线程停止时调用
+
+private:
+    struct Bucket {
+        int64_t start_us = 0;
+        int64_t min_transit_us = 0;
+        int64_t min_arrival_us = 0; // 最小值样本的到达时刻，作为拟合的横坐标
+    };
+
+    int64_t baseline(int64_t arrival_us) const;
+    void refit();
+
+    const int channel;
+    webrtc::SeqNumUnwrapper<uint32_t> unwrapper;
+    std::deque<Bucket> buckets; // 最后一个是当前未结束的一秒
+    bool have_fit = false;
+    double fit_slope = 0;       // 传输时间随到达时刻的变化率（漂移）
+    double fit_intercept = 0;   // 在 fit_origin_us 处的基线
+    int64_t fit_origin_us = 0;
+    int64_t previous_transit_us = 0;
+    bool have_previous = false;
+    int consecutive_discards = 0;
+
+    std::atomic<uint64_t> sample_count{ 0 };
+    std::atomic<uint64_t> discarded{ 0 };
+    std::atomic<double> offset_us{ 0 };
+    std::atomic<double> delay_us{ 0 };  // 高于基线部分的指数平滑（1/16）
+    std::atomic<double> jitter_us{ 0 }; // RFC 3550 到达间隔抖动
+    std::atomic<double> drift_ppm{ 0 };
+    LatencyHistogram variation_ns;      // 高于基线部分的分布
+};
@@ -0,0 +1,339 @@
+﻿#include "PacketCapture.h"
+#include <QDebug>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QWaitCondition>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+std::atomic<bool> PacketCapture::active{ false };
+
+namespace {
+
+constexpr uint32_t kSectionHeaderBlock = 0x0A0D0D0A;
+constexpr uint32_t kInterfaceDescriptionBlock = 0x00000001;
+constexpr uint32_t kEnhancedPacketBlock = 0x00000006;
+constexpr uint32_t kByteOrderMagic = 0x1A2B3C4D;
+constexpr uint16_t kOptionEnd = 0;
+constexpr uint16_t kOptionShbUserAppl = 4;
+constexpr uint16_t kOptionIfName = 2;
+constexpr uint16_t kOptionIfTsResol = 9;
+constexpr uint16_t kOptionEpbFlags = 2;
+
+// 缓冲区中每个数据报前的记录头
+struct RecordHeader {
+    int64_t timestamp_ns;
+    uint32_t length;
+    uint8_t direction;
+    uint8_t channel;
+    uint16_t reserved;
+};
+
+int interfaceId(PacketCapture::Direction direction, int channel) {
+    return (direction == PacketCapture::Direction::Outbound ? 0 : PacketCapture::kMaxChannels) + channel;
+}
+
+size_t padded(size_t len) {
+    return (len + 3) & ~static_cast<size_t>(3);
+}
+
+void putU16(QByteArray& out, uint16_t value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void putU32(QByteArray& out, uint32_t value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void putOption(QByteArray& out, uint16_t code, const void* value, size_t len) {
+    putU16(out, code);
+    putU16(out, static_cast<uint16_t>(len));
+    out.append(static_cast<const char*>(value), static_cast<int>(len));
+    out.append(static_cast<int>(padded(len) - len), '\0');
+}
+
+// 块 = 类型 | 总长度 | body | 总长度
+void putBlock(QByteArray& out, uint32_t type, const QByteArray& body) {
+    const uint32_t total = static_cast<uint32_t>(12 + body.size());
+    putU32(out, type);
+    putU32(out, total);
+    out.append(body);
+    putU32(out, total);
+}
+
+QByteArray fileHeader() {
+    QByteArray out;
+    QByteArray section;
+    putU32(section, kByteOrderMagic);
+    putU16(section, 1); // major
+    putU16(section, 0); // minor
+    const int64_t section_length = -1;
+    section.append(reinterpret_cast<const char*>(&section_length), sizeof(section_length));
+    const char application[] = "Channel_sim";
+    putOption(section, kOptionShbUserAppl, application, sizeof(application) - 1);
+    putU16(section, kOptionEnd);
+    putU16(section, 0);
+    putBlock(out, kSectionHeaderBlock, section);
+
+    for (int id = 0; id < 2 * PacketCapture::kMaxChannels; ++id) {
+        const bool outbound = id < PacketCapture::kMaxChannels;
+        QByteArray interface_block;
+        putU16(interface_block, PacketCapture::kLinkType);
+        putU16(interface_block, 0);
+        putU32(interface_block, 0); // snaplen 不限
+        const QByteArray name = QByteArray("ch") + QByteArray::number(id % PacketCapture::kMaxChannels) +
+            (outbound ? "-tx" : "-rx");
+        putOption(interface_block, kOptionIfName, name.constData(), static_cast<size_t>(name.size()));
+        const uint8_t nanoseconds = 9; // 时间戳单位 10^-9 秒
+        putOption(interface_block, kOptionIfTsResol, &nanoseconds, 1);
+        putU16(interface_block, kOptionEnd);
+        putU16(interface_block, 0);
+        putBlock(out, kInterfaceDescriptionBlock, interface_block);
+    }
+    return out;
+}
+
+void appendPacketBlock(QByteArray& out, const RecordHeader& header, const char* data) {
+    const size_t data_len = padded(header.length);
+    const uint32_t total = static_cast<uint32_t>(12 + 20 + data_len + 8 + 4);
+    const uint64_t timestamp = static_cast<uint64_t>(header.timestamp_ns);
+    putU32(out, kEnhancedPacketBlock);
+    putU32(out, total);
+    putU32(out, static_cast<uint32_t>(interfaceId(static_cast<PacketCapture::Direction>(header.direction), header.channel)));
+    putU32(out, static_cast<uint32_t>(timestamp >> 32));
+    putU32(out, static_cast<uint32_t>(timestamp));
+    putU32(out, header.length);
+    putU32(out, header.length);
+    out.append(data, static_cast<int>(header.length));
+    out.append(static_cast<int>(data_len - header.length), '\0');
+    const uint32_t flags = header.direction; // 低两位：1 入，2 出
+    putOption(out, kOptionEpbFlags, &flags, sizeof(flags));
+    putU16(out, kOptionEnd);
+    putU16(out, 0);
+    putU32(out, total);
+}
+
+} // namespace
+
+struct PacketCapture::Impl {
+    QMutex mutex; // 保护 active_buffer
+    std::vector<char> active_buffer;
+    std::vector<char> spare_buffer;
+    size_t capacity = 0;
+
+    QFile file;
+    QByteArray output;
+    QMutex wait_mutex;
+    QWaitCondition wake;
+    QThread* thread = nullptr;
+    bool stopping = false;
+};
+
+PacketCapture& PacketCapture::instance() {
+    static PacketCapture capture;
+    return capture;
+}
+
+PacketCapture::PacketCapture() : impl(new Impl()) {
+}
+
+PacketCapture::~PacketCapture() {
+    stop();
+    delete impl;
+}
+
+bool PacketCapture::start(const QString& path, size_t buffer_bytes) {
+    stop();
+    impl->file.setFileName(path);
+    if (!impl->file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Failed to open capture file" << path;
+        return false;
+    }
+    impl->file.write(fileHeader());
+    impl->capacity = buffer_bytes;
+    impl->active_buffer.clear();
+    impl->active_buffer.reserve(buffer_bytes);
+    impl->spare_buffer.clear();
+    impl->spare_buffer.reserve(buffer_bytes);
+    captured.store(0);
+    dropped.store(0);
+    impl->stopping = false;
+    impl->thread = QThread::create([this]() { run(); });
+    impl->thread->setObjectName("PacketCaptureThread");
+    impl->thread->start();
+    active.store(true);
+    qDebug() << "Packet capture started:" << path;
+    return true;
+}
+
+void PacketCapture::stop() {
+    if (!impl->thread) return;
+    active.store(false);
+    {
+        QMutexLocker lock(&impl->wait_mutex);
+        impl->stopping = true;
+        impl->wake.wakeOne();
+    }
+    impl->thread->wait();
+    delete impl->thread;
+    impl->thread = nullptr;
+    impl->file.close();
+    qDebug("Packet capture stopped: %llu datagrams captured, %llu dropped (buffer full).",
+        static_cast<unsigned long long>(captured.load()), static_cast<unsigned long long>(dropped.load()));
+}
+
+void PacketCapture::append(Direction direction, int channel, const char* data, size_t len) {
+    RecordHeader header;
+    header.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    header.length = static_cast<uint32_t>(len);
+    header.direction = static_cast<uint8_t>(direction);
+    header.channel = static_cast<uint8_t>(std::max(0, std::min(channel, kMaxChannels - 1)));
+    header.reserved = 0;
+
+    QMutexLocker lock(&impl->mutex);
+    std::vector<char>& buffer = impl->active_buffer;
+    if (buffer.size() + sizeof(header) + len > impl->capacity) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    // 容量已预留，insert 不会重新分配
+    const char* header_bytes = reinterpret_cast<const char*>(&header);
+    buffer.insert(buffer.end(), header_bytes, header_bytes + sizeof(header));
+    buffer.insert(buffer.end(), data, data + len);
+    captured.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PacketCapture::run() {
+    for (;;) {
+        bool stopping;
+        {
+            QMutexLocker lock(&impl->wait_mutex);
+            if (!impl->stopping) impl->wake.wait(&impl->wait_mutex, kFlushIntervalMs);
+            stopping = impl->stopping;
+        }
+        writePending(stopping);
+        if (stopping) break;
+    }
+}
+
+// 交换双缓冲，把记录转换成 EPB 写入文件
+void PacketCapture::writePending(bool final) {
+    {
+        QMutexLocker lock(&impl->mutex);
+        impl->active_buffer.swap(impl->spare_buffer);
+    }
+    const std::vector<char>& buffer = impl->spare_buffer;
+    impl->output.clear();
+    for (size_t pos = 0; pos + sizeof(RecordHeader) <= buffer.size();) {
+        RecordHeader header;
+        memcpy(&header, buffer.data() + pos, sizeof(header));
+        pos += sizeof(header);
+        appendPacketBlock(impl->output, header, buffer.data() + pos);
+        pos += header.length;
+    }
+    impl->spare_buffer.clear(); // clear 保留容量
+    if (!impl->output.isEmpty() && impl->file.write(impl->output) != impl->output.size()) {
+        qWarning() << "Packet capture write failed:" << impl->file.errorString();
+    }
+    if (final) impl->file.flush();
+}
+
+namespace pcapng {
+
+namespace {
+
+bool readU32(const QByteArray& data, qsizetype pos, uint32_t* value) {
+    if (pos < 0 || pos + 4 > data.size()) return false;
+    memcpy(value, data.constData() + pos, 4);
+    return true;
+}
+
+} // namespace
+
+bool readFile(const QString& path, std::vector<CapturedPacket>* packets, QString* error) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *error = file.errorString();
+        return false;
+    }
+    const QByteArray data = file.readAll();
+    packets->clear();
+
+    // 每个接口的时间戳单位（纳秒倍数），默认微秒
+    std::vector<int64_t> interface_units;
+    bool has_section = false;
+    for (qsizetype pos = 0; pos < data.size();) {
+        uint32_t type = 0;
+        uint32_t total = 0;
+        if (!readU32(data, pos, &type) || !readU32(data, pos + 4, &total) || total < 12 || total % 4 != 0 ||
+            pos + total > data.size()) {
+            *error = QString("truncated block at offset %1").arg(pos);
+            return false;
+        }
+        const qsizetype body = pos + 8;
+        const qsizetype body_end = pos + total - 4;
+        if (type == kSectionHeaderBlock) {
+            uint32_t magic = 0;
+            if (!readU32(data, body, &magic) || magic != kByteOrderMagic) {
+                *error = "unsupported byte order";
+                return false;
+            }
+            has_section = true;
+            interface_units.clear();
+        }
+        else if (!has_section) {
+            *error = "missing section header";
+            return false;
+        }
+        else if (type == kInterfaceDescriptionBlock) {
+            int64_t unit_ns = 1000;
+            // 选项从 linktype/reserved/snaplen 之后开始
+            for (qsizetype option = body + 8; option + 4 <= body_end;) {
+                uint16_t code = 0;
+                uint16_t length = 0;
+                memcpy(&code, data.constData() + option, 2);
+                memcpy(&length, data.constData() + option + 2, 2);
+                if (code == kOptionEnd) break;
+                if (code == kOptionIfTsResol && length >= 1) {
+                    const uint8_t resolution = static_cast<uint8_t>(data[option + 4]);
+                    if ((resolution & 0x80) == 0 && resolution <= 9) {
+                        unit_ns = 1;
+                        for (int i = resolution; i < 9; ++i) unit_ns *= 10;
+                    }
+                }
+                option += 4 + static_cast<qsizetype>(padded(length));
+            }
+            interface_units.push_back(unit_ns);
+        }
+        else if (type == kEnhancedPacketBlock) {
+            uint32_t interface_id = 0, high = 0, low = 0, captured_len = 0;
+            readU32(data, body, &interface_id);
+            readU32(data, body + 4, &high);
+            readU32(data, body + 8, &low);
+            readU32(data, body + 12, &captured_len);
+            if (interface_id >= interface_units.size() || body + 20 + captured_len > body_end) {
+                *error = QString("invalid packet block at offset %1").arg(pos);
+                return false;
+            }
+            CapturedPacket packet;
+            packet.timestamp_ns = static_cast<int64_t>((static_cast<uint64_t>(high) << 32) | low) * interface_units[interface_id];
+            packet.direction = interface_id < static_cast<uint32_t>(PacketCapture::kMaxChannels)
+                ? PacketCapture::Direction::Outbound : PacketCapture::Direction::Inbound;
+            packet.channel = static_cast<int>(interface_id % PacketCapture::kMaxChannels);
+            packet.data = data.mid(body + 20, captured_len);
+            packets->push_back(std::move(packet));
+        }
+        pos += total;
+    }
+    if (!has_section) {
+        *error = "empty file";
+        return false;
+    }
+    return true;
+}
+
+} // namespace pcapng
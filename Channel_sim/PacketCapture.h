@@ -0,0 +1,71 @@
+﻿#pragma once
+#include <QByteArray>
+#include <QString>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 数据报抓包：在 sendto 处和接收端记录每个数据报（时间戳、方向、通道号），异步写成 pcapng，
+// 可直接用 Wireshark 打开，也可以交给 PacketReplay 回放到接收端解码器。
+//
+// 抓包线程只做一次加锁和一次拷贝，拷进预先分配好的缓冲区，不分配内存；
+// 写文件在后台线程进行（双缓冲，每 kFlushIntervalMs 交换一次）。
+// 缓冲区满时丢弃新的数据报并计数，不会阻塞发送线程。
+// 每个（方向, 通道）对应 pcapng 中的一个接口，名字为 ch<N>-tx / ch<N>-rx，链路类型为 USER0（负载即数据报）。
+class PacketCapture {
+public:
+    enum class Direction : uint8_t {
+        Inbound = 1,  // 与 pcapng epb_flags 的方向位一致
+        Outbound = 2,
+    };
+
+    static constexpr int kMaxChannels = 8;
+    static constexpr uint16_t kLinkType = 147; // LINKTYPE_USER0
+    static constexpr size_t kDefaultBufferBytes = 16 * 1024 * 1024; // 每个缓冲区的大小（共两个）
+    static constexpr int kFlushIntervalMs = 50;
+
+    static PacketCapture& instance();
+
+    // 开始抓包并创建（覆盖）文件，失败返回 false
+    bool start(const QString& path, size_t buffer_bytes = kDefaultBufferBytes);
+    // 写出剩余数据并关闭文件
+    void stop();
+
+    // 热路径入口：未开启时只是一次原子读
+    static void capture(Direction direction, int channel, const char* data, size_t len) {
+        if (active.load(std::memory_order_relaxed)) instance().append(direction, channel, data, len);
+    }
+
+    uint64_t capturedPackets() const { return captured.load(std::memory_order_relaxed); }
+    uint64_t droppedPackets() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    PacketCapture();
+    ~PacketCapture();
+
+    void append(Direction direction, int channel, const char* data, size_t len);
+    void run();
+    void writePending(bool final);
+
+    struct Impl;
+    Impl* impl;
+    static std::atomic<bool> active;
+    std::atomic<uint64_t> captured{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+};
+
+// pcapng 读写（只支持本程序写出的小端格式：SHB / IDB / EPB）
+namespace pcapng {
+
+struct CapturedPacket {
+    int64_t timestamp_ns = 0; // 墙上时间
+    PacketCapture::Direction direction = PacketCapture::Direction::Outbound;
+    int channel = 0;
+    QByteArray data;
+};
+
+// 读取整个文件，按文件中的顺序返回数据报。格式错误时返回 false 并填写 error
+bool readFile(const QString& path, std::vector<CapturedPacket>* packets, QString* error);
+
+} // namespace pcapng
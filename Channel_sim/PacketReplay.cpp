@@ -0,0 +1,179 @@
+﻿#include "PacketReplay.h"
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Crc32.h"
+#include "FecReceiver.h"
+#include "OneWayDelay.h"
+
+namespace PacketReplay {
+
+QJsonObject replay(const Options& options, QString* error) {
+    std::vector<pcapng::CapturedPacket> packets;
+    if (!pcapng::readFile(options.path, &packets, error)) {
+        return QJsonObject();
+    }
+    // 同一方向的数据报按时间排序（多个发送线程写入缓冲区的顺序与时间戳可能略有出入）
+    packets.erase(std::remove_if(packets.begin(), packets.end(), [&](const pcapng::CapturedPacket& packet) {
+        return packet.direction != options.direction;
+    }), packets.end());
+    std::stable_sort(packets.begin(), packets.end(), [](const pcapng::CapturedPacket& a, const pcapng::CapturedPacket& b) {
+        return a.timestamp_ns < b.timestamp_ns;
+    });
+
+    FecReceiverConfig config;
+    config.hold_ms = options.hold_ms;
+    config.ordered_playout = options.ordered_playout;
+    FecStreamDemux receiver(config);
+    uint32_t digest = 0;
+    uint64_t media_bytes = 0;
+    receiver.setMediaCallback([&](uint8_t, int64_t group_id, int sequence_number, const uint8_t* payload, size_t len, bool) {
+        digest = crc::crc32c(&group_id, sizeof(group_id), digest);
+        digest = crc::crc32c(&sequence_number, sizeof(sequence_number), digest);
+        digest = crc::crc32c(payload, len, digest);
+        media_bytes += len;
+    });
+
+    uint64_t per_channel[PacketCapture::kMaxChannels] = {};
+    // 接收方向的抓包时间戳就是到达时刻，按抓包时间估计各通道的单向时延（与回放速度无关）
+    const bool inbound = options.direction == PacketCapture::Direction::Inbound;
+    std::vector<std::unique_ptr<OneWayDelayEstimator>> delays;
+    for (int channel = 0; channel < PacketCapture::kMaxChannels; ++channel) {
+        delays.push_back(std::make_unique<OneWayDelayEstimator>(channel));
+    }
+    const auto wall_start = std::chrono::steady_clock::now();
+    const int64_t first_ns = packets.empty() ? 0 : packets.front().timestamp_ns;
+    for (const pcapng::CapturedPacket& packet : packets) {
+        const int64_t offset_ns = packet.timestamp_ns - first_ns;
+        if (options.speed > 0) {
+            std::this_thread::sleep_until(wall_start +
+                std::chrono::nanoseconds(static_cast<int64_t>(offset_ns / options.speed)));
+        }
+        per_channel[packet.channel]++;
+        uint32_t send_us;
+        if (inbound && flight_header::peekSendTime(packet.data.constData(), static_cast<size_t>(packet.data.size()), &send_us)) {
+            delays[packet.channel]->onPacket(send_us, packet.timestamp_ns);
+        }
+        receiver.onDatagram(packet.data.constData(), static_cast<size_t>(packet.data.size()), packet.timestamp_ns / 1000000);
+    }
+    receiver.flush();
+    const double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+
+    const FecReceiverStats stats = receiver.stats();
+    QJsonObject result;
+    result["file"] = options.path;
+    result["direction"] = options.direction == PacketCapture::Direction::Outbound ? "tx" : "rx";
+    result["speed"] = options.speed;
+    result["ordered_playout"] = options.ordered_playout;
+    result["datagrams"] = static_cast<qint64>(packets.size());
+    result["capture_seconds"] = packets.empty() ? 0.0 : (packets.back().timestamp_ns - first_ns) / 1e9;
+    result["replay_seconds"] = wall_seconds;
+    QJsonArray channels;
+    for (uint64_t count : per_channel) channels.append(static_cast<qint64>(count));
+    result["datagrams_per_channel"] = channels;
+    auto writeStats = [](QJsonObject& object, const FecReceiverStats& counters) {
+        object["malformed"] = static_cast<qint64>(counters.malformed);
+        object["crc_errors"] = static_cast<qint64>(counters.crc_errors);
+        object["duplicates"] = static_cast<qint64>(counters.duplicates);
+        object["late"] = static_cast<qint64>(counters.late);
+        object["media_received"] = static_cast<qint64>(counters.media_received);
+        object["media_recovered"] = static_cast<qint64>(counters.media_recovered);
+        object["media_lost"] = static_cast<qint64>(counters.media_lost);
+        object["groups_complete"] = static_cast<qint64>(counters.groups_complete);
+        object["groups_expired"] = static_cast<qint64>(counters.groups_expired);
+        object["late_media"] = static_cast<qint64>(counters.late_media);
+        object["slot_overflows"] = static_cast<qint64>(counters.slot_overflows);
+    };
+    auto writePlayout = [](QJsonObject& object, const FecReceiver& stream) {
+        object["playout_delay_ms"] = stream.playoutDelayMs();
+        QJsonArray channel_delays;
+        for (int channel = 0; channel < FecReceiver::kMaxChannels; ++channel) {
+            channel_delays.append(stream.channelDelayMs(channel));
+        }
+        object["channel_delay_ms"] = channel_delays;
+        object["buffer_delay"] = metrics::latencyToJson(metrics::summarize(stream.bufferDelay()));
+    };
+    // 汇总统计在顶层，各流（按 stream_type 分流解码）的明细在 streams 中
+    writeStats(result, stats);
+    QJsonArray streams;
+    for (uint8_t stream_type : receiver.streamTypes()) {
+        const FecReceiver& stream = *receiver.stream(stream_type);
+        QJsonObject object;
+        object["stream_type"] = stream_type;
+        writeStats(object, stream.stats());
+        if (options.ordered_playout) writePlayout(object, stream);
+        streams.append(object);
+    }
+    result["streams"] = streams;
+    if (options.ordered_playout && receiver.streamTypes().size() == 1) {
+        writePlayout(result, *receiver.stream(receiver.streamTypes().front()));
+    }
+    if (inbound) {
+        QJsonArray one_way_delay;
+        for (const std::unique_ptr<OneWayDelayEstimator>& delay : delays) {
+            if (delay->samples() > 0) one_way_delay.append(metrics::delayToJson(delay->snapshot()));
+        }
+        result["one_way_delay"] = one_way_delay;
+    }
+    result["media_bytes"] = static_cast<qint64>(media_bytes);
+    result["media_digest"] = QString::number(digest, 16).rightJustified(8, '0');
+    return result;
+}
+
+int runFromCommandLine(const QStringList& arguments) {
+    auto valueOf = [&arguments](const QString& name) {
+        const int index = arguments.indexOf(name);
+        return index >= 0 && index + 1 < arguments.size() ? arguments[index + 1] : QString();
+    };
+    Options options;
+    options.path = valueOf("--replay");
+    if (options.path.isEmpty()) {
+        fprintf(stderr, "Usage: --replay <file.pcapng> [--speed <factor>|max] [--direction tx|rx] [--ordered] [--out result.json]\n");
+        return 2;
+    }
+    const QString speed = valueOf("--speed");
+    if (speed == "max") {
+        options.speed = 0;
+    }
+    else if (!speed.isEmpty()) {
+        options.speed = speed.toDouble();
+        if (options.speed <= 0) {
+            fprintf(stderr, "--speed must be positive or 'max'\n");
+            return 2;
+        }
+    }
+    if (valueOf("--direction") == "rx") {
+        options.direction = PacketCapture::Direction::Inbound;
+    }
+    options.ordered_playout = arguments.contains("--ordered");
+
+    QString error;
+    const QJsonObject result = replay(options, &error);
+    if (result.isEmpty()) {
+        fprintf(stderr, "Replay of %s failed: %s\n", qPrintable(options.path), qPrintable(error));
+        return 1;
+    }
+    const QByteArray json = QJsonDocument(result).toJson(QJsonDocument::Indented);
+    const QString out_path = valueOf("--out");
+    if (out_path.isEmpty()) {
+        fwrite(json.constData(), 1, static_cast<size_t>(json.size()), stdout);
+        return 0;
+    }
+    QFile file(out_path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        fprintf(stderr, "Failed to open %s for writing\n", qPrintable(out_path));
+        return 1;
+    }
+    file.write(json);
+    fprintf(stderr, "Results written to %s\n", qPrintable(out_path));
+    return 0;
+}
+
+} // namespace PacketReplay
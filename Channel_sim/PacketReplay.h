@@ -0,0 +1,29 @@
+﻿#pragma once
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+
+#include "PacketCapture.h"
+
+// 抓包回放：把 pcapng 中某个方向的数据报按原始（或加速的）时间间隔交给接收端解码器（按 stream_type 分流），
+// 用于离线复现现场问题和回归测试。解码器使用抓包时间作为时钟，
+// 所以不论回放速度如何，组的过期判断和解码结果都与原始时序一致。
+// 命令行调用：Channel_sim.exe --replay <file.pcapng> [--speed <倍数>|max] [--direction tx|rx] [--ordered] [--out result.json]
+namespace PacketReplay {
+
+struct Options {
+    QString path;
+    double speed = 1.0; // 0 表示不等待，尽快回放
+    PacketCapture::Direction direction = PacketCapture::Direction::Outbound;
+    int64_t hold_ms = 3000; // 解码器的组保持时间
+    bool ordered_playout = false; // 经过抖动缓冲按组号顺序播出，并报告缓冲时延
+};
+
+// 回放一个抓包文件，返回解码统计；media_digest 是按交付顺序对所有源包（组号、序号、负载）
+// 计算的 CRC-32C，两次回放结果一致时说明解码行为没有变化
+QJsonObject replay(const Options& options, QString* error);
+
+// 解析命令行并运行，返回进程退出码
+int runFromCommandLine(const QStringList& arguments);
+
+} // namespace PacketReplay
@@ -0,0 +1,139 @@
+﻿#include "PlayoutPacer.h"
+#include <chrono>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#endif
+
+namespace {
+
+int64_t steadyNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+int64_t PcrTimeline::extrapolate(uint64_t bytes) const {
+    return last_pcr_ns + (bytes_per_ns > 0 ? static_cast<int64_t>(static_cast<double>(bytes) / bytes_per_ns) : 0);
+}
+
+int64_t PcrTimeline::onChunk(const TsChunkInfo& info, size_t bytes) {
+    const bool usable_pcr = info.has_pcr && (!has_reference || info.pcr_pid == pid);
+    if (!usable_pcr) {
+        if (!has_reference) return -1;
+        // 块内没有本节目的 PCR：从上一个 PCR 外推
+        const int64_t chunk_ns = std::max(last_chunk_ns, extrapolate(bytes_since_pcr));
+        bytes_since_pcr += bytes;
+        last_chunk_ns = chunk_ns;
+        return chunk_ns;
+    }
+
+    // PCR 所在包在块内的偏移，块起点比它早这么多字节
+    const uint64_t pcr_offset = static_cast<uint64_t>(std::max(0, info.pcr_packet_index)) * ts::kPacketSize;
+    if (!has_reference) {
+        has_reference = true;
+        pid = info.pcr_pid;
+        last_pcr_ns = 0;
+    }
+    else {
+        const uint64_t bytes_between = bytes_since_pcr + pcr_offset;
+        const uint64_t ticks = (info.pcr + kPcrModulus - last_pcr) % kPcrModulus;
+        const int64_t delta_ns = static_cast<int64_t>(ticks * 1000 / 27);
+        if (ticks == 0 || delta_ns > kMaxPcrGapNs) {
+            // 倒退（模运算后表现为很大的间隔）、跳变或重复：按码率接上，不改码率估计
+            ++discontinuity_count;
+            last_pcr_ns = extrapolate(bytes_between);
+        }
+        else {
+            // 字节数和时长分别平滑后再相除，I 帧突发时不会把码率估高
+            if (average_ns > 0) {
+                average_bytes += (static_cast<double>(bytes_between) - average_bytes) / 8;
+                average_ns += (static_cast<double>(delta_ns) - average_ns) / 8;
+            }
+            else {
+                average_bytes = static_cast<double>(bytes_between);
+                average_ns = static_cast<double>(delta_ns);
+            }
+            bytes_per_ns = average_bytes / average_ns;
+            last_pcr_ns += delta_ns;
+        }
+    }
+    last_pcr = info.pcr;
+    bytes_since_pcr = bytes - std::min<uint64_t>(bytes, pcr_offset);
+
+    const int64_t chunk_ns = std::max(last_chunk_ns, bytes_per_ns > 0
+        ? last_pcr_ns - static_cast<int64_t>(static_cast<double>(pcr_offset) / bytes_per_ns) : last_pcr_ns);
+    last_chunk_ns = chunk_ns;
+    return chunk_ns;
+}
+
+void PcrTimeline::reset() {
+    *this = PcrTimeline();
+}
+
+int64_t PlayoutSchedule::releaseTime(int64_t stream_ns, int64_t now_ns) {
+    if (!anchored) {
+        anchored = true;
+        anchor_stream_ns = stream_ns;
+        anchor_wall_ns = now_ns;
+    }
+    int64_t release = anchor_wall_ns + static_cast<int64_t>(static_cast<double>(stream_ns - anchor_stream_ns) / speed);
+    if (release < now_ns - kMaxLateNs) {
+        ++reanchor_count;
+        anchor_stream_ns = stream_ns;
+        anchor_wall_ns = now_ns;
+        release = now_ns;
+    }
+    return release;
+}
+
+PreciseTimer::PreciseTimer() {
+#if defined(_WIN32)
+    timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (!timer) {
+        timer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS); // 旧系统：普通定时器，精度同 Sleep
+    }
+#endif
+}
+
+PreciseTimer::~PreciseTimer() {
+#if defined(_WIN32)
+    if (timer) CloseHandle(static_cast<HANDLE>(timer));
+#endif
+}
+
+void PreciseTimer::sleepFor(int64_t ns) {
+    if (ns <= 0) return;
+#if defined(_WIN32)
+    if (timer) {
+        LARGE_INTEGER due;
+        due.QuadPart = -std::max<int64_t>(1, ns / 100); // 负数表示相对时间，单位 100ns
+        if (SetWaitableTimer(static_cast<HANDLE>(timer), &due, 0, nullptr, nullptr, FALSE)) {
+            WaitForSingleObject(static_cast<HANDLE>(timer), INFINITE);
+            return;
+        }
+    }
+#endif
+    std::this_thread::sleep_for(std::chrono::nanoseconds(ns));
+}
+
+void PreciseTimer::sleepUntil(int64_t deadline_ns, int64_t spin_ns) {
+    const int64_t remaining = deadline_ns - steadyNowNs();
+    if (remaining > spin_ns) sleepFor(remaining - spin_ns);
+    while (steadyNowNs() < deadline_ns) {
+        std::this_thread::yield();
+    }
+}
+
+int64_t PreciseTimer::coarseMarginNs() {
+#if defined(_WIN32)
+    return 20000000; // 默认时钟中断 15.6ms
+#else
+    return 2000000;
+#endif
+}
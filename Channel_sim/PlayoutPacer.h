@@ -0,0 +1,186 @@
+﻿#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "TsPacketizer.h"
+
+// 发送节奏
+enum class PlayoutMode : int {
+    Bitrate = 0, // 按读取的字节数和 setPacingRate 的速率睡眠（原有方式）
+    Pcr = 1,     // TS 文件按 PCR 时间轴决定每个数据报的发送时刻，没有 PCR 的流退回 Bitrate
+};
+
+// 把 TS 流中的 PCR（27MHz）展开成从第一个 PCR 起算、单调不减的流时间。
+// 只跟踪第一个出现的 PCR PID；33 位回绕按模运算处理，相邻 PCR 倒退或间隔超过 kMaxPcrGapNs
+// 视为不连续（文件拼接、编码器重启），此时按估计的码率外推接上，时间轴不跳变。
+// 两个 PCR 之间的块按平滑后的码率从上一个 PCR 外推。不是线程安全的。
+class PcrTimeline {
+public:
+    static constexpr uint64_t kPcrModulus = (1ULL << 33) * 300;
+    static constexpr int64_t kMaxPcrGapNs = 1000000000;
+
+    // 一个负载块起点的流时间（纳秒）。还没见过 PCR 时返回 -1
+    int64_t onChunk(const TsChunkInfo& info, size_t bytes);
+    void reset();
+
+    bool locked() const { return has_reference; }
+    uint16_t pcrPid() const { return pid; }
+    double bitrate() const { return bytes_per_ns * 8e9; } // bit/s，还不知道时为 0
+    uint64_t discontinuities() const { return discontinuity_count; }
+
+private:
+    int64_t extrapolate(uint64_t bytes) const;
+
+    bool has_reference = false;
+    uint16_t pid = 0;
+    uint64_t last_pcr = 0;
+    int64_t last_pcr_ns = 0;      // 上一个 PCR 的流时间
+    uint64_t bytes_since_pcr = 0; // 上一个 PCR 所在包起点到下一个块起点的字节数
+    double average_bytes = 0;     // 相邻 PCR 之间的字节数和时长（指数平滑）
+    double average_ns = 0;
+    double bytes_per_ns = 0;      // 码率估计，0 表示还不知道
+    int64_t last_chunk_ns = 0;    // 保证同一个流的发送时刻单调，避免时间轮里乱序
+    uint64_t discontinuity_count = 0;
+};
+
+// 流时间到发送时刻（单调时钟）的映射：release = 锚点 + (流时间 - 锚点流时间) / speed。
+// 按绝对时刻调度，睡眠误差不会累积；发送端落后超过 kMaxLateNs（通道全部禁用、读盘卡顿等）时
+// 重新对齐锚点，从当前时刻按原速继续，不一口气补发积压的数据。
+class PlayoutSchedule {
+public:
+    static constexpr int64_t kMaxLateNs = 200000000;
+
+    explicit PlayoutSchedule(double speed = 1.0) : speed(speed > 0 ? speed : 1.0) {}
+
+    int64_t releaseTime(int64_t stream_ns, int64_t now_ns);
+    uint64_t reanchors() const { return reanchor_count; }
+
+private:
+    double speed;
+    bool anchored = false;
+    int64_t anchor_stream_ns = 0;
+    int64_t anchor_wall_ns = 0;
+    uint64_t reanchor_count = 0;
+};
+
+// 哈希时间轮：到期时刻按 tick 落到环形槽里，加入和取出都是 O(1)（槽内按到期时刻排序），
+// 超出一圈的条目先放在有序的溢出表里，转到时再移入槽中。不是线程安全的。
+template <typename T>
+class TimerWheel {
+public:
+    explicit TimerWheel(int64_t tick_ns = 1000000, size_t slot_count = 1024)
+        : tick_ns(std::max<int64_t>(1, tick_ns)), slots(std::max<size_t>(2, slot_count)) {}
+
+    void schedule(int64_t due_ns, T&& item) {
+        const int64_t tick = due_ns / tick_ns;
+        if (empty()) current_tick = tick; // 空闲时直接转到新条目所在的 tick
+        if (tick >= current_tick + static_cast<int64_t>(slots.size())) {
+            overflow.emplace(due_ns, std::move(item));
+            return;
+        }
+        insert(std::max(tick, current_tick), due_ns, std::move(item));
+    }
+
+    // 取出所有到期（due <= now_ns）的条目，按到期时刻追加到 out，返回个数
+    size_t popDue(int64_t now_ns, std::vector<T>* out) {
+        const size_t before = out->size();
+        const int64_t now_tick = now_ns / tick_ns;
+        while (count > 0 || !overflow.empty()) {
+            std::vector<Entry>& slot = slotOf(current_tick);
+            size_t taken = 0;
+            while (taken < slot.size() && slot[taken].due_ns <= now_ns) {
+                out->push_back(std::move(slot[taken].item));
+                ++taken;
+            }
+            slot.erase(slot.begin(), slot.begin() + static_cast<std::ptrdiff_t>(taken));
+            count -= taken;
+            if (current_tick >= now_tick || !slot.empty()) break;
+            advance();
+        }
+        return out->size() - before;
+    }
+
+    // 最早的到期时刻，空时返回 int64 最大值
+    int64_t nextDue() const {
+        if (count > 0) {
+            for (size_t i = 0; i < slots.size(); ++i) {
+                const std::vector<Entry>& slot = slots[static_cast<size_t>((current_tick + static_cast<int64_t>(i)) % static_cast<int64_t>(slots.size()))];
+                if (!slot.empty()) return slot.front().due_ns;
+            }
+        }
+        return overflow.empty() ? std::numeric_limits<int64_t>::max() : overflow.begin()->first;
+    }
+
+    size_t size() const { return count + overflow.size(); }
+    bool empty() const { return size() == 0; }
+
+    void clear() {
+        for (std::vector<Entry>& slot : slots) slot.clear();
+        overflow.clear();
+        count = 0;
+        current_tick = 0;
+    }
+
+private:
+    struct Entry {
+        int64_t due_ns;
+        T item;
+    };
+
+    std::vector<Entry>& slotOf(int64_t tick) {
+        return slots[static_cast<size_t>(tick % static_cast<int64_t>(slots.size()))];
+    }
+
+    // 槽内按到期时刻有序；同一个流的条目单调，通常直接追加在末尾
+    void insert(int64_t tick, int64_t due_ns, T&& item) {
+        std::vector<Entry>& slot = slotOf(tick);
+        auto position = slot.end();
+        while (position != slot.begin() && std::prev(position)->due_ns > due_ns) --position;
+        slot.insert(position, Entry{ due_ns, std::move(item) });
+        ++count;
+    }
+
+    // 当前槽已空，转到下一个 tick，并把进入这一圈的溢出条目移入槽中
+    void advance() {
+        ++current_tick;
+        if (count == 0 && !overflow.empty()) {
+            current_tick = std::max(current_tick, overflow.begin()->first / tick_ns); // 跳过空转
+        }
+        const int64_t horizon = (current_tick + static_cast<int64_t>(slots.size())) * tick_ns;
+        while (!overflow.empty() && overflow.begin()->first < horizon) {
+            auto node = overflow.begin();
+            insert(std::max(node->first / tick_ns, current_tick), node->first, std::move(node->second));
+            overflow.erase(node);
+        }
+    }
+
+    const int64_t tick_ns;
+    std::vector<std::vector<Entry>> slots;
+    std::multimap<int64_t, T> overflow;
+    size_t count = 0; // 槽中的条目数
+    int64_t current_tick = 0;
+};
+
+// 高精度睡眠：Windows 上用高分辨率可等待定时器（Win10 1803 起，约 0.5ms），不支持时退回 Sleep；
+// 离截止时刻 spin_ns 以内时让出 CPU 自旋，不依赖系统时钟中断的粒度
+class PreciseTimer {
+public:
+    PreciseTimer();
+    ~PreciseTimer();
+    PreciseTimer(const PreciseTimer&) = delete;
+    PreciseTimer& operator=(const PreciseTimer&) = delete;
+
+    void sleepFor(int64_t ns);
+    void sleepUntil(int64_t deadline_ns, int64_t spin_ns);
+
+    // 粗等待（条件变量、普通 Sleep）可能多睡的时长，播出线程离截止时刻更近时改用本定时器
+    static int64_t coarseMarginNs();
+
+private:
+    void* timer = nullptr; // Windows 下为 HANDLE
+};
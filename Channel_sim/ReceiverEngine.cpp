@@ -0,0 +1,519 @@
+﻿#include "ReceiverEngine.h"
+#include <QDebug>
+#include <QThread>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+
+#include "OneWayDelay.h"
+#include "CongestionControl.h"
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using SocketHandle = SOCKET;
+constexpr SocketHandle kInvalidSocket = INVALID_SOCKET;
+#else
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+using SocketHandle = int;
+constexpr SocketHandle kInvalidSocket = -1;
+#endif
+
+namespace {
+
+constexpr size_t kMaxDatagramSize = 4096;
+
+int64_t steadyNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void closeSocket(SocketHandle socket) {
+#if defined(_WIN32)
+    closesocket(socket);
+#else
+    close(socket);
+#endif
+}
+
+int lastSocketError() {
+#if defined(_WIN32)
+    return WSAGetLastError();
+#else
+    return errno;
+#endif
+}
+
+} // namespace
+
+struct ReceiverEngine::Shard {
+    struct Endpoint {
+        SocketHandle socket = kInvalidSocket;
+        int channel = 0;
+        bool has_peer = false; // 收到过数据报后记下发送端地址，反馈发往这里
+        sockaddr_in peer;
+        int64_t last_arrival_ns = 0;
+    };
+
+    explicit Shard(const FecReceiverConfig& decoder_config) : decoder(decoder_config) {}
+
+    int index = 0;
+    std::vector<Endpoint> endpoints;
+    FecStreamDemux decoder;
+    LatencyHistogram decode_ns;
+    std::vector<std::unique_ptr<OneWayDelayEstimator>> delays; // 按通道号，只有分配给本分片的通道有样本
+    std::vector<std::unique_ptr<FeedbackGenerator>> feedback;  // 按通道号，不发反馈时为空
+    std::unique_ptr<NackGenerator> nack;                       // 所有通道共用，未启用时为空
+    QThread* thread = nullptr;
+    uint64_t datagrams = 0;
+    uint64_t bytes = 0;
+    uint64_t wakeups = 0;
+    uint64_t batches = 0;
+    uint64_t feedback_sent = 0;
+    std::vector<char> buffers; // batch_size 个 kMaxDatagramSize 的接收缓冲区
+    // 收件箱：其他分片收到的、归本分片解码的数据报，依次拼接在 inbox 里，由本分片的线程取走解码
+    std::mutex inbox_mutex;
+    std::vector<char> inbox;
+    std::vector<size_t> inbox_lengths;
+    std::vector<char> inbox_taken; // 取走后在锁外解码，和 inbox 交换以复用容量
+    std::vector<size_t> inbox_taken_lengths;
+#if defined(_WIN32)
+    SocketHandle wake_socket = kInvalidSocket; // 绑定在回环地址上，stop 或收件箱有数据时发一个字节唤醒 WSAPoll
+    sockaddr_in wake_addr;
+#else
+    int epoll_fd = -1;
+    int wake_fd = -1; // stop 或收件箱有数据时写入，立即唤醒 epoll_wait
+#endif
+};
+
+ReceiverEngine::ReceiverEngine(const ReceiverEngineConfig& config) : config(config) {
+    this->config.shards = std::max(1, config.shards);
+    this->config.batch_size = std::max(1, config.batch_size);
+}
+
+ReceiverEngine::~ReceiverEngine() {
+    stop();
+}
+
+bool ReceiverEngine::openShard(Shard& shard, int shard_index) {
+    shard.index = shard_index;
+    shard.buffers.resize(static_cast<size_t>(config.batch_size) * kMaxDatagramSize);
+    for (int channel = 0; channel < config.channels; ++channel) {
+        shard.delays.push_back(std::make_unique<OneWayDelayEstimator>(channel));
+    }
+#if defined(__linux__)
+    const bool share_ports = config.reuse_port;
+#else
+    const bool share_ports = false;
+    if (config.reuse_port && shard_index == 0) {
+        qWarning("ReceiverEngine: SO_REUSEPORT fan-out is only available on Linux, channels are partitioned across shards instead.");
+    }
+#endif
+    // 同一个通道分散到多个分片时各分片只看到部分数据报，反馈的收包数和到达组都不完整，不发
+    if (config.feedback_interval_ms > 0 && !(share_ports && config.shards > 1)) {
+        for (int channel = 0; channel < config.channels; ++channel) {
+            shard.feedback.push_back(std::make_unique<FeedbackGenerator>(channel, config.feedback_interval_ms));
+        }
+    }
+    else if (config.feedback_interval_ms > 0 && shard_index == 0) {
+        qWarning("ReceiverEngine: congestion control feedback is disabled with SO_REUSEPORT fan-out across shards.");
+    }
+    // 全局序列号跨通道连续，只有一个分片收到所有通道时才能发现缺口
+    if (config.nack && config.shards == 1) {
+        shard.nack = std::make_unique<NackGenerator>(config.nack_config);
+    }
+    else if (config.nack && shard_index == 0) {
+        qWarning("ReceiverEngine: NACK needs all channels on a single shard, retransmission requests are disabled.");
+    }
+    for (int channel = 0; channel < config.channels; ++channel) {
+        if (!share_ports && channel % config.shards != shard_index) continue;
+        SocketHandle socket_handle = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (socket_handle == kInvalidSocket) {
+            qWarning("ReceiverEngine: socket creation failed for channel %d (error %d).", channel, lastSocketError());
+            return false;
+        }
+        shard.endpoints.push_back({ socket_handle, channel });
+        int buffer_size = config.socket_buffer_bytes;
+        setsockopt(socket_handle, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&buffer_size), sizeof(buffer_size));
+#if defined(__linux__)
+        if (share_ports) {
+            int enable = 1;
+            setsockopt(socket_handle, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
+        }
+#endif
+#if defined(_WIN32)
+        u_long non_blocking = 1;
+        ioctlsocket(socket_handle, FIONBIO, &non_blocking);
+#endif
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(config.base_port + channel));
+        inet_pton(AF_INET, config.bind_host.toStdString().c_str(), &addr.sin_addr);
+        if (bind(socket_handle, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            qWarning("ReceiverEngine: bind %s:%d failed (error %d).", qPrintable(config.bind_host),
+                config.base_port + channel, lastSocketError());
+            return false;
+        }
+    }
+#if defined(_WIN32)
+    shard.wake_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (shard.wake_socket == kInvalidSocket) {
+        qWarning("ReceiverEngine: wake socket creation failed (error %d).", lastSocketError());
+        return false;
+    }
+    u_long non_blocking = 1;
+    ioctlsocket(shard.wake_socket, FIONBIO, &non_blocking);
+    memset(&shard.wake_addr, 0, sizeof(shard.wake_addr));
+    shard.wake_addr.sin_family = AF_INET;
+    shard.wake_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int wake_addr_length = sizeof(shard.wake_addr);
+    if (bind(shard.wake_socket, reinterpret_cast<sockaddr*>(&shard.wake_addr), sizeof(shard.wake_addr)) != 0
+        || getsockname(shard.wake_socket, reinterpret_cast<sockaddr*>(&shard.wake_addr), &wake_addr_length) != 0) {
+        qWarning("ReceiverEngine: wake socket bind failed (error %d).", lastSocketError());
+        return false;
+    }
+#else
+    shard.epoll_fd = epoll_create1(0);
+    shard.wake_fd = eventfd(0, EFD_NONBLOCK);
+    if (shard.epoll_fd < 0 || shard.wake_fd < 0) {
+        qWarning("ReceiverEngine: epoll/eventfd creation failed (error %d).", errno);
+        return false;
+    }
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u32 = UINT32_MAX; // 唤醒事件
+    epoll_ctl(shard.epoll_fd, EPOLL_CTL_ADD, shard.wake_fd, &event);
+    for (uint32_t i = 0; i < shard.endpoints.size(); ++i) {
+        event.data.u32 = i;
+        epoll_ctl(shard.epoll_fd, EPOLL_CTL_ADD, shard.endpoints[i].socket, &event);
+    }
+#endif
+    return true;
+}
+
+bool ReceiverEngine::start() {
+    if (running.load()) return true;
+    shards.clear();
+    for (int i = 0; i < config.shards; ++i) {
+        auto shard = std::make_unique<Shard>(config.decoder);
+        shard->decoder.setMediaCallback(media_callback);
+        if (!openShard(*shard, i)) {
+            for (const Shard::Endpoint& endpoint : shard->endpoints) closeSocket(endpoint.socket);
+#if defined(_WIN32)
+            if (shard->wake_socket != kInvalidSocket) closeSocket(shard->wake_socket);
+#endif
+            shards.clear(); // 之前的分片还没有启动线程
+            return false;
+        }
+        shards.push_back(std::move(shard));
+    }
+    running.store(true);
+    for (std::unique_ptr<Shard>& shard : shards) {
+        Shard* raw = shard.get();
+        raw->thread = QThread::create([this, raw]() { runShard(*raw); });
+        raw->thread->setObjectName(QString("ReceiverShard_%1").arg(raw->index));
+        raw->thread->start();
+    }
+    qDebug("ReceiverEngine started: %d shard(s), %d channel(s), batch %d.", config.shards, config.channels, config.batch_size);
+    return true;
+}
+
+void ReceiverEngine::stop() {
+    if (!running.exchange(false)) return;
+    for (std::unique_ptr<Shard>& shard : shards) wakeShard(*shard);
+    for (std::unique_ptr<Shard>& shard : shards) {
+        shard->thread->wait();
+        delete shard->thread;
+        shard->thread = nullptr;
+    }
+    // 其他分片在最后一轮里还可能转交数据报，所有线程退出后再解码收件箱里剩下的
+    for (std::unique_ptr<Shard>& shard : shards) {
+        decodeInbox(*shard);
+        shard->decoder.flush();
+        for (const Shard::Endpoint& endpoint : shard->endpoints) closeSocket(endpoint.socket);
+#if defined(_WIN32)
+        closeSocket(shard->wake_socket);
+#else
+        close(shard->epoll_fd);
+        close(shard->wake_fd);
+#endif
+    }
+}
+
+void ReceiverEngine::wakeShard(Shard& shard) {
+#if defined(_WIN32)
+    const char one = 1;
+    sendto(shard.wake_socket, &one, 1, 0, reinterpret_cast<const sockaddr*>(&shard.wake_addr), sizeof(shard.wake_addr));
+#else
+    const uint64_t one = 1;
+    if (write(shard.wake_fd, &one, sizeof(one)) < 0) {
+        // 写失败时线程会在下一个 tick 醒来
+    }
+#endif
+}
+
+void ReceiverEngine::decodeInbox(Shard& shard) {
+    {
+        std::lock_guard<std::mutex> lock(shard.inbox_mutex);
+        if (shard.inbox_lengths.empty()) return;
+        shard.inbox.swap(shard.inbox_taken);
+        shard.inbox_lengths.swap(shard.inbox_taken_lengths);
+    }
+    const char* data = shard.inbox_taken.data();
+    for (size_t len : shard.inbox_taken_lengths) {
+        const int64_t start_ns = steadyNowNs();
+        shard.decoder.onDatagram(data, len, start_ns / 1000000);
+        shard.decode_ns.record(static_cast<uint64_t>(steadyNowNs() - start_ns));
+        data += len;
+    }
+    shard.inbox_taken.clear();
+    shard.inbox_taken_lengths.clear();
+}
+
+ReceiverEngine::Shard& ReceiverEngine::ownerOf(Shard& receiver, const char* data, size_t len) {
+    if (shards.size() == 1) return receiver;
+    datagram::Trailer trailer;
+    if (!FecReceiver::peekTrailer(data, len, &trailer)) return receiver; // 留在本分片，解码器计入 malformed
+    return *shards[trailer.stream_type % shards.size()];
+}
+
+void ReceiverEngine::runShard(Shard& shard) {
+    const int batch_size = config.batch_size;
+    std::vector<char> wake_owner(shards.size(), 0); // 本批转交过数据报的分片，批末各唤醒一次
+    // 一次收取：返回收到的数据报数，0 表示该套接字已收空
+    auto receiveBatch = [&](Shard::Endpoint& endpoint) -> int {
+        int received = 0;
+#if defined(__linux__)
+        mmsghdr messages[256];
+        iovec vectors[256];
+        sockaddr_in senders[256];
+        const int count = std::min(batch_size, 256);
+        for (int i = 0; i < count; ++i) {
+            vectors[i].iov_base = &shard.buffers[static_cast<size_t>(i) * kMaxDatagramSize];
+            vectors[i].iov_len = kMaxDatagramSize;
+            memset(&messages[i].msg_hdr, 0, sizeof(messages[i].msg_hdr));
+            messages[i].msg_hdr.msg_iov = &vectors[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+            messages[i].msg_hdr.msg_name = &senders[i];
+            messages[i].msg_hdr.msg_namelen = sizeof(senders[i]);
+        }
+        const int result = recvmmsg(endpoint.socket, messages, static_cast<unsigned int>(count), MSG_DONTWAIT, nullptr);
+        if (result <= 0) return 0;
+        received = result;
+        endpoint.peer = senders[result - 1];
+        auto lengthOf = [&](int i) { return static_cast<size_t>(messages[i].msg_len); };
+#else
+        size_t lengths[256];
+        const int count = std::min(batch_size, 256);
+        for (; received < count; ++received) {
+            sockaddr_in sender;
+#if defined(_WIN32)
+            int sender_length = sizeof(sender);
+            const int len = recvfrom(endpoint.socket, &shard.buffers[static_cast<size_t>(received) * kMaxDatagramSize],
+                static_cast<int>(kMaxDatagramSize), 0, reinterpret_cast<sockaddr*>(&sender), &sender_length);
+#else
+            socklen_t sender_length = sizeof(sender);
+            const int len = static_cast<int>(recvfrom(endpoint.socket, &shard.buffers[static_cast<size_t>(received) * kMaxDatagramSize],
+                kMaxDatagramSize, MSG_DONTWAIT, reinterpret_cast<sockaddr*>(&sender), &sender_length));
+#endif
+            if (len <= 0) break; // 已收空
+            lengths[received] = static_cast<size_t>(len);
+            endpoint.peer = sender;
+        }
+        if (received == 0) return 0;
+        auto lengthOf = [&](int i) { return lengths[i]; };
+#endif
+        shard.batches++;
+        endpoint.has_peer = true;
+        // 同一批数据报用同一个到达时刻，误差不超过一次系统调用的耗时
+        const int64_t batch_ns = steadyNowNs();
+        endpoint.last_arrival_ns = batch_ns;
+        OneWayDelayEstimator& delay = *shard.delays[static_cast<size_t>(endpoint.channel)];
+        FeedbackGenerator* feedback = shard.feedback.empty() ? nullptr : shard.feedback[static_cast<size_t>(endpoint.channel)].get();
+        for (int i = 0; i < received; ++i) {
+            const char* data = &shard.buffers[static_cast<size_t>(i) * kMaxDatagramSize];
+            const size_t len = lengthOf(i);
+            shard.datagrams++;
+            shard.bytes += len;
+            if (datagram_hook) datagram_hook(endpoint.channel, data, len);
+            uint32_t send_us = 0;
+            bool has_send_time = flight_header::peekSendTime(data, len, &send_us);
+            Shard& owner = ownerOf(shard, data, len);
+            if (&owner == &shard) {
+                const int64_t start_ns = steadyNowNs();
+                datagram::Trailer trailer;
+                shard.decoder.onDatagram(data, len, start_ns / 1000000, &trailer);
+                shard.decode_ns.record(static_cast<uint64_t>(steadyNowNs() - start_ns));
+                // 请求过重传的包带着原来的发送时刻，不能计入时延估计
+                const int64_t group_id = shard.decoder.lastGroupId();
+                if (shard.nack && group_id >= 0 && shard.decoder.lastProtocolVersion() >= ForwardErrorCorrection::Packet::kProtocolV2
+                    && shard.nack->onPacket(trailer.seq, trailer.stream_type, group_id, start_ns / 1000000)) {
+                    has_send_time = false;
+                }
+            }
+            else {
+                std::lock_guard<std::mutex> lock(owner.inbox_mutex);
+                owner.inbox.insert(owner.inbox.end(), data, data + len);
+                owner.inbox_lengths.push_back(len);
+                wake_owner[static_cast<size_t>(owner.index)] = 1;
+            }
+            if (has_send_time) delay.onPacket(send_us, batch_ns);
+            if (feedback) feedback->onDatagram(len, has_send_time, send_us, batch_ns);
+        }
+        for (size_t i = 0; i < wake_owner.size(); ++i) {
+            if (!wake_owner[i]) continue;
+            wakeShard(*shards[i]);
+            wake_owner[i] = 0;
+        }
+        return received;
+    };
+    // 收空一个套接字：批满说明可能还有数据，继续收
+    auto drain = [&](Shard::Endpoint& endpoint) {
+        while (receiveBatch(endpoint) == batch_size) {
+        }
+    };
+    // 到了反馈间隔且有新数据的通道，把反馈发回该通道的发送端
+    char feedback_buffer[datagram::kFeedbackHeaderSize + datagram::kMaxFeedbackGroups * 8];
+    auto sendFeedback = [&](int64_t now_ns) {
+        for (Shard::Endpoint& endpoint : shard.endpoints) {
+            if (shard.feedback.empty() || !endpoint.has_peer) continue;
+            datagram::Feedback report;
+            if (!shard.feedback[static_cast<size_t>(endpoint.channel)]->build(now_ns, &report)) continue;
+            const size_t size = datagram::writeFeedback(feedback_buffer, sizeof(feedback_buffer), report);
+            if (size == 0) continue;
+            const int sent = static_cast<int>(sendto(endpoint.socket, feedback_buffer, static_cast<int>(size), 0,
+                reinterpret_cast<const sockaddr*>(&endpoint.peer), sizeof(endpoint.peer)));
+            if (sent == static_cast<int>(size)) shard.feedback_sent++;
+        }
+    };
+    // 到期的缺口合成一份重传请求，发往最近收到数据的通道的发送端（发送端的反馈线程监听所有通道）
+    char nack_buffer[datagram::kNackHeaderSize + datagram::kMaxNackSeqs * 4];
+    std::vector<uint32_t> nack_seqs;
+    auto sendNack = [&](int64_t now_ns) {
+        if (!shard.nack) return;
+        nack_seqs.clear();
+        shard.nack->collect(now_ns / 1000000, [&](uint8_t stream_type, int64_t group_id) {
+            return shard.decoder.groupComplete(stream_type, group_id);
+        }, &nack_seqs, datagram::kMaxNackSeqs);
+        if (nack_seqs.empty()) return;
+        const Shard::Endpoint* target = nullptr;
+        for (const Shard::Endpoint& endpoint : shard.endpoints) {
+            if (endpoint.has_peer && (!target || endpoint.last_arrival_ns > target->last_arrival_ns)) target = &endpoint;
+        }
+        if (!target) return;
+        const size_t size = datagram::writeNack(nack_buffer, sizeof(nack_buffer), nack_seqs.data(), nack_seqs.size());
+        if (size == 0) return;
+        const int sent = static_cast<int>(sendto(target->socket, nack_buffer, static_cast<int>(size), 0,
+            reinterpret_cast<const sockaddr*>(&target->peer), sizeof(target->peer)));
+        if (sent == static_cast<int>(size)) shard.nack->onReportSent();
+    };
+
+    // 退出前再收一轮，取走停止前已经到达的数据报
+    for (bool last_round = false; !last_round;) {
+        last_round = !running.load();
+#if defined(_WIN32)
+        // 唤醒套接字排在最后
+        std::vector<WSAPOLLFD> poll_fds(shard.endpoints.size() + 1);
+        for (size_t i = 0; i < poll_fds.size(); ++i) {
+            poll_fds[i].fd = i < shard.endpoints.size() ? shard.endpoints[i].socket : shard.wake_socket;
+            poll_fds[i].events = POLLRDNORM;
+            poll_fds[i].revents = 0;
+        }
+        const int ready = WSAPoll(poll_fds.data(), static_cast<ULONG>(poll_fds.size()), last_round ? 0 : config.tick_ms);
+        shard.wakeups++;
+        if (ready > 0) {
+            for (size_t i = 0; i < shard.endpoints.size(); ++i) {
+                if (poll_fds[i].revents & (POLLRDNORM | POLLERR)) drain(shard.endpoints[i]);
+            }
+            if (poll_fds.back().revents & (POLLRDNORM | POLLERR)) {
+                char discard[16];
+                while (recv(shard.wake_socket, discard, sizeof(discard), 0) > 0) {
+                }
+            }
+        }
+#else
+        epoll_event events[16];
+        const int ready = epoll_wait(shard.epoll_fd, events, 16, last_round ? 0 : config.tick_ms);
+        shard.wakeups++;
+        for (int i = 0; i < ready; ++i) {
+            if (events[i].data.u32 == UINT32_MAX) {
+                // stop 或收件箱的唤醒：清零计数，stop 由循环条件处理，收件箱在下面解码
+                uint64_t count = 0;
+                if (read(shard.wake_fd, &count, sizeof(count)) < 0) {
+                    // 已被清零
+                }
+                continue;
+            }
+            drain(shard.endpoints[events[i].data.u32]);
+        }
+#endif
+        decodeInbox(shard);
+        // 没有数据时也推进解码器的时钟，播出时限和组超时不依赖新包到达
+        const int64_t now_ns = steadyNowNs();
+        shard.decoder.expire(now_ns / 1000000);
+        sendFeedback(now_ns);
+        sendNack(now_ns);
+    }
+}
+
+ReceiverEngineStats ReceiverEngine::stats() const {
+    ReceiverEngineStats total;
+    for (const std::unique_ptr<Shard>& shard : shards) {
+        total.datagrams += shard->datagrams;
+        total.bytes += shard->bytes;
+        total.wakeups += shard->wakeups;
+        total.batches += shard->batches;
+        total.feedback_sent += shard->feedback_sent;
+        if (shard->nack) total.nack.accumulate(shard->nack->stats());
+
+        total.decoder.accumulate(shard->decoder.stats());
+    }
+    return total;
+}
+
+FecReceiverStats ReceiverEngine::streamStats(uint8_t stream_type) const {
+    FecReceiverStats total;
+    for (const std::unique_ptr<Shard>& shard : shards) {
+        if (const FecReceiver* receiver = shard->decoder.stream(stream_type)) total.accumulate(receiver->stats());
+    }
+    return total;
+}
+
+std::vector<uint8_t> ReceiverEngine::streamTypes() const {
+    std::vector<uint8_t> types;
+    for (const std::unique_ptr<Shard>& shard : shards) {
+        types.insert(types.end(), shard->decoder.streamTypes().begin(), shard->decoder.streamTypes().end());
+    }
+    std::sort(types.begin(), types.end());
+    types.erase(std::unique(types.begin(), types.end()), types.end());
+    return types;
+}
+
+const LatencyHistogram& ReceiverEngine::decodeLatency(int shard) const {
+    return shards[static_cast<size_t>(std::max(0, std::min(shard, shardCount() - 1)))]->decode_ns;
+}
+
+OneWayDelaySnapshot ReceiverEngine::channelDelay(int channel) const {
+    // 通道按分片划分时只有一个分片有样本；SO_REUSEPORT 时取样本最多的分片
+    const OneWayDelayEstimator* best = nullptr;
+    for (const std::unique_ptr<Shard>& shard : shards) {
+        if (channel < 0 || channel >= static_cast<int>(shard->delays.size())) continue;
+        const OneWayDelayEstimator* candidate = shard->delays[static_cast<size_t>(channel)].get();
+        if (!best || candidate->samples() > best->samples()) best = candidate;
+    }
+    if (!best) {
+        OneWayDelaySnapshot empty;
+        empty.channel = channel;
+        return empty;
+    }
+    return best->snapshot();
+}
@@ -0,0 +1,97 @@
+﻿#pragma once
+#include <QString>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "ChannelMetrics.h"
+#include "FecReceiver.h"
+#include "Retransmission.h"
+
+struct ReceiverEngineConfig {
+    QString bind_host = "0.0.0.0";
+    int base_port = 600;          // 通道 i 绑定 base_port + i
+    int channels = 3;
+    int shards = 1;               // 反应器线程数，每个线程一个独立的解码器，负责 stream_type % shards 相同的流
+    bool reuse_port = false;      // Linux：每个分片都绑定所有端口（SO_REUSEPORT），由内核按流分散到各分片
+    int batch_size = 32;          // 每次系统调用最多收取的数据报数（recvmmsg）
+    int socket_buffer_bytes = 8 * 1024 * 1024;
+    int tick_ms = 20;             // 没有数据时的最长等待，用于驱动解码器的超时释放
+    int feedback_interval_ms = 50; // 拥塞控制反馈的间隔，发往各通道最近一个数据报的源地址；0 表示不发
+    bool nack = false;             // 按全局序列号请求重传（需要 v2 协议，所有通道在同一个分片）
+    NackConfig nack_config;
+    FecReceiverConfig decoder;
+};
+
+struct ReceiverEngineStats {
+    uint64_t datagrams = 0;
+    uint64_t bytes = 0;
+    uint64_t wakeups = 0;   // 事件等待返回的次数
+    uint64_t batches = 0;   // 收到数据的接收调用次数，datagrams / batches 即平均批大小
+    uint64_t feedback_sent = 0; // 发回发送端的拥塞控制反馈数
+    NackStats nack;           // 重传请求，未启用时全为 0
+    FecReceiverStats decoder; // 各分片、各流解码器统计之和
+
+};
+
+// 事件驱动的接收引擎：每个分片一个反应器线程，阻塞在 epoll（Linux）或 WSAPoll（Windows）上，
+// 有数据时按批收取（Linux 用 recvmmsg，Windows 循环非阻塞 recv 直到收空），
+// 交给解码器（按 stream_type 分给各流的 FecReceiver），没有轮询休眠。
+// 多个分片时收包和解码分开划分：套接字按通道号分配（通道 i → 分片 i % shards，SO_REUSEPORT 时
+// 由内核分散），解码按流分配（stream_type 为 s 的流 → 分片 s % shards）。一个组的数据报轮流走各个
+// 通道，必须进同一个解码器才能恢复和去重，所以收到别的分片的流时拷贝进该分片的收件箱并唤醒它。
+// 单个分片或数据报属于本分片时在收包线程里直接解码，没有中间队列。流数少于分片数时多出的分片只收包。
+class ReceiverEngine {
+public:
+    // 解码前的原始数据报（抓包等），在反应器线程中调用
+    using DatagramHook = std::function<void(int channel, const char* data, size_t len)>;
+
+    explicit ReceiverEngine(const ReceiverEngineConfig& config);
+    ~ReceiverEngine();
+
+    ReceiverEngine(const ReceiverEngine&) = delete;
+    ReceiverEngine& operator=(const ReceiverEngine&) = delete;
+
+    // 须在 start 之前设置。同一个流的回调总在同一个分片线程中调用，多个分片时不同流的回调可能并发
+    void setMediaCallback(FecStreamDemux::MediaCallback callback) { media_callback = std::move(callback); }
+    void setDatagramHook(DatagramHook hook) { datagram_hook = std::move(hook); }
+
+    // 创建并绑定套接字、启动反应器线程，失败时返回 false（已创建的资源会释放）
+    bool start();
+    // 停止线程，收完已到达的数据报并结束所有在途的组
+    void stop();
+    bool isRunning() const { return running.load(); }
+
+    // 停止后读取；运行中读取只是近似值
+    ReceiverEngineStats stats() const;
+    // 单个流在各分片上的统计之和
+    FecReceiverStats streamStats(uint8_t stream_type) const;
+    // 收到过的流（各分片的并集，升序）
+    std::vector<uint8_t> streamTypes() const;
+    // 每个数据报在解码器中的耗时（纳秒），各分片分别统计
+    const LatencyHistogram& decodeLatency(int shard) const;
+    // 单个通道的单向时延估计（发送时刻取自源包的试飞院头），运行中可以读取
+    OneWayDelaySnapshot channelDelay(int channel) const;
+    int shardCount() const { return static_cast<int>(shards.size()); }
+
+private:
+    struct Shard;
+
+    ReceiverEngineConfig config;
+    FecStreamDemux::MediaCallback media_callback;
+    DatagramHook datagram_hook;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::atomic<bool> running{ false };
+
+    bool openShard(Shard& shard, int shard_index);
+    void runShard(Shard& shard);
+    // 唤醒分片线程（stop、收件箱有新数据报）
+    void wakeShard(Shard& shard);
+    // 解码收件箱里其他分片转交的数据报
+    void decodeInbox(Shard& shard);
+    // 负责解码该数据报所属流的分片
+    Shard& ownerOf(Shard& receiver, const char* data, size_t len);
+};
@@ -0,0 +1,218 @@
+﻿#include "Retransmission.h"
+#include <QMutexLocker>
+#include <algorithm>
+
+// ---- 发送端历史缓存 ----
+
+void PacketHistory::reset(size_t capacity) {
+    QMutexLocker lock(&mutex);
+    slots.clear();
+    slots.resize(std::max<size_t>(capacity, 1));
+}
+
+void PacketHistory::store(uint32_t seq, const char* datagram, size_t len, bool is_media, int64_t now_us) {
+    QMutexLocker lock(&mutex);
+    Slot& slot = slots[seq % slots.size()];
+    slot.used = true;
+    slot.is_media = is_media;
+    slot.seq = seq;
+    slot.send_us = now_us;
+    slot.last_retransmit_us = -1;
+    slot.retransmissions = 0;
+    slot.len = len;
+    slot.data.assign(datagram, datagram + len);
+}
+
+PacketHistory::Result PacketHistory::take(uint32_t seq, int64_t now_us, int64_t rtt_us, RepairBudget* budget, std::vector<char>* out) {
+    QMutexLocker lock(&mutex);
+    Slot& slot = slots[seq % slots.size()];
+    if (!slot.used || slot.seq != seq) return Result::NotInHistory;
+    if (now_us - slot.send_us > std::max<int64_t>(kMinAgeUs, kMinAgeRtt * rtt_us)) return Result::NotInHistory;
+    if (!slot.is_media) return Result::Parity;
+    if (slot.retransmissions >= kMaxRetransmissions) return Result::Exhausted;
+    if (slot.last_retransmit_us >= 0 && now_us - slot.last_retransmit_us < rtt_us) return Result::TooSoon;
+    if (budget && !budget->tryRetransmit(slot.len)) return Result::OverBudget;
+
+    slot.last_retransmit_us = now_us;
+    slot.retransmissions++;
+    out->assign(slot.data.begin(), slot.data.begin() + static_cast<std::ptrdiff_t>(slot.len));
+    return Result::Ok;
+}
+
+// ---- 发送端重传计数 ----
+
+void RetransmissionCounters::reset() {
+    nack_reports.store(0);
+    requested.store(0);
+    queued.store(0);
+    not_in_history.store(0);
+    too_soon.store(0);
+    exhausted.store(0);
+    parity_skipped.store(0);
+    budget_denied.store(0);
+}
+
+RetransmissionSnapshot RetransmissionCounters::snapshot() const {
+    RetransmissionSnapshot snapshot;
+    snapshot.active = true;
+    snapshot.nack_reports = nack_reports.load(std::memory_order_relaxed);
+    snapshot.requested = requested.load(std::memory_order_relaxed);
+    snapshot.queued = queued.load(std::memory_order_relaxed);
+    snapshot.not_in_history = not_in_history.load(std::memory_order_relaxed);
+    snapshot.too_soon = too_soon.load(std::memory_order_relaxed);
+    snapshot.exhausted = exhausted.load(std::memory_order_relaxed);
+    snapshot.parity_skipped = parity_skipped.load(std::memory_order_relaxed);
+    snapshot.budget_denied = budget_denied.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+// ---- 冗余与重传的共用预算 ----
+
+void RepairBudget::reset(double new_ratio) {
+    QMutexLocker lock(&mutex);
+    ratio = std::max(0.0, new_ratio);
+    balance = 0;
+}
+
+void RepairBudget::onMedia(size_t bytes) {
+    QMutexLocker lock(&mutex);
+    balance = std::min(balance + static_cast<double>(bytes) * ratio, kMaxBurstBytes);
+}
+
+void RepairBudget::onParity(size_t bytes) {
+    QMutexLocker lock(&mutex);
+    balance = std::max(balance - static_cast<double>(bytes), -kMaxBurstBytes);
+}
+
+bool RepairBudget::tryRetransmit(size_t bytes) {
+    QMutexLocker lock(&mutex);
+    if (balance < static_cast<double>(bytes)) return false;
+    balance -= static_cast<double>(bytes);
+    return true;
+}
+
+// ---- 接收端重传请求 ----
+
+void NackStats::accumulate(const NackStats& other) {
+    reports += other.reports;
+    requests += other.requests;
+    repaired += other.repaired;
+    reordered += other.reordered;
+    fec_repaired += other.fec_repaired;
+    abandoned += other.abandoned;
+    overflow += other.overflow;
+    rtt_ms = std::max(rtt_ms, other.rtt_ms);
+}
+
+NackGenerator::NackGenerator(const NackConfig& config) : config(config), seen(kSeenRingSize) {
+    std::fill(std::begin(newest_group), std::end(newest_group), -1);
+}
+
+bool NackGenerator::onPacket(uint32_t seq, uint8_t stream_type, int64_t group_id, int64_t now_ms) {
+    int64_t unwrapped = unwrapper.Unwrap(seq);
+    // 大幅倒退说明发送端重新开始计数，之前的缺口都不会再补上
+    if (started && unwrapped < newest_seq - static_cast<int64_t>(kSeenRingSize)) {
+        nack_stats.abandoned += missing.size();
+        missing.clear();
+        std::fill(seen.begin(), seen.end(), Seen());
+        std::fill(std::begin(newest_group), std::end(newest_group), -1);
+        unwrapper.Reset();
+        unwrapped = unwrapper.Unwrap(seq);
+        started = false;
+    }
+    Seen& slot = seen[static_cast<size_t>(unwrapped % static_cast<int64_t>(kSeenRingSize))];
+    slot.seq = unwrapped;
+    slot.stream_type = stream_type;
+    slot.group_id = group_id;
+    newest_group[stream_type] = std::max(newest_group[stream_type], group_id);
+
+    if (!started) {
+        started = true;
+        newest_seq = unwrapped;
+        return false;
+    }
+    if (unwrapped > newest_seq) {
+        // 新的缺口：只记录最近 max_pending 个
+        const int64_t first = std::max(newest_seq + 1, unwrapped - static_cast<int64_t>(config.max_pending));
+        nack_stats.overflow += static_cast<uint64_t>(first - (newest_seq + 1));
+        for (int64_t missing_seq = first; missing_seq < unwrapped; ++missing_seq) {
+            missing.emplace(missing_seq, Missing{ now_ms, -1, 0 });
+        }
+        while (missing.size() > config.max_pending) {
+            missing.erase(missing.begin());
+            nack_stats.overflow++;
+        }
+        newest_seq = unwrapped;
+        return false;
+    }
+    auto it = missing.find(unwrapped);
+    if (it == missing.end()) return false; // 重复的副本或早已放弃的缺口
+    const bool requested = it->second.retries > 0;
+    if (requested) {
+        nack_stats.repaired++;
+        if (it->second.retries == 1) {
+            const double sample = static_cast<double>(now_ms - it->second.sent_ms);
+            nack_stats.rtt_ms = nack_stats.rtt_ms > 0 ? nack_stats.rtt_ms + (sample - nack_stats.rtt_ms) / 8 : sample;
+        }
+    }
+    else {
+        nack_stats.reordered++;
+    }
+    missing.erase(it);
+    return requested;
+}
+
+const NackGenerator::Seen* NackGenerator::findSeen(int64_t seq) const {
+    if (seq < 0) return nullptr;
+    const Seen& slot = seen[static_cast<size_t>(seq % static_cast<int64_t>(kSeenRingSize))];
+    return slot.seq == seq ? &slot : nullptr;
+}
+
+const NackGenerator::Seen* NackGenerator::nearestSeen(int64_t seq, int direction) const {
+    for (int distance = 1; distance <= kNeighbourSearch; ++distance) {
+        const int64_t candidate = seq + direction * distance;
+        if (candidate > newest_seq) break;
+        if (const Seen* slot = findSeen(candidate)) return slot;
+    }
+    return nullptr;
+}
+
+int64_t NackGenerator::retryIntervalMs() const {
+    return nack_stats.rtt_ms > 0 ? static_cast<int64_t>(nack_stats.rtt_ms) + config.reorder_wait_ms : config.default_rtt_ms;
+}
+
+void NackGenerator::collect(int64_t now_ms, const GroupComplete& group_complete, std::vector<uint32_t>* out, size_t max_count) {
+    const int64_t retry_ms = retryIntervalMs();
+    for (auto it = missing.begin(); it != missing.end() && out->size() < max_count;) {
+        Missing& entry = it->second;
+        const int64_t age_ms = now_ms - entry.detected_ms;
+        if (age_ms > config.max_age_ms || entry.retries >= config.max_retries) {
+            nack_stats.abandoned++;
+            it = missing.erase(it);
+            continue;
+        }
+        if (age_ms < config.reorder_wait_ms || (entry.sent_ms >= 0 && now_ms - entry.sent_ms < retry_ms)) {
+            ++it;
+            continue;
+        }
+        // 缺口两侧属于同一个组：组已完整就不用请求，组可能还在等冗余包时先等一等
+        const Seen* below = nearestSeen(it->first, -1);
+        const Seen* above = nearestSeen(it->first, 1);
+        if (below && above && below->stream_type == above->stream_type && below->group_id == above->group_id) {
+            if (group_complete && group_complete(below->stream_type, below->group_id)) {
+                nack_stats.fec_repaired++;
+                it = missing.erase(it);
+                continue;
+            }
+            if (entry.retries == 0 && below->group_id == newest_group[below->stream_type] && age_ms < config.fec_wait_ms) {
+                ++it;
+                continue;
+            }
+        }
+        out->push_back(static_cast<uint32_t>(it->first));
+        entry.sent_ms = now_ms;
+        entry.retries++;
+        nack_stats.requests++;
+        ++it;
+    }
+}
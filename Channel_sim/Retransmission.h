@@ -0,0 +1,166 @@
+﻿#pragma once
+#include <QMutex>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+
+#include "rtc_base/numerics/sequence_number_unwrapper.h"
+#include "ChannelMetrics.h"
+
+// 选择性重传（NACK）：FEC 恢复不了的丢包由接收端按全局序列号（v2 尾部的32位 seq，v1 只有低8位，不支持）
+// 请求重传。发送端的历史缓存参照 modules/rtp_rtcp/source/rtp_packet_history，接收端的请求列表参照
+// modules/video_coding/nack_requester；vendored 的实现依赖 api/units 和任务队列，这里只保留逻辑。
+
+class RepairBudget;
+
+// 发送端：按全局序列号保存最近发出（含模拟丢弃）的数据报原样字节，重传时 CRC 和尾部都不变。
+// 固定槽位环（seq 取模），槽位缓冲区循环复用；超过 max_age 的包视为已不在缓存中。
+// 发送线程调用 store，反馈线程调用 take，内部加锁
+class PacketHistory {
+public:
+    static constexpr size_t kDefaultCapacity = 8192;
+    static constexpr int64_t kMinAgeUs = 1000000; // 至少保留 1 秒，RTT 较大时保留 3 个 RTT
+    static constexpr int kMinAgeRtt = 3;
+    static constexpr int kMaxRetransmissions = 10;
+
+    enum class Result {
+        Ok,
+        NotInHistory, // 太老或槽位已被新包覆盖
+        TooSoon,      // 距上次重传不到 min_interval，视为重复请求
+        Exhausted,    // 已达最大重传次数
+        Parity,       // 冗余包，不重传
+        OverBudget,   // 预算不足
+    };
+
+    explicit PacketHistory(size_t capacity = kDefaultCapacity) { reset(capacity); }
+
+    // 只能在发送线程和反馈线程都停止时调用
+    void reset(size_t capacity);
+    void store(uint32_t seq, const char* datagram, size_t len, bool is_media, int64_t now_us);
+    // 取出一个包准备重传，成功时复制到 out。rtt_us 用于重传间隔和保留时长，未知时传 0；
+    // budget 不为空时先扣减预算，不足时不计入重传次数
+    Result take(uint32_t seq, int64_t now_us, int64_t rtt_us, RepairBudget* budget, std::vector<char>* out);
+
+private:
+    struct Slot {
+        bool used = false;
+        bool is_media = false;
+        uint32_t seq = 0;
+        int64_t send_us = 0;
+        int64_t last_retransmit_us = -1;
+        int retransmissions = 0;
+        size_t len = 0;
+        std::vector<char> data; // 容量随槽位复用
+    };
+
+    QMutex mutex;
+    std::vector<Slot> slots;
+};
+
+// 发送端的重传计数：反馈线程更新，统计快照随时读取
+struct RetransmissionCounters {
+    std::atomic<uint64_t> nack_reports{ 0 };
+    std::atomic<uint64_t> requested{ 0 };
+    std::atomic<uint64_t> queued{ 0 };
+    std::atomic<uint64_t> not_in_history{ 0 };
+    std::atomic<uint64_t> too_soon{ 0 };
+    std::atomic<uint64_t> exhausted{ 0 };
+    std::atomic<uint64_t> parity_skipped{ 0 };
+    std::atomic<uint64_t> budget_denied{ 0 };
+
+    void reset();
+    RetransmissionSnapshot snapshot() const;
+};
+
+// 冗余包和重传共用的带宽预算：每发出一个字节源数据积累 ratio 字节额度，冗余包（主动保护）照常发送并扣减额度，
+// 重传只在额度足够时才发。额度上下限为 ±kMaxBurstBytes：长时间没有丢包后不会一次放出大量重传，
+// 冗余本身超出预算时也不会永远欠账
+class RepairBudget {
+public:
+    static constexpr double kMaxBurstBytes = 256 * 1024;
+
+    void reset(double ratio);
+    void onMedia(size_t bytes);
+    void onParity(size_t bytes);
+    bool tryRetransmit(size_t bytes);
+
+private:
+    QMutex mutex;
+    double ratio = 0;
+    double balance = 0;
+};
+
+struct NackConfig {
+    int reorder_wait_ms = 10;  // 发现缺口后等这么久再请求，避开通道间的乱序
+    int fec_wait_ms = 100;     // 缺口所在的组还是该流最新的组时（冗余包可能还没到），最多为 FEC 多等这么久
+    int default_rtt_ms = 100;  // 还没有往返时间样本时的重传请求间隔
+    int max_retries = 10;
+    int max_age_ms = 1000;     // 超过这个时间的缺口不再请求（应小于 FecReceiverConfig::hold_ms）
+    size_t max_pending = 1000; // 缺失列表上限，超出时丢弃最老的
+};
+
+struct NackStats {
+    uint64_t reports = 0;       // 发出的重传请求报文
+    uint64_t requests = 0;      // 请求的序列号（含重复请求）
+    uint64_t repaired = 0;      // 请求后收到（重传或晚到的原包）
+    uint64_t reordered = 0;     // 请求前就收到了（通道间乱序）
+    uint64_t fec_repaired = 0;  // 所在组已由 FEC 恢复，不再请求
+    uint64_t abandoned = 0;     // 超过重试次数或时限仍未收到
+    uint64_t overflow = 0;      // 缺失列表满时丢弃的
+    double rtt_ms = 0;          // 第一次请求到收到重传的平滑时间
+
+    void accumulate(const NackStats& other);
+};
+
+// 接收端：按全局序列号发现缺口并生成重传请求。所有通道的数据报必须交给同一个实例（序列号跨通道连续）。
+// 混合模式：缺口两侧最近收到的包属于同一个组时，认为缺失的包也在该组里，组已完整（收到或由冗余包恢复）
+// 就不再请求；组还是该流最新的组时给冗余包留 fec_wait_ms。跨组的缺口无法判断所属组，直接请求。
+// 不是线程安全的，应由单个接收线程调用。
+class NackGenerator {
+public:
+    // 查询某个流的组是否已完整
+    using GroupComplete = std::function<bool(uint8_t stream_type, int64_t group_id)>;
+
+    explicit NackGenerator(const NackConfig& config = NackConfig());
+
+    // 收到一个通过校验的数据报。返回 true 表示它填补了已经请求过重传的缺口（重传或晚到的原包），
+    // 这时它的发送时刻不能用于时延估计
+    bool onPacket(uint32_t seq, uint8_t stream_type, int64_t group_id, int64_t now_ms);
+    // 到期需要请求的序列号追加到 out，最多 max_count 个
+    void collect(int64_t now_ms, const GroupComplete& group_complete, std::vector<uint32_t>* out, size_t max_count);
+    void onReportSent() { nack_stats.reports++; }
+
+    const NackStats& stats() const { return nack_stats; }
+    size_t pending() const { return missing.size(); }
+
+private:
+    static constexpr size_t kSeenRingSize = 4096; // 记录最近收到的包所属的组，用于判断缺口所在的组
+    static constexpr int kNeighbourSearch = 64;   // 向两侧查找已收到的包的最大距离
+
+    struct Missing {
+        int64_t detected_ms = 0;
+        int64_t sent_ms = -1;
+        int retries = 0;
+    };
+    struct Seen {
+        int64_t seq = -1;
+        uint8_t stream_type = 0;
+        int64_t group_id = 0;
+    };
+
+    const Seen* findSeen(int64_t seq) const;
+    const Seen* nearestSeen(int64_t seq, int direction) const;
+    int64_t retryIntervalMs() const;
+
+    NackConfig config;
+    webrtc::SeqNumUnwrapper<uint32_t> unwrapper;
+    bool started = false;
+    int64_t newest_seq = 0;
+    std::map<int64_t, Missing> missing; // 按展开后的序列号
+    std::vector<Seen> seen;
+    int64_t newest_group[256];
+    NackStats nack_stats;
+};
@@ -0,0 +1,208 @@
+﻿#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+// 通道队列的出队顺序（同一个类别内的各流之间）
+enum class QueueOrdering : int {
+    Fifo = 0,             // 按入队顺序
+    EarliestDeadline = 1, // 各流之间按道头包的截止时刻，最早的先发，没有截止时刻的排在最后
+};
+
+// 通道队列的优先级类别，按轮询的先后排列
+enum class QueueClass : int {
+    Critical = 0,   // 关键源包（负载分类器标为 Critical）
+    Retransmit = 1, // 应重传请求重发的包，已经晚了一个 RTT
+    Media = 2,      // 普通源包
+    Parity = 3,     // 冗余包
+};
+constexpr int kQueueClassCount = 4;
+
+inline const char* queueClassName(QueueClass queue_class) {
+    switch (queue_class) {
+    case QueueClass::Critical: return "critical";
+    case QueueClass::Retransmit: return "retransmit";
+    case QueueClass::Media: return "media";
+    case QueueClass::Parity: return "parity";
+    }
+    return "unknown";
+}
+
+// 各类别的权重：按加权轮询出队，一轮里类别最多连续发 weight 个包。权重为 0 的类别只在其他类别都空时发送
+struct QueueClassWeights {
+    std::array<int, kQueueClassCount> weight{ { 8, 4, 4, 1 } };
+};
+
+// 通道发送队列，参照 modules/pacing/prioritized_packet_queue：先按类别、类别内再按流分成先进先出的道。
+// vendored 的实现是严格优先级（高优先级有包时低优先级一直等），这里改为可配置权重的加权轮询，
+// 避免冗余包长期排不上导致整组无法恢复。类别数固定为 4，流数通常只有几个，取包是常数开销。
+// 包的截止时刻（deadline_ns，0 表示不限）在入队时确定，同一个流同一类别的包按入队顺序截止，
+// 过期的包总是先出现在道头，出队时逐个丢弃，每个 O(1)。插到队首的包（故障切换迁来的、取出后放回的）
+// 在所在类别内最先发出。
+// 不是线程安全的，由通道的队列锁保护。T 需要有 queue_class、stream_type 和 deadline_ns 成员。
+template <typename T>
+class PrioritizedSendQueue {
+public:
+    PrioritizedSendQueue() {
+        for (auto& lane_index : lane_of) std::fill(std::begin(lane_index), std::end(lane_index), -1);
+    }
+
+    void setOrdering(QueueOrdering value) { ordering = value; }
+    QueueOrdering getOrdering() const { return ordering; }
+    void setWeights(const QueueClassWeights& value) {
+        weights = value;
+        current_class = kQueueClassCount - 1;
+        credit = 0;
+    }
+
+    void push_back(T&& item) {
+        const int queue_class = static_cast<int>(item.queue_class);
+        laneFor(queue_class, item.stream_type).push_back({ next_back++, std::move(item) });
+        ++class_size[queue_class];
+        ++count;
+    }
+
+    void push_front(T&& item) {
+        const int queue_class = static_cast<int>(item.queue_class);
+        laneFor(queue_class, item.stream_type).push_front({ --next_front, std::move(item) });
+        ++class_size[queue_class];
+        ++count;
+    }
+
+    // 取出下一个未过期（now_ns 未超过截止时刻）的包，队列已空时返回 false；途中丢弃的过期包追加到 expired
+    bool pop(int64_t now_ns, T* out, std::vector<T>* expired) {
+        while (count > 0) {
+            const int queue_class = nextClass();
+            Lane& lane = lanes[queue_class][pickLane(queue_class)];
+            T item = std::move(lane.front().item);
+            lane.pop_front();
+            --class_size[queue_class];
+            --count;
+            if (item.deadline_ns > 0 && now_ns > item.deadline_ns) {
+                expired->push_back(std::move(item));
+                continue;
+            }
+            --credit;
+            *out = std::move(item);
+            return true;
+        }
+        return false;
+    }
+
+    // 按入队顺序取出全部包（故障切换），队列清空
+    void takeAll(std::vector<T>* out) {
+        std::vector<Entry> entries;
+        entries.reserve(count);
+        for (auto& class_lanes : lanes) {
+            for (Lane& lane : class_lanes) {
+                std::move(lane.begin(), lane.end(), std::back_inserter(entries));
+                lane.clear();
+            }
+        }
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.order < b.order; });
+        for (Entry& entry : entries) out->push_back(std::move(entry.item));
+        class_size.fill(0);
+        count = 0;
+    }
+
+    // 只读遍历，顺序不保证
+    template <typename F>
+    void forEach(F&& visit) const {
+        for (const auto& class_lanes : lanes) {
+            for (const Lane& lane : class_lanes) {
+                for (const Entry& entry : lane) visit(entry.item);
+            }
+        }
+    }
+
+    size_t size() const { return count; }
+    size_t size(QueueClass queue_class) const { return class_size[static_cast<size_t>(queue_class)]; }
+    bool empty() const { return count == 0; }
+
+    void clear() {
+        for (auto& class_lanes : lanes) {
+            for (Lane& lane : class_lanes) lane.clear();
+        }
+        class_size.fill(0);
+        count = 0;
+        next_back = 0;
+        next_front = 0;
+        current_class = kQueueClassCount - 1;
+        credit = 0;
+    }
+
+private:
+    struct Entry {
+        int64_t order; // 入队顺序：队尾递增，队首递减
+        T item;
+    };
+    using Lane = std::deque<Entry>;
+
+    Lane& laneFor(int queue_class, uint8_t stream_type) {
+        int& lane_index = lane_of[queue_class][stream_type];
+        if (lane_index < 0) {
+            lane_index = static_cast<int>(lanes[queue_class].size());
+            lanes[queue_class].emplace_back();
+        }
+        return lanes[queue_class][static_cast<size_t>(lane_index)];
+    }
+
+    // 加权轮询：当前类别还有额度和包时继续，否则转到下一个有包且权重大于 0 的类别并补足额度；
+    // 只剩权重为 0 的类别有包时按类别顺序发送。队列非空时调用
+    int nextClass() {
+        if (credit > 0 && class_size[static_cast<size_t>(current_class)] > 0) return current_class;
+        for (int step = 1; step <= kQueueClassCount; ++step) {
+            const int candidate = (current_class + step) % kQueueClassCount;
+            if (class_size[static_cast<size_t>(candidate)] > 0 && weights.weight[static_cast<size_t>(candidate)] > 0) {
+                current_class = candidate;
+                credit = weights.weight[static_cast<size_t>(candidate)];
+                return candidate;
+            }
+        }
+        credit = 0;
+        for (int candidate = 0; candidate < kQueueClassCount; ++candidate) {
+            if (class_size[static_cast<size_t>(candidate)] > 0) return candidate;
+        }
+        return 0;
+    }
+
+    // 类别内选道，该类别非空时调用
+    size_t pickLane(int queue_class) const {
+        const std::vector<Lane>& class_lanes = lanes[queue_class];
+        size_t best = class_lanes.size();
+        int64_t best_deadline = 0;
+        for (size_t i = 0; i < class_lanes.size(); ++i) {
+            if (class_lanes[i].empty()) continue;
+            const Entry& head = class_lanes[i].front();
+            // 插到队首的包不参与截止时刻比较，按插入顺序最先发出
+            int64_t deadline = std::numeric_limits<int64_t>::max();
+            if (head.order < 0) {
+                deadline = std::numeric_limits<int64_t>::min();
+            }
+            else if (ordering == QueueOrdering::EarliestDeadline && head.item.deadline_ns > 0) {
+                deadline = head.item.deadline_ns;
+            }
+            if (best == class_lanes.size() || deadline < best_deadline ||
+                (deadline == best_deadline && head.order < class_lanes[best].front().order)) {
+                best = i;
+                best_deadline = deadline;
+            }
+        }
+        return best;
+    }
+
+    QueueOrdering ordering = QueueOrdering::Fifo;
+    QueueClassWeights weights;
+    std::vector<Lane> lanes[kQueueClassCount];
+    int lane_of[kQueueClassCount][256]; // (类别, stream_type) -> lanes 下标，-1 表示还没有这条道
+    std::array<size_t, kQueueClassCount> class_size{};
+    size_t count = 0;
+    int64_t next_back = 0;
+    int64_t next_front = 0;
+    int current_class = kQueueClassCount - 1; // 新一轮从 Critical 开始
+    int credit = 0; // 当前类别在这一轮还能发的包数
+};
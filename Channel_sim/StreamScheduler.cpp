@@ -0,0 +1,57 @@
+﻿#include "StreamScheduler.h"
+#include <algorithm>
+
+WfqScheduler::Level& WfqScheduler::levelOf(int priority) {
+    for (Level& level : levels) {
+        if (level.priority == priority) return level;
+    }
+    levels.push_back({ priority, 0.0 });
+    return levels.back();
+}
+
+int WfqScheduler::addFlow(int priority, double weight) {
+    Flow flow;
+    flow.priority = priority;
+    flow.weight = weight > 0 ? weight : 1.0;
+    flow.start_tag = levelOf(priority).virtual_time;
+    flows.push_back(flow);
+    return static_cast<int>(flows.size()) - 1;
+}
+
+void WfqScheduler::clear() {
+    flows.clear();
+    levels.clear();
+}
+
+void WfqScheduler::setBacklogged(int flow, bool backlogged) {
+    Flow& f = flows[static_cast<size_t>(flow)];
+    if (backlogged && !f.backlogged) {
+        // 空闲期间的份额作废，从当前虚拟时间重新开始
+        f.start_tag = std::max(f.start_tag, levelOf(f.priority).virtual_time);
+    }
+    f.backlogged = backlogged;
+}
+
+int WfqScheduler::next() const {
+    int best = -1;
+    for (size_t i = 0; i < flows.size(); ++i) {
+        const Flow& f = flows[i];
+        if (!f.backlogged) continue;
+        if (best < 0) {
+            best = static_cast<int>(i);
+            continue;
+        }
+        const Flow& b = flows[static_cast<size_t>(best)];
+        if (f.priority > b.priority || (f.priority == b.priority && f.start_tag < b.start_tag)) {
+            best = static_cast<int>(i);
+        }
+    }
+    return best;
+}
+
+void WfqScheduler::charge(int flow, size_t bytes) {
+    Flow& f = flows[static_cast<size_t>(flow)];
+    Level& level = levelOf(f.priority);
+    level.virtual_time = std::max(level.virtual_time, f.start_tag);
+    f.start_tag += static_cast<double>(bytes) / f.weight;
+}
@@ -0,0 +1,55 @@
+﻿#pragma once
+#include <QString>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 多路流复用：同一组通道上同时发送多个文件或直播流（遥测、视频等）。
+// 每个流有自己的 FEC 编码器状态，数据报尾部的 stream_type 标识所属流，接收端据此分流解码。
+struct StreamConfig {
+    uint8_t stream_type = 0x01; // 线上的流标识，各流必须不同
+    QString source;             // 文件路径或直播源 URI（见 InputSource::create）
+    int priority = 0;           // 数值大的优先级高：有数据时严格优先于低优先级的流
+    double weight = 1.0;        // 同一优先级内按权重分享发送速率
+    unsigned int sys_word = 0;  // 试飞院头中的系统标识
+    int deadline_ms = 0;        // 包在通道队列里最多等这么久，超过就丢弃（应不超过接收端的播出延迟）；0 时取 Udpserver::setQueueDeadline
+};
+
+// 加权公平队列（按起始时间标签的 SFQ 实现）：先选有数据的最高优先级，
+// 同一优先级内选起始标签最小的流；流发送 L 字节后标签前进 L / weight。
+// 长期来看同一优先级内各流的发送量与权重成正比，空闲的流重新有数据时不会补发积攒的份额。
+// 不是线程安全的，由读取线程单独使用。
+class WfqScheduler {
+public:
+    // 添加一个流，返回其下标
+    int addFlow(int priority, double weight);
+    void clear();
+
+    // 流是否有数据可发：文件读完或直播源暂时没有数据时置为 false
+    void setBacklogged(int flow, bool backlogged);
+    bool isBacklogged(int flow) const { return flows[static_cast<size_t>(flow)].backlogged; }
+
+    // 下一个应该发送的流，没有流有数据时返回 -1
+    int next() const;
+    // 记录 flow 发送了 bytes 字节
+    void charge(int flow, size_t bytes);
+
+    size_t flowCount() const { return flows.size(); }
+
+private:
+    struct Flow {
+        int priority = 0;
+        double weight = 1.0;
+        double start_tag = 0;   // 下一个包的起始标签
+        bool backlogged = true;
+    };
+    struct Level {
+        int priority = 0;
+        double virtual_time = 0; // 最近一次服务的起始标签
+    };
+
+    std::vector<Flow> flows;
+    std::vector<Level> levels;
+
+    Level& levelOf(int priority);
+};
@@ -0,0 +1,169 @@
+﻿#include "Tracer.h"
+#include <QCoreApplication>
+#include <QMutex>
+#include <QSaveFile>
+#include <QThread>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+thread_local bool Tracer::sampled = false;
+thread_local uint32_t Tracer::iteration_counter = 0;
+
+// 单写多读的覆盖式环形缓冲区：写线程写完一个槽位后再推进 write_pos，
+// 读线程根据读前后的 write_pos 判断哪些槽位在拷贝期间没有被覆盖
+struct TraceRing {
+    TraceEvent events[Tracer::kRingCapacity];
+    std::atomic<uint64_t> write_pos{ 0 };
+    int thread_index = 0;
+    QString thread_name;
+    std::atomic<bool> in_use{ true };
+};
+
+namespace {
+
+// 线程退出时释放缓冲区，同名的新线程（下一次开始发送时的工作线程）会接着使用
+struct RingHandle {
+    TraceRing* ring = nullptr;
+    ~RingHandle() {
+        if (ring) ring->in_use.store(false, std::memory_order_release);
+    }
+};
+thread_local RingHandle tls_ring;
+
+// JSON 字符串转义（名称都是字面量，一般不需要，但线程名来自 objectName）
+QByteArray jsonString(const QString& text) {
+    QByteArray out = "\"";
+    for (QChar ch : text) {
+        if (ch == '"' || ch == '\\') {
+            out += '\\';
+            out += static_cast<char>(ch.unicode());
+        }
+        else if (ch.unicode() < 0x20) {
+            out += "\\u00" + QByteArray::number(ch.unicode(), 16).rightJustified(2, '0');
+        }
+        else {
+            out += QString(ch).toUtf8();
+        }
+    }
+    out += '"';
+    return out;
+}
+
+} // namespace
+
+struct Tracer::Impl {
+    QMutex mutex;
+    // 线程退出后缓冲区仍然保留，以便停止发送之后再导出
+    std::vector<std::unique_ptr<TraceRing>> rings;
+};
+
+Tracer& Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+Tracer::Tracer() : impl(new Impl()) {
+}
+
+Tracer::~Tracer() {
+    delete impl;
+}
+
+void Tracer::start(int period) {
+    setSamplingPeriod(period);
+    enabled.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::stop() {
+    enabled.store(false, std::memory_order_relaxed);
+}
+
+void Tracer::setSamplingPeriod(int period) {
+    sampling_period.store(std::max(1, period), std::memory_order_relaxed);
+}
+
+void Tracer::record(const TraceEvent& event) {
+    if (!tls_ring.ring) {
+        tls_ring.ring = instance().acquireRing();
+    }
+    TraceRing& ring = *tls_ring.ring;
+    const uint64_t position = ring.write_pos.load(std::memory_order_relaxed);
+    ring.events[position & (kRingCapacity - 1)] = event;
+    ring.write_pos.store(position + 1, std::memory_order_release);
+}
+
+// 第一次记录时调用：优先复用同名线程留下的缓冲区，避免反复启停发送后内存不断增长
+TraceRing* Tracer::acquireRing() {
+    QThread* thread = QThread::currentThread();
+    const QString name = thread ? thread->objectName() : QString();
+    QMutexLocker lock(&impl->mutex);
+    if (!name.isEmpty()) {
+        for (const std::unique_ptr<TraceRing>& ring : impl->rings) {
+            if (ring->thread_name == name && !ring->in_use.load(std::memory_order_acquire)) {
+                ring->in_use.store(true, std::memory_order_relaxed);
+                return ring.get();
+            }
+        }
+    }
+    auto ring = std::make_unique<TraceRing>();
+    ring->thread_index = static_cast<int>(impl->rings.size()) + 1;
+    ring->thread_name = name.isEmpty() ? QStringLiteral("Thread_%1").arg(ring->thread_index) : name;
+    impl->rings.push_back(std::move(ring));
+    return impl->rings.back().get();
+}
+
+bool Tracer::writeChromeJson(const QString& path) {
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    const qint64 pid = QCoreApplication::applicationPid();
+    QByteArray out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    bool first = true;
+    auto separator = [&]() {
+        if (!first) out += ",\n";
+        first = false;
+    };
+
+    QMutexLocker lock(&impl->mutex);
+    std::vector<TraceEvent> events;
+    for (const std::unique_ptr<TraceRing>& ring : impl->rings) {
+        const uint64_t end = ring->write_pos.load(std::memory_order_acquire);
+        const uint64_t begin = end > kRingCapacity ? end - kRingCapacity : 0;
+        events.clear();
+        events.reserve(static_cast<size_t>(end - begin));
+        for (uint64_t i = begin; i < end; ++i) {
+            events.push_back(ring->events[i & (kRingCapacity - 1)]);
+        }
+        // 拷贝期间被写线程覆盖的槽位丢弃；写线程此刻可能正在写序号 after 的槽位，它与 after - kRingCapacity 同槽
+        const uint64_t after = ring->write_pos.load(std::memory_order_acquire);
+        const uint64_t first_valid = after >= kRingCapacity ? after - kRingCapacity + 1 : 0;
+        const size_t skip = static_cast<size_t>(std::min<uint64_t>(end, std::max(begin, first_valid)) - begin);
+
+        separator();
+        out += "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" + QByteArray::number(pid) +
+            ",\"tid\":" + QByteArray::number(ring->thread_index) +
+            ",\"args\":{\"name\":" + jsonString(ring->thread_name) + "}}";
+        for (size_t i = skip; i < events.size(); ++i) {
+            const TraceEvent& event = events[i];
+            separator();
+            out += "{\"ph\":\"X\",\"cat\":\"";
+            out += event.category;
+            out += "\",\"name\":\"";
+            out += event.name;
+            out += "\",\"pid\":" + QByteArray::number(pid) + ",\"tid\":" + QByteArray::number(ring->thread_index) +
+                ",\"ts\":" + QByteArray::number(event.start_ns / 1000.0, 'f', 3) +
+                ",\"dur\":" + QByteArray::number(event.duration_ns / 1000.0, 'f', 3);
+            if (event.has_arg) {
+                out += ",\"args\":{\"value\":" + QByteArray::number(static_cast<qlonglong>(event.arg)) + "}";
+            }
+            out += '}';
+        }
+        file.write(out);
+        out.clear();
+    }
+    out += "\n]}\n";
+    file.write(out);
+    return file.commit();
+}
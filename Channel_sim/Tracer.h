@@ -0,0 +1,121 @@
+﻿#pragma once
+#include <QString>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// 热路径追踪：记录各阶段（读文件、FEC编码、入队、限速、sendto……）的起止时间，
+// 导出为 Chrome trace JSON，可直接在 chrome://tracing 或 ui.perfetto.dev 中打开。
+//
+// 每个线程一个固定大小的环形缓冲区，写满后覆盖最旧的事件（只保留最近的一段），写入无锁。
+// 采样以"一轮循环"为单位：线程在每轮循环开头调用 TRACE_ITERATION()，
+// 决定本轮的所有 TRACE_SCOPE 是否记录，这样同一个包的各阶段要么都在、要么都不在。
+// 关闭时每个作用域只多一次线程局部变量的判断。
+
+struct TraceRing;
+
+// 编译期开关，定义 CHSIM_DISABLE_TRACING 后所有宏为空
+#if defined(CHSIM_DISABLE_TRACING)
+#define TRACE_ITERATION() do {} while (0)
+#define TRACE_SCOPE(category, name) do {} while (0)
+#define TRACE_SCOPE_ARG(category, name, arg) do {} while (0)
+#else
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_ITERATION() Tracer::beginIteration()
+// category 和 name 必须是字面量（只保存指针）
+#define TRACE_SCOPE(category, name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(category, name)
+#define TRACE_SCOPE_ARG(category, name, arg) \
+    TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(category, name, static_cast<int64_t>(arg))
+#endif
+
+struct TraceEvent {
+    int64_t start_ns = 0;
+    int64_t duration_ns = 0;
+    const char* category = nullptr;
+    const char* name = nullptr;
+    int64_t arg = 0;
+    bool has_arg = false;
+};
+
+class Tracer {
+public:
+    static constexpr int kRingCapacity = 1 << 16; // 每线程事件数，必须是2的幂
+
+    static Tracer& instance();
+
+    // sampling_period 为 N 时每 N 轮循环记录一轮，1 表示全部记录。运行中可随时调用
+    void start(int sampling_period = 1);
+    void stop();
+    void setSamplingPeriod(int period);
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    // 把所有线程缓冲区中的事件写成 Chrome trace JSON。可以在追踪进行中调用，
+    // 正在被覆盖的事件会被跳过
+    bool writeChromeJson(const QString& path);
+
+    // 每轮循环开头调用，决定本轮是否记录
+    static void beginIteration() {
+        Tracer& tracer = instance();
+        if (!tracer.enabled.load(std::memory_order_relaxed)) {
+            sampled = false;
+            return;
+        }
+        sampled = (++iteration_counter % static_cast<uint32_t>(tracer.sampling_period.load(std::memory_order_relaxed))) == 0;
+    }
+    static bool isSampled() { return sampled; }
+
+    static int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static void record(const TraceEvent& event);
+
+private:
+    Tracer();
+    ~Tracer();
+
+    TraceRing* acquireRing();
+
+    static thread_local bool sampled;
+    static thread_local uint32_t iteration_counter;
+
+    struct Impl;
+    Impl* impl;
+    std::atomic<bool> enabled{ false };
+    std::atomic<int> sampling_period{ 1 };
+};
+
+// 作用域计时：构造时记下开始时间，析构时写入一个完整事件
+class TraceScope {
+public:
+    TraceScope(const char* category, const char* name) {
+        if (Tracer::isSampled()) begin(category, name);
+    }
+    TraceScope(const char* category, const char* name, int64_t arg) {
+        if (Tracer::isSampled()) {
+            begin(category, name);
+            event.arg = arg;
+            event.has_arg = true;
+        }
+    }
+    ~TraceScope() {
+        if (event.name) {
+            event.duration_ns = Tracer::nowNs() - event.start_ns;
+            Tracer::record(event);
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    void begin(const char* category, const char* name) {
+        event.category = category;
+        event.name = name;
+        event.start_ns = Tracer::nowNs();
+    }
+
+    TraceEvent event;
+};
@@ -0,0 +1,183 @@
+﻿#include "TsPacketizer.h"
+#include <algorithm>
+#include <cstring>
+
+namespace ts {
+
+bool parsePacket(const uint8_t* ts_packet, PacketFields* fields) {
+    if (ts_packet[0] != kSyncByte) return false;
+    fields->pid = static_cast<uint16_t>(((ts_packet[1] & 0x1F) << 8) | ts_packet[2]);
+    fields->payload_unit_start = (ts_packet[1] & 0x40) != 0;
+    fields->random_access = false;
+    fields->has_pcr = false;
+    fields->pcr = 0;
+
+    const uint8_t adaptation_field_control = (ts_packet[3] >> 4) & 0x03;
+    if (adaptation_field_control != 0x02 && adaptation_field_control != 0x03) {
+        return true;
+    }
+    const uint8_t adaptation_field_length = ts_packet[4];
+    if (adaptation_field_length == 0) return true;
+    const uint8_t flags = ts_packet[5];
+    fields->random_access = (flags & 0x40) != 0;
+    if ((flags & 0x10) != 0 && adaptation_field_length >= 7) {
+        // program_clock_reference_base(33) + reserved(6) + extension(9)
+        const uint8_t* p = ts_packet + 6;
+        const uint64_t base = (static_cast<uint64_t>(p[0]) << 25) | (static_cast<uint64_t>(p[1]) << 17) |
+            (static_cast<uint64_t>(p[2]) << 9) | (static_cast<uint64_t>(p[3]) << 1) | (p[4] >> 7);
+        const uint64_t extension = (static_cast<uint64_t>(p[4] & 0x01) << 8) | p[5];
+        fields->has_pcr = true;
+        fields->pcr = base * 300 + extension;
+    }
+    return true;
+}
+
+bool looksLikeTs(const uint8_t* data, size_t len) {
+    const size_t kProbePackets = 3;
+    if (len < kProbePackets * kPacketSize) return false;
+    for (size_t i = 0; i < kProbePackets; ++i) {
+        if (data[i * kPacketSize] != kSyncByte) return false;
+    }
+    return true;
+}
+
+bool PsiTracker::isPmtPid(uint16_t pid) const {
+    for (int i = 0; i < num_pmt_pids; ++i) {
+        if (pmt_pids[i] == pid) return true;
+    }
+    return false;
+}
+
+void PsiTracker::parsePat(const uint8_t* ts_packet) {
+    // 只处理 payload_unit_start_indicator 置位且无适配域的 PAT 包
+    if ((ts_packet[1] & 0x40) == 0 || ((ts_packet[3] >> 4) & 0x03) != 0x01) return;
+    const uint8_t pointer_field = ts_packet[4];
+    size_t pos = 5 + pointer_field;
+    if (pos + 8 > kPacketSize || ts_packet[pos] != 0x00) return; // table_id 必须是 PAT
+    const size_t section_length = ((ts_packet[pos + 1] & 0x0F) << 8) | ts_packet[pos + 2];
+    const size_t section_end = std::min(pos + 3 + section_length, kPacketSize) - 4; // 去掉 CRC
+    num_pmt_pids = 0;
+    for (size_t p = pos + 8; p + 4 <= section_end && num_pmt_pids < kMaxPmtPids; p += 4) {
+        const uint16_t program_number = static_cast<uint16_t>((ts_packet[p] << 8) | ts_packet[p + 1]);
+        const uint16_t pid = static_cast<uint16_t>(((ts_packet[p + 2] & 0x1F) << 8) | ts_packet[p + 3]);
+        if (program_number != 0) { // program_number 0 是 NIT
+            pmt_pids[num_pmt_pids++] = pid;
+        }
+    }
+}
+
+bool PsiTracker::onPacket(const uint8_t* ts_packet, const PacketFields& fields) {
+    if (fields.pid == kPatPid) {
+        parsePat(ts_packet);
+        return true;
+    }
+    return isPmtPid(fields.pid);
+}
+
+} // namespace ts
+
+TsPacketizer::TsPacketizer(int packets_per_datagram)
+    : packets_per_datagram(std::max(1, std::min(packets_per_datagram, TsChunkInfo::kMaxPackets))) {
+}
+
+void TsPacketizer::append(const uint8_t* data, size_t len) {
+    compact();
+    buffer.insert(buffer.end(), data, data + len);
+}
+
+void TsPacketizer::reset() {
+    buffer.clear();
+    read_pos = 0;
+    psi.reset();
+    resync_count = 0;
+    skipped_bytes = 0;
+}
+
+// 丢掉已读部分，避免缓冲区无限增长
+void TsPacketizer::compact() {
+    if (read_pos == 0) return;
+    if (read_pos >= buffer.size()) {
+        buffer.clear();
+    }
+    else {
+        buffer.erase(buffer.begin(), buffer.begin() + static_cast<std::ptrdiff_t>(read_pos));
+    }
+    read_pos = 0;
+}
+
+// pos 处是否是可信的包起点：当前和下一个包起点都是同步字节；
+// 流末尾（flush）没有下一个包时只检查当前同步字节
+bool TsPacketizer::syncAt(size_t pos, bool flush) const {
+    if (buffer[pos] != ts::kSyncByte) return false;
+    if (pos + ts::kPacketSize < buffer.size()) {
+        return buffer[pos + ts::kPacketSize] == ts::kSyncByte;
+    }
+    return flush;
+}
+
+// 从 read_pos 向后搜索新的同步点，找到返回 true；数据不足时保留尾部等待更多数据
+bool TsPacketizer::resync(bool flush) {
+    const size_t start = read_pos;
+    size_t pos = read_pos + 1;
+    for (; pos + ts::kPacketSize <= buffer.size(); ++pos) {
+        if (syncAt(pos, flush)) break;
+    }
+    if (pos + ts::kPacketSize > buffer.size()) {
+        // 还没找到：最后一个包长度内的候选位置无法验证，留到下次数据到达后再判断
+        pos = flush ? buffer.size() : std::max(start + 1, buffer.size() - ts::kPacketSize);
+        skipped_bytes += pos - start;
+        read_pos = pos;
+        return false;
+    }
+    ++resync_count;
+    skipped_bytes += pos - start;
+    read_pos = pos;
+    return true;
+}
+
+size_t TsPacketizer::pop(uint8_t* out, size_t capacity, TsChunkInfo* info, bool flush) {
+    const size_t max_packets = std::min<size_t>(packets_per_datagram, capacity / ts::kPacketSize);
+    if (max_packets == 0) return 0;
+
+    // 先确认有足够的数据组成一整块，避免重复解析
+    if (!flush && available() < (max_packets + 1) * ts::kPacketSize) {
+        return 0;
+    }
+
+    TsChunkInfo chunk_info;
+    size_t written = 0;
+    while (static_cast<size_t>(chunk_info.num_packets) < max_packets && available() >= ts::kPacketSize) {
+        if (buffer[read_pos] != ts::kSyncByte && !resync(flush)) {
+            break;
+        }
+        if (available() < ts::kPacketSize) break;
+
+        const uint8_t* ts_packet = &buffer[read_pos];
+        ts::PacketFields fields;
+        ts::parsePacket(ts_packet, &fields);
+        const int index = chunk_info.num_packets;
+        chunk_info.pids[index] = fields.pid;
+        chunk_info.has_psi |= psi.onPacket(ts_packet, fields);
+        chunk_info.random_access |= fields.random_access;
+        if (fields.has_pcr && !chunk_info.has_pcr) {
+            chunk_info.has_pcr = true;
+            chunk_info.pcr = fields.pcr;
+            chunk_info.pcr_pid = fields.pid;
+            chunk_info.pcr_packet_index = index;
+        }
+
+        memcpy(out + written, ts_packet, ts::kPacketSize);
+        written += ts::kPacketSize;
+        read_pos += ts::kPacketSize;
+        chunk_info.num_packets++;
+    }
+
+    // 流末尾不足一个包的残余直接丢弃
+    if (flush && available() > 0 && available() < ts::kPacketSize) {
+        skipped_bytes += available();
+        read_pos = buffer.size();
+    }
+
+    if (info) *info = chunk_info;
+    return written;
+}
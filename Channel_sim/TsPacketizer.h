@@ -0,0 +1,94 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// MPEG-TS 相关的基础解析
+namespace ts {
+constexpr size_t kPacketSize = 188;
+constexpr uint8_t kSyncByte = 0x47;
+constexpr uint16_t kPatPid = 0x0000;
+constexpr uint16_t kNullPid = 0x1FFF;
+
+// 单个TS包头中我们关心的字段
+struct PacketFields {
+    uint16_t pid = 0;
+    bool payload_unit_start = false;
+    bool random_access = false; // 适配域 random_access_indicator（I帧起始）
+    bool has_pcr = false;
+    uint64_t pcr = 0;           // 27MHz 时钟：base * 300 + extension
+};
+
+// 解析一个188字节TS包，同步字节错误时返回 false
+bool parsePacket(const uint8_t* ts_packet, PacketFields* fields);
+
+// 判断一段数据是否像TS流（连续几个188间隔上都是同步字节）
+bool looksLikeTs(const uint8_t* data, size_t len);
+
+// 跟踪PAT中声明的PMT PID，用于识别 PSI 表（PAT/PMT）
+class PsiTracker {
+public:
+    // 处理一个TS包，返回该包是否属于 PAT/PMT
+    bool onPacket(const uint8_t* ts_packet, const PacketFields& fields);
+    void reset() { num_pmt_pids = 0; }
+
+private:
+    static constexpr int kMaxPmtPids = 16;
+    uint16_t pmt_pids[kMaxPmtPids] = {};
+    int num_pmt_pids = 0;
+
+    bool isPmtPid(uint16_t pid) const;
+    void parsePat(const uint8_t* ts_packet);
+};
+} // namespace ts
+
+// 一个数据报负载的TS元数据，供 FEC 不等保护和调度器使用
+struct TsChunkInfo {
+    static constexpr int kMaxPackets = 8;
+
+    int num_packets = 0;
+    uint16_t pids[kMaxPackets] = {};
+    bool has_psi = false;        // 含 PAT/PMT
+    bool random_access = false;  // 含 I帧起始
+    bool has_pcr = false;
+    uint16_t pcr_pid = 0;
+    uint64_t pcr = 0;            // 块内第一个 PCR（27MHz）
+    int pcr_packet_index = -1;   // PCR 所在的TS包在块内的下标
+
+    bool isCritical() const { return has_psi || random_access; }
+};
+
+// 按188字节TS包边界打包：每个数据报负载都是整数个TS包，
+// 失步时在 0x47 上重新同步（要求下一个188间隔处也是同步字节）。
+class TsPacketizer {
+public:
+    static constexpr int kDefaultPacketsPerDatagram = 5; // 5 x 188 = 940 字节
+
+    explicit TsPacketizer(int packets_per_datagram = kDefaultPacketsPerDatagram);
+
+    // 追加原始字节流
+    void append(const uint8_t* data, size_t len);
+
+    // 取出一块负载写入 out，返回字节数（0 表示数据不足）。
+    // flush 为 true 时允许输出不足 packets_per_datagram 个包的最后一块。
+    size_t pop(uint8_t* out, size_t capacity, TsChunkInfo* info, bool flush = false);
+
+    void reset();
+    int packetsPerDatagram() const { return packets_per_datagram; }
+    size_t chunkSize() const { return packets_per_datagram * ts::kPacketSize; }
+    uint64_t resyncCount() const { return resync_count; }
+    uint64_t skippedBytes() const { return skipped_bytes; }
+
+private:
+    int packets_per_datagram;
+    std::vector<uint8_t> buffer;
+    size_t read_pos = 0;
+    ts::PsiTracker psi;
+    uint64_t resync_count = 0;
+    uint64_t skipped_bytes = 0;
+
+    size_t available() const { return buffer.size() - read_pos; }
+    bool syncAt(size_t pos, bool flush) const;
+    bool resync(bool flush);
+    void compact();
+};
@@ -5,10 +5,22 @@
 #include <QMutex>
 #include <QWaitCondition>
 #include <deque>
+#include <vector>
 #include <atomic>
 #include <memory> // <--- 添加 include
 
 #include "udp_with_ulpfec.h" // 包含 ForwardErrorCorrection 定义
+#include "MultipathPolicy.h"
+#include "TsPacketizer.h"
+#include "DatagramFormat.h"
+#include "Crc32.h"
+#include "ChannelMetrics.h"
+#include "StreamScheduler.h"
+#include "InputSource.h"
+#include "PlayoutPacer.h"
+#include "CongestionControl.h"
+#include "Retransmission.h"
+#include "SendQueue.h"
 
 #pragma pack(1) // 使用 push 保存当前对齐设置
 struct videoStruct { 
@@ -24,28 +36,53 @@ struct videoStruct {
 };
 #pragma pack() // 恢复之前的对齐设置
 
+// 输入负载格式
+enum class PayloadFormat : int {
+    Auto = 0,   // 根据文件开头是否为 TS 同步字节自动选择
+    Raw = 1,    // 按 readChunkSize 固定长度切块
+    MpegTs = 2, // 按 188 字节 TS 包边界切块
+};
+
 //#pragma pack(1)
 struct SendPacket {
     std::unique_ptr<ForwardErrorCorrection::Packet> packet_to_send;  //FEC包
-    uint32_t crc32 = 0;         // CRC32校验
+    uint32_t crc32 = 0;         // CRC-32C 校验，覆盖 FEC 头和负载
     uint8_t stream_type = 0x01; // 流类型 
     uint8_t channel_index;      // 目标通道号
-    uint8_t seq;                // 序列号
+    uint32_t seq;               // 全局序列号：v1 线上只有低8位，v2 为32位
     // 负载大小不是头信息，只是用于方便计算
     size_t actual_payload_size; // 负载大小
+    int protocol_version = ForwardErrorCorrection::Packet::kProtocolV1; // 序列化使用的协议版本
+    // 以下也不是头信息：多路冗余时同一个包的所有副本共享投递记录
+    std::shared_ptr<DeliveryRecord> delivery;
+    bool is_primary = true;     // 是否为主副本
+    int64_t enqueue_time_ns = 0; // 入队时刻（单调时钟），用于统计排队时间
+    int64_t ingest_time_ns = 0;  // 负载进入发送端的时刻（单调时钟），用于统计输入到发出的时延
+    int64_t release_time_ns = 0; // PCR 播出模式下的预定发送时刻（单调时钟），到时才放入通道队列
+    int64_t max_wait_ns = 0;     // 所属流的截止时长，0 表示不限
+    int64_t deadline_ns = 0;     // 入队时刻加截止时长，过了这个时刻还没发出就丢弃；0 表示不限
+    QueueClass queue_class = QueueClass::Media; // 通道队列里的优先级类别，入队时确定
+    std::vector<char> retransmission; // 非空时为重传：历史缓存中的原样数据报，packet_to_send 为空
 };
 //#pragma pack()
 // 每个通道的上下文
 struct ChannelContext {
-    // 队列现在存储 SendPacket 对象
-    std::deque<SendPacket> packetQueue;
+    // 队列现在存储 SendPacket 对象，按类别加权轮询、类别内按流分道，出队时丢弃过期的包
+    PrioritizedSendQueue<SendPacket> packetQueue;
     QMutex queueMutex;
     QWaitCondition queueCondition;
 
     QMutex stateMutex;
     std::atomic<int> enabled{ 0 };
+    std::atomic<int64_t> enabled_since_us{ 0 }; // 最近一次启用的时刻，反馈静默从这之后才开始计算
     std::atomic<double> lossRate{ 0.0 };
     QWaitCondition stateCondition;
+
+    ChannelMetrics metrics;
+
+    // 拥塞控制：接收端反馈驱动的带宽估计，发送线程按估计值限速
+    ChannelBandwidthEstimator bwe;
+    ChannelPacer pacer;
 };
 
 class Udpserver : public QObject {
@@ -64,13 +101,68 @@ public:
     Udpserver& operator=(Udpserver&&) = delete;
 
 
-    // 文件功能接口
+    // 文件功能接口：filePath 也可以是直播源 URI（udp://、pipe://、stdin、synthetic://，见 InputSource::create）
     void SetFileName(const QString& filePath);
     void StartSending();
     void StopSending();
     void channelStateChange(int channel, bool state);
     void setLossRate(int channel, double rate);
 
+    // 多路调度接口
+    void setScheduleMode(ScheduleMode mode);
+    void setRedundantCopies(int copies);                 // 冗余模式下每个包总共经过的通道数
+    void setPayloadClassifier(PayloadClassifier classifier); // 传空函数恢复默认的 TS 分类器
+    const MultipathStats& getMultipathStats() const { return multipathStats; }
+    uint64_t getDroppedFlushes() const { return flushesDropped.load(); } // 提前结束的组因没有启用的通道而丢弃冗余包的次数
+
+    // 统计快照：只读取原子计数器，界面可以按 10Hz 轮询，命令行导出也走这里
+    MetricsSnapshot getMetricsSnapshot();
+
+    // 打包接口，下一次开始发送时生效
+    void setPayloadFormat(PayloadFormat format);
+    void setTsPacketsPerDatagram(int packets); // 每个数据报携带的TS包数，受 videoData 容量限制
+    void setUnequalProtection(bool enable);    // 对打包器标记的重要包做不等保护
+    void setFecParameters(int k, int r);       // 每组源包数 k（1~48）和冗余包数 r（0~k）
+    void setProtocolVersion(int version);      // 1：8位组号/序列号（兼容旧接收端）；2：32位
+    void setGroupDeadline(int ms);             // 组在 ms 内未填满时按缩短码提前结束，0 表示只在文件结束时补齐
+    void setPacingRate(qint64 bits_per_second); // 源数据的发送速率，0 表示不限速，下一次开始发送时生效
+    void setPlayoutMode(PlayoutMode mode);      // Pcr：TS 文件按 PCR 时间轴发送，下一次开始发送时生效
+    void setPlayoutSpeed(double speed);         // 回放倍速（1、2、10 ...），两种节奏都适用；0 表示尽快发送
+
+    // 拥塞控制接口，下一次开始发送时生效。开启后每个通道按接收端反馈估计可用带宽并按估计值限速，
+    // 读取线程按各通道的估计值加权分配源包（接收端需开启反馈，见 ReceiverConfig::feedback_interval_ms）
+    void setCongestionControl(bool enable);
+    void setBandwidthLimits(qint64 min_bps, qint64 start_bps, qint64 max_bps); // 每个通道估计值的下限、初值和上限
+
+    // 选择性重传接口，下一次开始发送时生效，只支持 v2 协议。开启后按全局序列号保存最近发出的数据报，
+    // 接收端请求（见 ReceiverEngineConfig::nack）的源包经当前最好的通道重传；
+    // 冗余包和重传共用 ratio（相对源包字节数）的预算，冗余包先占用，剩余的额度才用于重传
+    void setRetransmission(bool enable);
+    void setRepairBudget(double ratio);
+
+    // 截止时刻接口，下一次开始发送时生效。包在通道队列里等待超过所属流的截止时长（StreamConfig::deadline_ms，
+    // 未设置时取 ms，0 表示不限）后在出队时丢弃，不再占用链路；EarliestDeadline 时各流之间按截止时刻先后发送
+    void setQueueDeadline(int ms);
+    void setQueueOrdering(QueueOrdering ordering);
+    // 通道队列各类别（关键源包、重传、普通源包、冗余包）的轮询权重，下一次开始发送时生效
+    void setQueueClassWeights(const QueueClassWeights& weights);
+    // 多路流接口，下一次开始发送时生效。流表为空时只发送 SetFileName 设置的文件（stream_type 1）；
+    // 各流按优先级和权重共享 setPacingRate 设定的总速率
+    bool addStream(const StreamConfig& stream); // stream_type 与已有的流重复时返回 false
+    void clearStreams();
+    void setIngestBufferBytes(size_t bytes); // 每个直播源的输入缓冲区大小，满时丢弃最老的数据
+
+    // 文件已读完（末组冗余包已入队）且所有通道队列都已取空
+    bool sendingFinished();
+
+    // 故障切换：连续 kFailoverSendErrors 次 sendto 失败，或开启拥塞控制时发包后 kFailoverSilenceUs 内没有反馈，
+    // 判定通道失效并禁用（至少保留一个启用的通道）。被禁用（手动或失效）的通道队列里的包立即迁到其他启用的通道
+    static constexpr int kFailoverSendErrors = 16;
+    static constexpr int64_t kFailoverSilenceUs = 500'000;
+
+signals:
+    void channelFailed(int channel); // 通道被判定失效并自动禁用，在发送或反馈线程中发出
+
 private:
     // 网络相关
     SOCKET sockets[SOCKET_POOL_SIZE];
@@ -79,26 +171,79 @@ private:
     // 文件相关
     QMutex fileMutex;
     QString currentFilePath;
+    std::vector<StreamConfig> streamTable; // 由 fileMutex 保护
+    std::atomic<size_t> ingestBufferBytes{ InputSource::kDefaultIngestBufferBytes };
+    QMutex inputsMutex;
+    std::vector<std::pair<int, std::shared_ptr<InputSource>>> activeInputs; // (stream_type, 输入源)，供统计快照读取
     std::atomic<int> currentSocket{ 0 };
     const int flightpkt_header_size = 15; // 试飞院的头大小
-    const size_t fec_header_size = 6;     // FEC 的头大小
-    const size_t packet_header_size = 7;  // 协议的头大小
     const int readChunkSize = 1009; // 文件读取块大小 (可以调整)
-    const int total_length = readChunkSize + packet_header_size + fec_header_size + flightpkt_header_size;
+    static constexpr int kMaxTsPacketsPerDatagram = sizeof(videoStruct::videoData) / ts::kPacketSize; // 5 x 188 = 940
+    std::atomic<int> payloadFormat{ static_cast<int>(PayloadFormat::Auto) };
+    std::atomic<int> tsPacketsPerDatagram{ kMaxTsPacketsPerDatagram };
+    std::atomic<bool> unequalProtection{ false };
     int sysword = 0;
-    std::atomic<uint8_t> globalSeqCounter{ 0 };
+    std::atomic<uint32_t> globalSeqCounter{ 0 };
+    std::atomic<int> protocolVersion{ ForwardErrorCorrection::Packet::kProtocolV1 };
     // 通道上下文
     ChannelContext channels[SOCKET_POOL_SIZE];
     QList<QThread*> workerThreads;
     std::atomic<bool> is_running{ false };
 
-    //FEC相关
-    ForwardErrorCorrection fec; // FEC对象 (包含内部 buffer_packets)
-    const int fec_k = 10; // 每组多少个源数据包
-    const int fec_r = 2;  // 每组多少个冗余包
+    //FEC相关（编码器状态在读取线程中按流各自保存）
+    std::atomic<int> fec_k{ 10 }; // 每组多少个源数据包
+    std::atomic<int> fec_r{ 2 };  // 每组多少个冗余包
+    std::atomic<int> groupDeadlineMs{ 100 }; // 组超时（毫秒）
+    std::atomic<uint64_t> flushesDropped{ 0 }; // 只由读取线程写
+    std::atomic<qint64> pacingRateBps{ 30'000'000 }; // 按读取的源数据量限速
+    std::atomic<int> playoutMode{ static_cast<int>(PlayoutMode::Bitrate) };
+    std::atomic<double> playoutSpeed{ 1.0 };
+    std::atomic<bool> congestionControl{ false };
+    std::atomic<qint64> bweMinBps{ BweConfig().min_bps };
+    std::atomic<qint64> bweStartBps{ BweConfig().start_bps };
+    std::atomic<qint64> bweMaxBps{ BweConfig().max_bps };
+    int64_t wrrCredit[SOCKET_POOL_SIZE] = {}; // 平滑加权轮询的当前额度，只在读取线程中使用
+    std::atomic<bool> retransmissionEnabled{ false };
+    std::atomic<double> repairBudgetRatio{ 0.3 };
+    std::atomic<int> queueDeadlineMs{ 0 };
+    std::atomic<int> queueOrdering{ static_cast<int>(QueueOrdering::Fifo) };
+    QMutex queueWeightsMutex;
+    QueueClassWeights queueClassWeights; // 由 queueWeightsMutex 保护
+    PacketHistory packetHistory;
+    RepairBudget repairBudget;
+    RetransmissionCounters retransmissionCounters;
+    QMutex failoverMutex; // 判定失效和禁用之间不能有别的通道同时失效，否则可能一个启用的通道都不剩
+
+    // PCR 播出：读取线程按预定时刻放入时间轮，播出线程到时再转入通道队列
+    QMutex playoutMutex;
+    QWaitCondition playoutCondition;
+    TimerWheel<SendPacket> playoutWheel;
+    std::atomic<bool> readerFinished{ false };
+
+    // 多路调度相关
+    std::atomic<int> scheduleMode{ static_cast<int>(ScheduleMode::RoundRobin) };
+    std::atomic<int> redundantCopies{ 2 };
+    QMutex classifierMutex;
+    PayloadClassifier payloadClassifier; // 为空时使用 TsPayloadClassifier
+    MultipathStats multipathStats;
+    MetricsRateWindow metricsRates;
 
     // 内部函数
+    struct StreamState;
     void initializeSockets();
     void fileReaderTask();
     void socketWorkerTask(int socket_index);
+    void playoutTask();
+    void feedbackTask();
+    int pickWeightedChannel();
+    void handleNack(const datagram::Nack& nack, int64_t now_us);
+    int pickRetransmissionChannel();
+    bool failChannel(int channel, const char* reason, int64_t trigger_ns);
+    int migrateQueue(int channel, int64_t trigger_ns);
+    int pickEnabledChannel();
+
+    void schedulePlayout(SendPacket&& sendPkt);
+    int collectTargetChannels(int primary_channel, int copies, int* out_channels);
+    void enqueuePacket(int channel, SendPacket&& sendPkt);
+    int datagramLength(const SendPacket& sendPkt) const;
 };
\ No newline at end of file
@@ -1,15 +1,18 @@
 #include <thread>
+#include <algorithm>
 #include "modules/rtp_rtcp/include/simple_client_server.h"
 #include "modules/rtp_rtcp/source/forward_error_correction.h" 
 #include "modules/rtp_rtcp/source/fec_private_tables_bursty.h"
 #include "modules/rtp_rtcp/source/fec_private_tables_random.h"
 
 ForwardErrorCorrection::Packet::Packet() {
-	packet_mask = 0; // ʼ
+	memset(packet_mask, 0, sizeof(packet_mask)); // ʼ
 	group_number = 0; // ʼϢ
 	sequence_number = 0; // ʼϢ
 	k = 0; // ʼݰϢ
 	r = 0; // ʼϢ
+	is_important = false; // ĬϲҪ
+	length = 0; // ޸
 	memset(data, 0, kMaxDataSize); // ʼֶ
 }
 
@@ -51,7 +54,7 @@ int ForwardErrorCorrection::EncodeFec(const PacketList& media_packets,
 	RTC_DCHECK_GE(num_important_packets, 0); // ȷҪΪ
 	RTC_DCHECK_LE(num_important_packets, num_media_packets); // ȷҪܰ
 	RTC_DCHECK(fec_packets->empty()); // ȷFECбΪ
-	RTC_DCHECK_LE(num_media_packets, 16); // ݰΪ16
+	RTC_DCHECK_LE(num_media_packets, kUlpfecMaxMediaPackets); // 48ݰ48λ룩
 
 	// ׼ɵFEC
 	int num_fec_packets = r;
@@ -67,14 +70,33 @@ int ForwardErrorCorrection::EncodeFec(const PacketList& media_packets,
 		fec_packets->push_back(fec_packet);
 	}
 
-	// 
+	// Ҫʹô is_important
+	// ûбʱ WebRTC Լǰ num_important_packets Ҫ
+	bool important[kUlpfecMaxMediaPackets] = {};
+	int num_flagged = 0;
+	int index = 0;
+	for (const auto& media_packet : media_packets) {
+		important[index] = media_packet->is_important;
+		num_flagged += media_packet->is_important ? 1 : 0;
+		index++;
+	}
+	if (num_flagged == 0) {
+		for (int i = 0; i < num_important_packets; ++i) {
+			important[i] = true;
+		}
+	}
+
+	// ɰ
 	int num_media_packets_int = static_cast<int>(num_media_packets);
-	PacketMaskTable mask_table(fec_mask_type, num_media_packets_int);
 	packet_mask_size_ = PacketMaskSize(num_media_packets);
-	memset(packet_masks_, 0, num_fec_packets * packet_mask_size_);
-	GeneratePacketMasks(num_media_packets, num_fec_packets,
-		num_important_packets, use_unequal_protection,
-		&mask_table, packet_masks_);
+	GenerateGroupPacketMasks(num_media_packets_int, num_fec_packets, important,
+		use_unequal_protection, fec_mask_type, packet_masks_);
+
+	// ԴȿԲͬļĩβֱԴĶ̶̰㴦ȡԴĳ
+	size_t group_length = 0;
+	for (const auto& media_packet : media_packets) {
+		group_length = std::max(group_length, media_packet->length);
+	}
 
 	// FEC
 	for (int i = 0; i < num_fec_packets; ++i) {
@@ -83,12 +105,13 @@ int ForwardErrorCorrection::EncodeFec(const PacketList& media_packets,
 		int j = 0;
 		for (const auto& media_packet : media_packets) {
 			if (packet_masks_[i * packet_mask_size_ + j / 8] & (1 << (7 - (j % 8)))) {
-				XorPayloads(media_packet->data, fec_packet->data, packet_size);
+				XorPayloads(media_packet->data, fec_packet->data, media_packet->length);
 			}
 			j++;
 		}
-		// FECͷ
-		memcpy(&fec_packet->packet_mask, &packet_masks_[(sequence_number - num_media_packets) * packet_mask_size_], packet_mask_size_);
+		fec_packet->length = group_length;
+		// FECͷk>16 ʱΪ6ֽ
+		memcpy(fec_packet->packet_mask, &packet_masks_[i * packet_mask_size_], packet_mask_size_);
 		fec_packet->group_number = group_number;
 		fec_packet->sequence_number = sequence_number;
 		fec_packet->k = num_media_packets;
@@ -117,13 +140,34 @@ size_t PacketMaskSize(size_t num_sequence_numbers) {
 	return kUlpfecPacketMaskSizeLBitClear;
 }
 
-size_t ForwardErrorCorrection::Packet::Serialize(char* buffer, size_t buffer_size, size_t payload_size_to_write) const {
-	// Define the size of the fixed header part
-	const size_t header_size = sizeof(this->packet_mask) +
-		sizeof(this->group_number) +
-		sizeof(this->sequence_number) +
-		sizeof(this->k) +
-		sizeof(this->r); // Should be 2 + 1 + 1 + 1 + 1 = 6 bytes
+size_t ForwardErrorCorrection::Packet::HeaderSize(int protocol_version) const {
+	size_t header_size = kBaseHeaderSize;
+	if (PacketMaskSize(k) == kUlpfecPacketMaskSizeLBitSet) {
+		header_size += kMaskExtensionSize;
+	}
+	if (protocol_version >= kProtocolV2) {
+		header_size += kVersionExtensionSize;
+	}
+	return header_size;
+}
+
+size_t ForwardErrorCorrection::Packet::PeekHeaderSize(const char* buffer, size_t buffer_size) {
+	if (buffer_size < kBaseHeaderSize) {
+		return 0;
+	}
+	const uint8_t flags = static_cast<uint8_t>(buffer[4]);
+	const size_t header_size = kBaseHeaderSize +
+		((flags & kLBit) ? kMaskExtensionSize : 0) +
+		((flags & kVBit) ? kVersionExtensionSize : 0);
+	return buffer_size < header_size ? 0 : header_size;
+}
+
+size_t ForwardErrorCorrection::Packet::Serialize(char* buffer, size_t buffer_size, size_t payload_size_to_write,
+	int protocol_version) const {
+	// ͷ6ֽڣk>16 ʱ4ֽչv2 ټ6ֽڰ汾չ
+	const size_t header_size = HeaderSize(protocol_version);
+	const bool l_bit = PacketMaskSize(k) == kUlpfecPacketMaskSizeLBitSet;
+	const bool v_bit = protocol_version >= kProtocolV2;
 
 	// Calculate the total required size for serialization
 	const size_t required_total_size = header_size + payload_size_to_write;
@@ -144,27 +188,276 @@ size_t ForwardErrorCorrection::Packet::Serialize(char* buffer, size_t buffer_siz
 	char* current_ptr = buffer;
 
 	// Copy header fields sequentially
-	memcpy(current_ptr, &this->packet_mask, sizeof(this->packet_mask));
-	current_ptr += sizeof(this->packet_mask);
+	memcpy(current_ptr, this->packet_mask, kUlpfecPacketMaskSizeLBitClear);
+	current_ptr += kUlpfecPacketMaskSizeLBitClear;
 
-	memcpy(current_ptr, &this->group_number, sizeof(this->group_number));
-	current_ptr += sizeof(this->group_number);
+	// v1 ֻЯŵ8λ
+	*current_ptr++ = static_cast<char>(this->group_number & 0xFF);
 
 	memcpy(current_ptr, &this->sequence_number, sizeof(this->sequence_number));
 	current_ptr += sizeof(this->sequence_number);
 
-	memcpy(current_ptr, &this->k, sizeof(this->k));
-	current_ptr += sizeof(this->k);
+	*current_ptr++ = static_cast<char>(this->k | (l_bit ? kLBit : 0) | (v_bit ? kVBit : 0));
 
 	memcpy(current_ptr, &this->r, sizeof(this->r));
 	current_ptr += sizeof(this->r);
 
+	// ĺ4ֽڷڻͷ֮󣬾ɽն˰6ֽͷ k<=16 İӰ
+	if (l_bit) {
+		memcpy(current_ptr, this->packet_mask + kUlpfecPacketMaskSizeLBitClear, kMaskExtensionSize);
+		current_ptr += kMaskExtensionSize;
+	}
+
+	// 汾չversion(1) | flags(1) | group_number(4)
+	if (v_bit) {
+		*current_ptr++ = static_cast<char>(kProtocolV2);
+		*current_ptr++ = 0;
+		memcpy(current_ptr, &this->group_number, sizeof(this->group_number));
+		current_ptr += sizeof(this->group_number);
+	}
+
 	// Copy the specified amount of payload data
 	memcpy(current_ptr, this->data, payload_size_to_write);
 
 	// Return the total number of bytes written
 	return required_total_size;
 }
+
+size_t ForwardErrorCorrection::Packet::Deserialize(const char* buffer, size_t buffer_size, size_t payload_size,
+	int* protocol_version) {
+	const size_t header_size = PeekHeaderSize(buffer, buffer_size);
+	if (header_size == 0) {
+		return 0;
+	}
+	const uint8_t* p = reinterpret_cast<const uint8_t*>(buffer);
+	const bool l_bit = (p[4] & kLBit) != 0;
+	const bool v_bit = (p[4] & kVBit) != 0;
+	const uint8_t num_media = p[4] & ~(kLBit | kVBit);
+	// Lλ k Ӧ볤һ£Ϊ𻵵İ
+	if (num_media == 0 || num_media > kUlpfecMaxMediaPackets ||
+		l_bit != (PacketMaskSize(num_media) == kUlpfecPacketMaskSizeLBitSet)) {
+		return 0;
+	}
+	if (buffer_size < header_size + payload_size || payload_size > sizeof(data)) {
+		return 0;
+	}
+
+	memset(packet_mask, 0, sizeof(packet_mask));
+	memcpy(packet_mask, p, kUlpfecPacketMaskSizeLBitClear);
+	group_number = p[2];
+	sequence_number = p[3];
+	k = num_media;
+	r = p[5];
+	const uint8_t* extension = p + kBaseHeaderSize;
+	if (l_bit) {
+		memcpy(packet_mask + kUlpfecPacketMaskSizeLBitClear, extension, kMaskExtensionSize);
+		extension += kMaskExtensionSize;
+	}
+	int version = kProtocolV1;
+	if (v_bit) {
+		version = extension[0];
+		if (version < kProtocolV2) {
+			return 0;
+		}
+		memcpy(&group_number, extension + 2, sizeof(group_number));
+		// 8λͻͷеűһ
+		if ((group_number & 0xFF) != p[2]) {
+			return 0;
+		}
+	}
+	if (protocol_version) {
+		*protocol_version = version;
+	}
+	memcpy(data, p + header_size, payload_size);
+	return header_size + payload_size;
+}
+namespace {
+// ȱҪıʽ
+enum ProtectionMode {
+	kModeNoOverlap,       // ֻص
+	kModeOverlap,         // ʣFECͬʱаƼ
+	kModeBiasFirstPacket, // ȱ϶ǿһ
+};
+
+//  sub_maskÿ num_sub_mask_bytes ֽڣŽÿ num_mask_bytes ֽڵ
+void FitSubMask(int num_mask_bytes,
+	int num_sub_mask_bytes,
+	int num_rows,
+	const uint8_t* sub_mask,
+	uint8_t* packet_mask) {
+	if (num_mask_bytes == num_sub_mask_bytes) {
+		memcpy(packet_mask, sub_mask, num_rows * num_sub_mask_bytes);
+	}
+	else {
+		for (int i = 0; i < num_rows; ++i) {
+			int pkt_mask_idx = i * num_mask_bytes;
+			int pkt_mask_idx2 = i * num_sub_mask_bytes;
+			for (int j = 0; j < num_sub_mask_bytes; ++j) {
+				packet_mask[pkt_mask_idx] = sub_mask[pkt_mask_idx2];
+				pkt_mask_idx++;
+				pkt_mask_idx2++;
+			}
+		}
+	}
+}
+
+//  num_column_shift кŽ [num_column_shift, end_row) 
+void ShiftFitSubMask(int num_mask_bytes,
+	int res_mask_bytes,
+	int num_column_shift,
+	int end_row,
+	const uint8_t* sub_mask,
+	uint8_t* packet_mask) {
+	// ֽλֽλ
+	const int num_bit_shifts = (num_column_shift % 8);
+	const int num_byte_shifts = num_column_shift >> 3;
+
+	for (int i = num_column_shift; i < end_row; ++i) {
+		//  i һЧֽڣֽλ
+		int pkt_mask_idx =
+			i * num_mask_bytes + res_mask_bytes - 1 + num_byte_shifts;
+		// Ӧеһֽ
+		int pkt_mask_idx2 =
+			(i - num_column_shift) * res_mask_bytes + res_mask_bytes - 1;
+
+		uint8_t shift_right_curr_byte = 0;
+		uint8_t shift_left_prev_byte = 0;
+		uint8_t comb_new_byte = 0;
+
+		// ʱһֽƳĵλŵһֽ
+		if (num_mask_bytes > res_mask_bytes) {
+			shift_left_prev_byte = (sub_mask[pkt_mask_idx2] << (8 - num_bit_shifts));
+			packet_mask[pkt_mask_idx + 1] = shift_left_prev_byte;
+		}
+
+		// һֽǰÿֽƲƴǰһֽƳλ
+		for (int j = res_mask_bytes - 1; j > 0; j--) {
+			shift_right_curr_byte = sub_mask[pkt_mask_idx2] >> num_bit_shifts;
+			shift_left_prev_byte =
+				(sub_mask[pkt_mask_idx2 - 1] << (8 - num_bit_shifts));
+			comb_new_byte = shift_right_curr_byte | shift_left_prev_byte;
+			packet_mask[pkt_mask_idx] = comb_new_byte;
+			pkt_mask_idx--;
+			pkt_mask_idx2--;
+		}
+		// ÿеһֽ
+		shift_right_curr_byte = sub_mask[pkt_mask_idx2] >> num_bit_shifts;
+		packet_mask[pkt_mask_idx] = shift_right_curr_byte;
+	}
+}
+
+// Ҫ֮ʣı
+void RemainingPacketProtection(int num_media_packets,
+	int num_fec_remaining,
+	int num_fec_for_imp_packets,
+	int num_mask_bytes,
+	ProtectionMode mode,
+	uint8_t* packet_mask,
+	PacketMaskTable* mask_table) {
+	if (mode == kModeNoOverlap) {
+		// sub_mask21ֻҪ
+		const int res_mask_bytes =
+			PacketMaskSize(num_media_packets - num_fec_for_imp_packets);
+
+		auto end_row = (num_fec_for_imp_packets + num_fec_remaining);
+		rtc::ArrayView<const uint8_t> packet_mask_sub_21 = mask_table->LookUp(
+			num_media_packets - num_fec_for_imp_packets, num_fec_remaining);
+
+		ShiftFitSubMask(num_mask_bytes, res_mask_bytes, num_fec_for_imp_packets,
+			end_row, &packet_mask_sub_21[0], packet_mask);
+	}
+	else if (mode == kModeOverlap || mode == kModeBiasFirstPacket) {
+		// sub_mask22ȫ
+		rtc::ArrayView<const uint8_t> packet_mask_sub_22 =
+			mask_table->LookUp(num_media_packets, num_fec_remaining);
+
+		FitSubMask(num_mask_bytes, num_mask_bytes, num_fec_remaining,
+			&packet_mask_sub_22[0],
+			&packet_mask[num_fec_for_imp_packets * num_mask_bytes]);
+
+		if (mode == kModeBiasFirstPacket) {
+			for (int i = 0; i < num_fec_remaining; ++i) {
+				int pkt_mask_idx = i * num_mask_bytes;
+				packet_mask[pkt_mask_idx] = packet_mask[pkt_mask_idx] | (1 << 7);
+			}
+		}
+	}
+	else {
+		RTC_DCHECK_NOTREACHED();
+	}
+}
+
+// Ҫǰ num_imp_packets ı
+void ImportantPacketProtection(int num_fec_for_imp_packets,
+	int num_imp_packets,
+	int num_mask_bytes,
+	uint8_t* packet_mask,
+	PacketMaskTable* mask_table) {
+	const int num_imp_mask_bytes = PacketMaskSize(num_imp_packets);
+
+	// sub_mask1 ֱӲ
+	rtc::ArrayView<const uint8_t> packet_mask_sub_1 =
+		mask_table->LookUp(num_imp_packets, num_fec_for_imp_packets);
+
+	FitSubMask(num_mask_bytes, num_imp_mask_bytes, num_fec_for_imp_packets,
+		&packet_mask_sub_1[0], packet_mask);
+}
+
+// ҪFECһFEC
+int SetProtectionAllocation(int num_media_packets,
+	int num_fec_packets,
+	int num_imp_packets) {
+	float alloc_par = 0.5;
+	int max_num_fec_for_imp = alloc_par * num_fec_packets;
+
+	int num_fec_for_imp_packets = (num_imp_packets < max_num_fec_for_imp)
+		? num_imp_packets
+		: max_num_fec_for_imp;
+
+	// ֻһFECҪռȲʱ˻صȱ
+	if (num_fec_packets == 1 && (num_media_packets > 2 * num_imp_packets)) {
+		num_fec_for_imp_packets = 0;
+	}
+
+	return num_fec_for_imp_packets;
+}
+
+// ȱ룺õȱ߱ƴ
+//  k=ýn-k=FECm=Ҫt=ָҪFEC
+// sub_mask1 = (m, t) ֻҪ
+// ģʽ0sub_mask21 = (k-m, n-k-t) ֻʣ
+// ģʽ1sub_mask22 = (k, n-k-t) ȫصĬϣ
+void UnequalProtectionMask(int num_media_packets,
+	int num_fec_packets,
+	int num_imp_packets,
+	int num_mask_bytes,
+	uint8_t* packet_mask,
+	PacketMaskTable* mask_table) {
+	ProtectionMode mode = kModeOverlap;
+	int num_fec_for_imp_packets = 0;
+
+	if (mode != kModeBiasFirstPacket) {
+		num_fec_for_imp_packets = SetProtectionAllocation(
+			num_media_packets, num_fec_packets, num_imp_packets);
+	}
+
+	int num_fec_remaining = num_fec_packets - num_fec_for_imp_packets;
+
+	//  sub_mask1
+	if (num_fec_for_imp_packets > 0) {
+		ImportantPacketProtection(num_fec_for_imp_packets, num_imp_packets,
+			num_mask_bytes, packet_mask, mask_table);
+	}
+
+	//  sub_mask2
+	if (num_fec_remaining > 0) {
+		RemainingPacketProtection(num_media_packets, num_fec_remaining,
+			num_fec_for_imp_packets, num_mask_bytes, mode,
+			packet_mask, mask_table);
+	}
+}
+}  // namespace
+
 // ɰ
 void GeneratePacketMasks(int num_media_packets,
 	int num_fec_packets,
@@ -189,8 +482,59 @@ void GeneratePacketMasks(int num_media_packets,
 			mask_table->LookUp(num_media_packets, num_fec_packets);
 		memcpy(packet_mask, &mask[0], mask.size());
 	}
+	else {  // ȱǰ num_imp_packets øౣ
+		UnequalProtectionMask(num_media_packets, num_fec_packets, num_imp_packets,
+			num_mask_bytes, packet_mask, mask_table);
+	}
 }  //  GetPacketMasks
 
+void GenerateGroupPacketMasks(int num_media_packets,
+	int num_fec_packets,
+	const bool* important,
+	bool use_unequal_protection,
+	FecMaskType fec_mask_type,
+	uint8_t* packet_mask) {
+	const int num_mask_bytes = static_cast<int>(PacketMaskSize(num_media_packets));
+	memset(packet_mask, 0, num_fec_packets * num_mask_bytes);
+
+	// Ҫǰں˳order[j] Ϊ j жӦʵʰλ
+	int order[kUlpfecMaxMediaPackets];
+	int num_imp_packets = 0;
+	if (use_unequal_protection && important) {
+		for (int i = 0; i < num_media_packets; ++i) {
+			if (important[i]) order[num_imp_packets++] = i;
+		}
+		int next = num_imp_packets;
+		for (int i = 0; i < num_media_packets; ++i) {
+			if (!important[i]) order[next++] = i;
+		}
+	}
+
+	PacketMaskTable mask_table(fec_mask_type, num_media_packets);
+	if (num_imp_packets == 0 || num_imp_packets == num_media_packets) {
+		// ûҪȫҪȱɣ˳򲻱
+		GeneratePacketMasks(num_media_packets, num_fec_packets, 0, false,
+			&mask_table, packet_mask);
+		return;
+	}
+
+	uint8_t ordered_mask[kUlpfecMaxMediaPackets * kUlpfecMaxPacketMaskSize] = {};
+	GeneratePacketMasks(num_media_packets, num_fec_packets, num_imp_packets, true,
+		&mask_table, ordered_mask);
+
+	// ӳʵλãն˰ͷ룬Ҫ֪ЩҪ
+	for (int row = 0; row < num_fec_packets; ++row) {
+		const uint8_t* src_row = &ordered_mask[row * num_mask_bytes];
+		uint8_t* dst_row = &packet_mask[row * num_mask_bytes];
+		for (int col = 0; col < num_media_packets; ++col) {
+			if (src_row[col / 8] & (1 << (7 - (col % 8)))) {
+				const int bit = order[col];
+				dst_row[bit / 8] |= static_cast<uint8_t>(1 << (7 - (bit % 8)));
+			}
+		}
+	}
+}
+
 rtc::ArrayView<const uint8_t> PacketMaskTable::LookUp(int num_media_packets,
 	int num_fec_packets) {
 	RTC_DCHECK_GT(num_media_packets, 0);
@@ -309,23 +653,19 @@ void ForwardErrorCorrection::SendByUlpfec(SOCKET so, const char* buf, int len, i
 
 	//  ForwardErrorCorrection::Packet ݰ
 	auto packet = std::make_unique<ForwardErrorCorrection::Packet>();
-	packet->packet_mask = 0; // ݰ룬ֱΪ0
+	// ݰ룬ʱ
 	packet->group_number = group_number;
 	packet->sequence_number = sequence_number;
 	packet->k = k;
 	packet->r = r;
 	memcpy(packet->data, buf, packet_size);
+	packet->length = packet_size;
 	// sequence_number
 	sequence_number++;
 
-	// ÷ͻ
-	char send_buffer[2006]; // 2006 = 2000 + 6
-	memcpy(send_buffer, &packet->packet_mask, sizeof(packet->packet_mask));
-	memcpy(send_buffer + sizeof(packet->packet_mask), &packet->group_number, sizeof(packet->group_number));
-	memcpy(send_buffer + sizeof(packet->packet_mask) + sizeof(packet->group_number), &packet->sequence_number, sizeof(packet->sequence_number));
-	memcpy(send_buffer + sizeof(packet->packet_mask) + sizeof(packet->group_number) + sizeof(packet->sequence_number), &packet->k, sizeof(packet->k));
-	memcpy(send_buffer + sizeof(packet->packet_mask) + sizeof(packet->group_number) + sizeof(packet->sequence_number) + sizeof(packet->k), &packet->r, sizeof(packet->r));
-	memcpy(send_buffer + sizeof(packet->packet_mask) + sizeof(packet->group_number) + sizeof(packet->sequence_number) + sizeof(packet->k) + sizeof(packet->r), packet->data, packet_size);
+	// ÷ͻݣk>16 ʱͷΪ10ֽڣ
+	char send_buffer[Packet::kMaxHeaderSize + Packet::kMaxDataSize];
+	const size_t send_length = packet->Serialize(send_buffer, sizeof(send_buffer), packet_size);
 	// ӡݰϢ
 	printf("sending SRC symbol: group_number=%u, sequence_number=%u, packet_size=%u\n", packet->group_number, packet->sequence_number, packet_size);
 
@@ -334,7 +674,7 @@ void ForwardErrorCorrection::SendByUlpfec(SOCKET so, const char* buf, int len, i
 
 	// ݰ
 	auto start = std::chrono::high_resolution_clock::now(); //¼ǰʱ
-	if ((ret = sendto(so, send_buffer, packet_size + 6, 0, to, tolen)) == SOCKET_ERROR) {
+	if ((ret = sendto(so, send_buffer, static_cast<int>(send_length), 0, to, tolen)) == SOCKET_ERROR) {
 		OF_PRINT_ERROR(("sendto() failed!\n"))
 			ret = -1;
 		return;
@@ -342,7 +682,7 @@ void ForwardErrorCorrection::SendByUlpfec(SOCKET so, const char* buf, int len, i
 	auto end = std::chrono::high_resolution_clock::now(); //¼ǰʱ
 	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
 	double timeTaken = duration.count() / 1000.0; // ʵʱ
-	double desiredTime = (packet_size + 6) * 8 / static_cast<double>(bitrate); // ʱ
+	double desiredTime = send_length * 8 / static_cast<double>(bitrate); // ʱ
 	total_sent_packets++;
 	total_sent_src_packets++;
 	double sleepTime = desiredTime - timeTaken;
@@ -357,18 +697,12 @@ void ForwardErrorCorrection::SendByUlpfec(SOCKET so, const char* buf, int len, i
 		// ʿƣ
 		for (ForwardErrorCorrection::Packet* fec_packet : fec_packets) {
 			// ÷ͻ
-			char send_buffer[2006]; // 2006 = 2000 + 6
-			memcpy(send_buffer, &fec_packet->packet_mask, sizeof(fec_packet->packet_mask));
-			memcpy(send_buffer + sizeof(fec_packet->packet_mask), &fec_packet->group_number, sizeof(fec_packet->group_number));
-			memcpy(send_buffer + sizeof(fec_packet->packet_mask) + sizeof(fec_packet->group_number), &fec_packet->sequence_number, sizeof(fec_packet->sequence_number));
-			memcpy(send_buffer + sizeof(fec_packet->packet_mask) + sizeof(fec_packet->group_number) + sizeof(fec_packet->sequence_number), &fec_packet->k, sizeof(fec_packet->k));
-			memcpy(send_buffer + sizeof(fec_packet->packet_mask) + sizeof(fec_packet->group_number) + sizeof(fec_packet->sequence_number) + sizeof(fec_packet->k), &fec_packet->r, sizeof(fec_packet->r));
-			memcpy(send_buffer + sizeof(fec_packet->packet_mask) + sizeof(fec_packet->group_number) + sizeof(fec_packet->sequence_number) + sizeof(fec_packet->k) + sizeof(fec_packet->r), fec_packet->data, packet_size);
-
+			char send_buffer[Packet::kMaxHeaderSize + Packet::kMaxDataSize];
+			const size_t send_length = fec_packet->Serialize(send_buffer, sizeof(send_buffer), packet_size);
 			// 
 			printf("sending FEC symbol: group_number=%u, sequence_number=%u, packet_size=%u\n", fec_packet->group_number, fec_packet->sequence_number, packet_size);
 			auto start = std::chrono::high_resolution_clock::now(); //¼ǰʱ
-			if ((ret = sendto(so, send_buffer, packet_size + 6, 0, to, tolen)) == SOCKET_ERROR) {
+			if ((ret = sendto(so, send_buffer, static_cast<int>(send_length), 0, to, tolen)) == SOCKET_ERROR) {
 				OF_PRINT_ERROR(("sendto() failed!\n"))
 					ret = -1;
 				return;
@@ -376,7 +710,7 @@ void ForwardErrorCorrection::SendByUlpfec(SOCKET so, const char* buf, int len, i
 			auto end = std::chrono::high_resolution_clock::now(); //¼ǰʱ
 			auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
 			double timeTaken = duration.count() / 1000.0; // ʵʱ
-			double desiredTime = (packet_size + 6) * 8 / static_cast<double>(bitrate); // ʱ
+			double desiredTime = send_length * 8 / static_cast<double>(bitrate); // ʱ
 			total_sent_packets++;
 			total_sent_fec_packets++;
 			double sleepTime = desiredTime - timeTaken;
@@ -406,31 +740,24 @@ void ForwardErrorCorrection::SendByUlpfec(SOCKET so, const char* buf, int len, i
 	}
 }
 
-void ForwardErrorCorrection::PacketByFEC(const char* buf, int len, int k, int r) {
+void ForwardErrorCorrection::PacketByFEC(const char* buf, int len, int k, int r, bool important) {
 
-	// Ϊһεãȼ¼һ°ĴСϢԱһ
-	if (fec_first_use) {
-		packet_size = len;
-		fec_first_use = false;
-	}
-
-	//жlenǷҪ
-	if (len < packet_size) {
-		memset(const_cast<char*>(buf) + len, 0, packet_size - len);
-		//ĬһݳȲ
-		fec_last_use = true;
-	}
+	// ÿԴԼĳȱ棬ȲͬİͬһEncodeFec İ
+	RTC_DCHECK_LE(static_cast<size_t>(len), Packet::kMaxDataSize);
 
 	//  ForwardErrorCorrection::Packet ݰ
 	auto packet = std::make_unique<ForwardErrorCorrection::Packet>();
-	packet->packet_mask = 0; // ݰ룬ֱΪ0
+	// ݰ룬ʱ
 	packet->group_number = group_number;
 	packet->sequence_number = sequence_number;
 	packet->k = k;
 	packet->r = r;
-	memcpy(packet->data, buf, packet_size);
+	packet->is_important = important;
+	packet->length = static_cast<size_t>(len);
+	memcpy(packet->data, buf, packet->length);
 	// sequence_number
 	sequence_number++;
+	group_r = r;
 
 	// ݰб
 	media_packets.push_back(std::move(packet));
@@ -439,22 +766,52 @@ void ForwardErrorCorrection::PacketByFEC(const char* buf, int len, int k, int r)
 
 	// ݰбkݰʱִһα뺯
 	if (media_packets.size() == k) {
-		EncodeFec(media_packets, r, kNumImportantPackets, kUseUnequalProtection, fec_mask_type, &fec_packets);
+		FinishGroup(r);
+	}
+}
 
-		//  fec_packets беİ˳ buffer_packets б
-		for (auto& fec_packet : fec_packets) {
-			buffer_packets.push_back(std::make_unique<ForwardErrorCorrection::Packet>(*fec_packet));
-		}
+//  media_packets еԴ룬׷ӵ buffer_packetsȻʼµһ
+void ForwardErrorCorrection::FinishGroup(int r) {
+	EncodeFec(media_packets, r, kNumImportantPackets, kUseUnequalProtection, fec_mask_type, &fec_packets);
 
-		// group_numbersequence_number
-		group_number++;
-		sequence_number = 0;
+	//  fec_packets беİ˳ buffer_packets б
+	for (auto& fec_packet : fec_packets) {
+		buffer_packets.push_back(std::make_unique<ForwardErrorCorrection::Packet>(*fec_packet));
+	}
 
-		media_packets.clear();
-		for (auto fec_packet : fec_packets) {
-			delete fec_packet;
-		}
-		fec_packets.clear();
-		
+	// group_numbersequence_number
+	group_number++;
+	sequence_number = 0;
+
+	media_packets.clear();
+	for (auto fec_packet : fec_packets) {
+		delete fec_packet;
+	}
+	fec_packets.clear();
+}
+
+int ForwardErrorCorrection::Flush() {
+	if (media_packets.empty()) {
+		return 0;
+	}
+	// 룺k' Դܳ k'
+	const int num_media = static_cast<int>(media_packets.size());
+	const int num_fec = std::min(group_r, num_media);
+	const size_t before = buffer_packets.size();
+	FinishGroup(num_fec);
+	return static_cast<int>(buffer_packets.size() - before);
+}
+
+void ForwardErrorCorrection::Reset() {
+	media_packets.clear();
+	buffer_packets.clear();
+	for (auto fec_packet : fec_packets) {
+		delete fec_packet;
 	}
+	fec_packets.clear();
+	group_number = 0;
+	sequence_number = 0;
+	group_r = 0;
+	fec_first_use = true;
+	fec_last_use = false;
 }
\ No newline at end of file
@@ -1,14 +1,158 @@
 #include "Channel_sim.h"
 #include <QtWidgets/QApplication>
 #include "logemitter.h"   
+#include "FecBenchmark.h"
+#include "LoopbackHarness.h"
+#include "PacketCapture.h"
+#include "PacketReplay.h"
+#include "AsyncLogger.h"
+#include "Tracer.h"
+#include <QTimer>
 
 int main(int argc, char *argv[])
 {
 
     QApplication a(argc, argv);
+    // л׼ģʽ
+    if (a.arguments().contains("--bench")) {
+        return FecBenchmark::runFromCommandLine(a.arguments());
+    }
+    // ץطģʽ pcapng еݱն˽
+    if (a.arguments().contains("--replay")) {
+        return PacketReplay::runFromCommandLine(a.arguments());
+    }
+    // ץ--capture <file.pcapng> [--capture-buffer-mb N]¼ͣѹʱգÿݱ
+    const int capture_index = a.arguments().indexOf("--capture");
+    if (capture_index >= 0 && capture_index + 1 < a.arguments().size()) {
+        const int buffer_index = a.arguments().indexOf("--capture-buffer-mb");
+        const size_t buffer_bytes = buffer_index >= 0 && buffer_index + 1 < a.arguments().size()
+            ? static_cast<size_t>(qMax(1, a.arguments()[buffer_index + 1].toInt())) * 1024 * 1024
+            : PacketCapture::kDefaultBufferBytes;
+        PacketCapture::instance().start(a.arguments()[capture_index + 1], buffer_bytes);
+    }
+    // ˵ѹģʽ  ػ  ս룬𼶼ѹ
+    if (a.arguments().contains("--loopback")) {
+        const int ret = LoopbackHarness::runFromCommandLine(a.arguments());
+        PacketCapture::instance().stop();
+        return ret;
+    }
     previousMessageHandler = qInstallMessageHandler(customMessageHandler);
+    AsyncLogger::instance().start(previousMessageHandler);
 
     Channel_sim w;
     w.show();
-    return a.exec();
+
+    // Դ--input <ļ|udp://鲥ַ:˿|pipe://·|-|synthetic://?bitrate=...>ظʱ 1..N ã
+    //         [--ingest-buffer-mb N] [--playout pcr|bitrate] [--speed N|max] [--cc ...] [--nack ...] [--deadline-ms ...] [--queue-weights ...]ڽϿʼǰЧ
+
+    {
+        const QStringList arguments = a.arguments();
+        QStringList inputs;
+        for (int i = 0; i + 1 < arguments.size(); ++i) {
+            if (arguments[i] == "--input") inputs << arguments[i + 1];
+        }
+        if (inputs.size() == 1) {
+            w.server()->SetFileName(inputs.front());
+        }
+        for (int i = 0; inputs.size() > 1 && i < inputs.size(); ++i) {
+            StreamConfig config;
+            config.stream_type = static_cast<uint8_t>(i + 1);
+            config.source = inputs[i];
+            w.server()->addStream(config);
+        }
+        // ͽࣺ--playout pcr|bitrate--speed 1|2|10|max PCR  setPacingRate ʱٻطţ
+        const int playout_index = arguments.indexOf("--playout");
+        if (playout_index >= 0 && playout_index + 1 < arguments.size()) {
+            w.server()->setPlayoutMode(arguments[playout_index + 1] == "pcr" ? PlayoutMode::Pcr : PlayoutMode::Bitrate);
+        }
+        const int speed_index = arguments.indexOf("--speed");
+        if (speed_index >= 0 && speed_index + 1 < arguments.size()) {
+            const QString speed = arguments[speed_index + 1];
+            w.server()->setPlayoutSpeed(speed == "max" ? 0.0 : speed.toDouble());
+        }
+        const int ingest_index = arguments.indexOf("--ingest-buffer-mb");
+        if (ingest_index >= 0 && ingest_index + 1 < arguments.size()) {
+            w.server()->setIngestBufferBytes(static_cast<size_t>(qMax(1, arguments[ingest_index + 1].toInt())) * 1024 * 1024);
+        }
+        // ӵƣ--cc [--bwe-min-mbps N] [--bwe-start-mbps N] [--bwe-max-mbps N]ÿͨĹƷΧ
+        if (arguments.contains("--cc")) {
+            auto mbpsOf = [&arguments](const QString& name, qint64 fallback_bps) {
+                const int index = arguments.indexOf(name);
+                return index >= 0 && index + 1 < arguments.size()
+                    ? static_cast<qint64>(arguments[index + 1].toDouble() * 1e6) : fallback_bps;
+            };
+            const BweConfig defaults;
+            w.server()->setBandwidthLimits(mbpsOf("--bwe-min-mbps", defaults.min_bps),
+                mbpsOf("--bwe-start-mbps", defaults.start_bps), mbpsOf("--bwe-max-mbps", defaults.max_bps));
+            w.server()->setCongestionControl(true);
+        }
+        // ѡش--nack [--repair-budget R]شõԤ㣬ԴֽҪ v2 Э飩
+        if (arguments.contains("--nack")) {
+            const int budget_index = arguments.indexOf("--repair-budget");
+            if (budget_index >= 0 && budget_index + 1 < arguments.size()) {
+                w.server()->setRepairBudget(arguments[budget_index + 1].toDouble());
+            }
+            w.server()->setRetransmission(true);
+        }
+        // ֹʱ̣--deadline-ms D [--edf]ͨﳬ D Ͷ--edf ʱֹʱȺͣ
+        const int deadline_index = arguments.indexOf("--deadline-ms");
+        if (deadline_index >= 0 && deadline_index + 1 < arguments.size()) {
+            w.server()->setQueueDeadline(arguments[deadline_index + 1].toInt());
+        }
+        if (arguments.contains("--edf")) {
+            w.server()->setQueueOrdering(QueueOrdering::EarliestDeadline);
+        }
+        // ͨеȨأ--queue-weights ؼԴ,ش,ͨԴ,Ĭ 8,4,4,1
+        const int weights_index = arguments.indexOf("--queue-weights");
+        if (weights_index >= 0 && weights_index + 1 < arguments.size()) {
+            const QStringList weights = arguments[weights_index + 1].split(',');
+            if (weights.size() == kQueueClassCount) {
+                QueueClassWeights class_weights;
+                for (int i = 0; i < kQueueClassCount; ++i) class_weights.weight[i] = weights[i].toInt();
+                w.server()->setQueueClassWeights(class_weights);
+            }
+            else {
+                qWarning() << "--queue-weights expects" << kQueueClassCount << "comma-separated weights, ignored";
+            }
+        }
+    }
+
+    // ʱͳƿգ--metrics-out <file> [--metrics-format json|prometheus] [--metrics-interval <ms>]
+    const QStringList arguments = a.arguments();
+    const int metrics_index = arguments.indexOf("--metrics-out");
+    QTimer metricsTimer;
+    if (metrics_index >= 0 && metrics_index + 1 < arguments.size()) {
+        const QString metrics_path = arguments[metrics_index + 1];
+        const int format_index = arguments.indexOf("--metrics-format");
+        const bool prometheus = format_index >= 0 && format_index + 1 < arguments.size() &&
+            arguments[format_index + 1] == "prometheus";
+        const int interval_index = arguments.indexOf("--metrics-interval");
+        const int interval_ms = interval_index >= 0 && interval_index + 1 < arguments.size()
+            ? qMax(100, arguments[interval_index + 1].toInt()) : 1000;
+        QObject::connect(&metricsTimer, &QTimer::timeout, [&w, metrics_path, prometheus]() {
+            if (!metrics::writeFile(metrics_path, w.server()->getMetricsSnapshot(), prometheus)) {
+                qWarning() << "Failed to write metrics to" << metrics_path;
+            }
+        });
+        metricsTimer.start(interval_ms);
+    }
+    // ׷٣--trace <file.json> [--trace-sample N]˳ʱд¼
+    const int trace_index = arguments.indexOf("--trace");
+    const QString trace_path = trace_index >= 0 && trace_index + 1 < arguments.size() ? arguments[trace_index + 1] : QString();
+    if (!trace_path.isEmpty()) {
+        const int sample_index = arguments.indexOf("--trace-sample");
+        Tracer::instance().start(sample_index >= 0 && sample_index + 1 < arguments.size()
+            ? arguments[sample_index + 1].toInt() : 1);
+    }
+
+    const int ret = a.exec();
+    if (!trace_path.isEmpty()) {
+        Tracer::instance().stop();
+        if (!Tracer::instance().writeChromeJson(trace_path)) {
+            qWarning() << "Failed to write trace to" << trace_path;
+        }
+    }
+    PacketCapture::instance().stop();
+    AsyncLogger::instance().stop();
+    return ret;
 }
@@ -26,17 +26,49 @@ class ForwardErrorCorrection {
    public:
     Packet();
     virtual ~Packet();
-    uint16_t packet_mask;            // 2ֽڵ
-    uint8_t  group_number;           // 1ֽڵϢ
+
+    // ͷʽmask[0..1] | group | seq | L+V+k | r [| mask[2..5]] [| version | flags | group32]
+    // k<=16 ʱԭ6ֽͷȫһ£k>16 ʱ k ֽλLλ1
+    // ͷٸ4ֽչ빲48λ
+    // v2 Э k ֽڴθλVλ1ٸ6ֽڰ汾չЯ32λš
+    static constexpr int kProtocolV1 = 1; // 8λţɽն˼
+    static constexpr int kProtocolV2 = 2; // 32λ
+    static constexpr size_t kBaseHeaderSize = 6;
+    static constexpr size_t kMaskExtensionSize = kUlpfecPacketMaskSizeLBitSet - kUlpfecPacketMaskSizeLBitClear;
+    static constexpr size_t kVersionExtensionSize = 6;
+    static constexpr size_t kMaxHeaderSize = kBaseHeaderSize + kMaskExtensionSize + kVersionExtensionSize;
+    static constexpr uint8_t kLBit = 0x80;
+    static constexpr uint8_t kVBit = 0x40;
+
+    uint8_t  packet_mask[kUlpfecMaxPacketMaskSize]; // ݣk<=16 ʱֻǰ2ֽڣ6ֽ
+    uint32_t group_number;           // ţv1 ֻЯ8λv2 Я32λ
     uint8_t  sequence_number;        // 1ֽڵϢ
-    uint8_t  k;                      // 1ֽڵݰϢ
+    uint8_t  k;                      // 1ֽڵݰϢL/Vλ
     uint8_t  r;                      // 1ֽڵϢ
 
     static constexpr size_t kMaxDataSize = 2000;
     uint8_t data[kMaxDataSize];  // ֶݣ󳤶Ϊ2000ֽڣ
 
+    // ²ͷϢɴǵҪ TS  PAT/PMTI֡ʼȱʹ
+    bool is_important;
+
+    // data еЧسȣ֮ȫΪ0ԴΪԼĳȣΪԴĳ
+    size_t length;
+
     //yuhang:Ҫ͵ݴڶڲֻܻڴַҪݷͳȥҪʹָãл
-    size_t Serialize(char* buffer, size_t buffer_size, size_t payload_size_to_write) const;
+    size_t Serialize(char* buffer, size_t buffer_size, size_t payload_size_to_write,
+                     int protocol_version = kProtocolV1) const;
+
+    // ն˽ȡͷ payload_size ֽڸأĵֽݲϷʱ0
+    // protocol_version ǿʱظðʹõЭ汾
+    size_t Deserialize(const char* buffer, size_t buffer_size, size_t payload_size,
+                       int* protocol_version = nullptr);
+
+    // лͷȣ k ǷչЭ汾Ƿ汾չ
+    size_t HeaderSize(int protocol_version = kProtocolV1) const;
+
+    // ֻͷ־λõյݵͷȣݲ򲻺Ϸʱ0
+    static size_t PeekHeaderSize(const char* buffer, size_t buffer_size);
 
   };
 
@@ -62,7 +94,25 @@ class ForwardErrorCorrection {
                     int r,
                     int bitrate);
 
-  void PacketByFEC(const char* buf, int len, int k, int r);
+  // important ɴǸԴǷΪҪ
+  void PacketByFEC(const char* buf, int len, int k, int r, bool important = false);
+
+  // ǰδ飺е k' Դ min(r, k') 
+  //  buffer_packetsɵͷе k Ϊ k'
+  // ѾԴͷԭ kն k'/r' Ϊ׼
+  int Flush();
+
+  // δɵ鲢¿ʼµķʼʱã
+  void Reset();
+
+  // ǰյδԴ
+  size_t PendingMediaPackets() const { return media_packets.size(); }
+
+  //  Packet::is_important ȱһ鿪ʼЧ
+  void SetUnequalProtection(bool enable) { kUseUnequalProtection = enable; }
+
+  // dst ^= srcͽն˻ָãԱ׼ԣ
+  static void XorPayloads(const uint8_t* src, uint8_t* dst, size_t length);
 
   UINT32 total_sent_packets = 0;
 
@@ -76,7 +126,7 @@ class ForwardErrorCorrection {
 
  private:
 
-  static void XorPayloads(const uint8_t* src, uint8_t* dst, size_t length);
+  void FinishGroup(int r);
 
   uint8_t packet_masks_[kUlpfecMaxMediaPackets * kUlpfecMaxPacketMaskSize];
 
@@ -88,11 +138,15 @@ class ForwardErrorCorrection {
 
   bool fec_first_use = true;
 
+  int packet_size = 0; // SendByUlpfec ԴȣȡһԴĳȣ֮İ㵽
+
   bool fec_last_use = false;
 
   std::list<ForwardErrorCorrection::Packet*> fec_packets;
 
-  int group_number = 0;
+  uint32_t group_number = 0;
+
+  int group_r = 0; // ǰFlush ʱʹ
 
   int sequence_number = 0;
 };
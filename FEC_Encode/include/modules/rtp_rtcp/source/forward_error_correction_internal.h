@@ -38,8 +38,6 @@ enum FecMaskType {
 
 static FecMaskType fec_mask_type = FecMaskType::kFecMaskRandom;  // ̶Ϊ
 
-static int packet_size;
-
 class PacketMaskTable {
  public:
   PacketMaskTable(FecMaskType fec_mask_type, int num_media_packets);
@@ -87,6 +85,18 @@ void GeneratePacketMasks(int num_media_packets,
                          PacketMaskTable* mask_table,
                          uint8_t* packet_mask);
 
+// Same as GeneratePacketMasks(), but the important packets may sit anywhere
+// in the group. `important` holds one flag per media packet (may be null).
+// The unequal protection mask is generated with the important packets
+// ordered first and its columns are then mapped back to the real packet
+// positions, so the receiver decodes with the mask carried in the header.
+void GenerateGroupPacketMasks(int num_media_packets,
+                              int num_fec_packets,
+                              const bool* important,
+                              bool use_unequal_protection,
+                              FecMaskType fec_mask_type,
+                              uint8_t* packet_mask);
+
 // Returns the required packet mask size, given the number of sequence numbers
 // that will be covered.
 size_t PacketMaskSize(size_t num_sequence_numbers);